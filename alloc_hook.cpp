@@ -0,0 +1,31 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "alloc_hook.h"
+
+#ifdef FRD_COUNT_ALLOCATIONS
+
+namespace {
+std::atomic<u64> allocation_count{0};
+}
+
+// The array and nothrow forms forward to this one, and the default operator delete calls free
+void* operator new(std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+u64 GetGlobalAllocationCount() {
+    return allocation_count.load(std::memory_order_relaxed);
+}
+
+#else
+
+u64 GetGlobalAllocationCount() {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "swap.h"
+
+/**
+ * Number of global operator new calls made so far. Counting is only compiled in when building
+ * with -DFRD_COUNT_ALLOCATIONS; otherwise this always returns 0.
+ */
+u64 GetGlobalAllocationCount();
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include "arena.h"
+
+Arena::Arena(std::size_t block_size_) : block_size(block_size_) {}
+
+Arena::~Arena() {
+    for (const Block& block : blocks) {
+        std::free(block.data);
+    }
+}
+
+void* Arena::Allocate(std::size_t size, std::size_t alignment) {
+    if (!blocks.empty()) {
+        const Block& block = blocks[current];
+        const auto address = reinterpret_cast<std::uintptr_t>(block.data) + offset;
+        const std::size_t padding = (alignment - address % alignment) % alignment;
+        if (offset + padding + size <= block.size) {
+            offset += padding + size;
+            return block.data + offset - size;
+        }
+    }
+    NextBlock(size + alignment);
+    return Allocate(size, alignment);
+}
+
+std::string_view Arena::CopyString(std::string_view str) {
+    auto* data = static_cast<char*>(Allocate(str.size(), 1));
+    std::memcpy(data, str.data(), str.size());
+    return {data, str.size()};
+}
+
+void Arena::Reset() {
+    current = 0;
+    offset = 0;
+    used_before_current = 0;
+}
+
+void Arena::NextBlock(std::size_t min_size) {
+    if (!blocks.empty()) {
+        used_before_current += offset;
+        offset = 0;
+
+        // Reuse a block retained from an earlier batch if one is large enough
+        for (current++; current < blocks.size(); current++) {
+            if (blocks[current].size >= min_size) {
+                return;
+            }
+        }
+    }
+
+    const std::size_t size = std::max(block_size, min_size);
+    auto* data = static_cast<u8*>(std::malloc(size));
+    if (!data) {
+        throw std::bad_alloc();
+    }
+    blocks.push_back({data, size});
+    current = blocks.size() - 1;
+}
+
+StringInterner::StringInterner(Arena& arena_, std::size_t expected_strings) : arena(arena_) {
+    slots.resize(std::bit_ceil(std::max<std::size_t>(expected_strings * 2, 16)));
+}
+
+std::string_view StringInterner::Intern(std::string_view str) {
+    if ((size + 1) * 2 > slots.size()) {
+        Grow();
+    }
+
+    const std::size_t mask = slots.size() - 1;
+    for (std::size_t i = std::hash<std::string_view>{}(str) & mask;; i = (i + 1) & mask) {
+        std::string_view& slot = slots[i];
+        if (slot.data() == nullptr) {
+            // Empty strings still need a non-null pointer to mark the slot as used
+            slot = str.empty() ? std::string_view{"", 0} : arena.CopyString(str);
+            size++;
+            return slot;
+        }
+        if (slot == str) {
+            return slot;
+        }
+    }
+}
+
+void StringInterner::Reset() {
+    std::fill(slots.begin(), slots.end(), std::string_view{});
+    size = 0;
+}
+
+void StringInterner::Grow() {
+    std::vector<std::string_view> old(slots.size() * 2);
+    old.swap(slots);
+
+    const std::size_t mask = slots.size() - 1;
+    for (const std::string_view str : old) {
+        if (str.data() == nullptr) {
+            continue;
+        }
+        std::size_t i = std::hash<std::string_view>{}(str) & mask;
+        while (slots[i].data() != nullptr) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = str;
+    }
+}
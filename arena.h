@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "swap.h"
+
+/**
+ * Bump allocator for per-batch data. Allocations are released all at once by Reset(), which keeps
+ * the underlying blocks so that later batches of a similar size never touch the global heap.
+ */
+class Arena {
+public:
+    static constexpr std::size_t DEFAULT_BLOCK_SIZE = 0x10000;
+
+    explicit Arena(std::size_t block_size = DEFAULT_BLOCK_SIZE);
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    [[nodiscard]] void* Allocate(std::size_t size,
+                                 std::size_t alignment = alignof(std::max_align_t));
+
+    /// Allocates uninitialized storage for count trivially destructible objects
+    template <typename T>
+    [[nodiscard]] std::span<T> AllocateArray(std::size_t count) {
+        static_assert(std::is_trivially_destructible_v<T>, "Arena never runs destructors");
+        return {static_cast<T*>(Allocate(count * sizeof(T), alignof(T))), count};
+    }
+
+    [[nodiscard]] std::string_view CopyString(std::string_view str);
+
+    /// Releases every allocation; previously returned pointers become invalid
+    void Reset();
+
+    /// Bytes handed out since the last Reset()
+    [[nodiscard]] std::size_t BytesUsed() const {
+        return used_before_current + offset;
+    }
+
+private:
+    struct Block {
+        u8* data;
+        std::size_t size;
+    };
+
+    void NextBlock(std::size_t min_size);
+
+    std::size_t block_size;
+    std::vector<Block> blocks;
+    std::size_t current = 0; ///< Index of the block being bumped
+    std::size_t offset = 0;  ///< Bytes used in the current block
+    std::size_t used_before_current = 0;
+};
+
+/**
+ * Deduplicates strings within one batch: equal strings are stored once in the arena and share the
+ * returned view. Reset() must be called together with the arena's Reset().
+ */
+class StringInterner {
+public:
+    explicit StringInterner(Arena& arena, std::size_t expected_strings = 1024);
+
+    [[nodiscard]] std::string_view Intern(std::string_view str);
+
+    /// Forgets every interned string but keeps the table's capacity
+    void Reset();
+
+    [[nodiscard]] std::size_t Size() const {
+        return size;
+    }
+
+private:
+    void Grow();
+
+    Arena& arena;
+    std::vector<std::string_view> slots; ///< Open addressing table; data() == nullptr when empty
+    std::size_t size = 0;
+};
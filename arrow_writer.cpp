@@ -0,0 +1,411 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <initializer_list>
+#include "arrow_writer.h"
+#include "parallel.h"
+
+namespace {
+
+constexpr std::array<char, 8> ARROW_MAGIC{'A', 'R', 'R', 'O', 'W', '1', '\0', '\0'};
+constexpr std::size_t ARROW_ALIGNMENT = 64;
+constexpr u32 CONTINUATION_MARKER = 0xFFFFFFFF;
+
+// Enumerations of Schema.fbs and Message.fbs
+constexpr u16 METADATA_V5 = 4;
+constexpr u8 MESSAGE_SCHEMA = 1;
+constexpr u8 MESSAGE_RECORD_BATCH = 3;
+constexpr u16 ENDIANNESS_LITTLE = 0;
+constexpr u16 ENDIANNESS_BIG = 1;
+
+enum class ColumnType : u8 {
+    Int = 2,
+    Utf8 = 5,
+    Bool = 6,
+    FixedSizeBinary = 15,
+};
+
+ColumnType ColumnTypeOf(const FieldInfo& field) {
+    switch (field.type) {
+    case FieldType::Unsigned:
+        return ColumnType::Int;
+    case FieldType::BitField:
+        return field.bits == 1 ? ColumnType::Bool : ColumnType::Int;
+    case FieldType::Utf16:
+        return ColumnType::Utf8;
+    case FieldType::Bytes:
+        break;
+    }
+    return ColumnType::FixedSizeBinary;
+}
+
+/// Bytes per value of an Int column
+std::size_t IntWidth(const FieldInfo& field) {
+    return std::bit_ceil<std::size_t>((field.bits + 7u) / 8u);
+}
+
+/// Data buffers after the validity buffer: offsets and characters for strings, values otherwise
+std::size_t DataBufferCount(const FieldInfo& field) {
+    return ColumnTypeOf(field) == ColumnType::Utf8 ? 2 : 1;
+}
+
+std::size_t AlignUp(std::size_t value, std::size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * Minimal FlatBuffers encoder for the Arrow metadata. Objects are laid out front to back: a table
+ * comes before the strings, vectors and tables it refers to, and its offset fields are linked once
+ * those are written, so every offset points forward as the format requires. Each vtable follows
+ * its table, which a negative vtable offset allows.
+ */
+class FlatBufferBuilder {
+public:
+    /// Scalar of size bytes in slot id, or with size 4 and no value an offset to link later
+    struct Field {
+        u16 id;
+        u8 size;
+        u64 value = 0;
+    };
+
+    /// Position of a table and of each of its fields, in the order they were given
+    struct Table {
+        std::size_t table;
+        std::array<std::size_t, 8> fields;
+    };
+
+    FlatBufferBuilder() : bytes(sizeof(u32)) {} // Offset of the root table
+
+    Table AddTable(std::initializer_list<Field> fields) {
+        // Largest fields first, so that alignment padding is only needed before the first of them
+        std::array<std::size_t, 8> order{};
+        for (std::size_t i = 0; i < fields.size(); i++) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.begin() + fields.size(),
+                         [&](std::size_t a, std::size_t b) {
+                             return fields.begin()[a].size > fields.begin()[b].size;
+                         });
+
+        Align(sizeof(u32));
+        Table table{bytes.size(), {}};
+        Put(0, sizeof(u32)); // vtable offset, patched below
+        u16 slots = 0;
+        for (std::size_t i = 0; i < fields.size(); i++) {
+            const Field& field = fields.begin()[order[i]];
+            Align(field.size);
+            table.fields[order[i]] = bytes.size();
+            Put(field.value, field.size);
+            slots = std::max<u16>(slots, field.id + 1);
+        }
+        const std::size_t table_size = bytes.size() - table.table;
+
+        Align(sizeof(u16));
+        const std::size_t vtable = bytes.size();
+        Put(sizeof(u16) * (2 + slots), sizeof(u16));
+        Put(table_size, sizeof(u16));
+        bytes.resize(bytes.size() + sizeof(u16) * slots);
+        for (std::size_t i = 0; i < fields.size(); i++) {
+            Patch(vtable + sizeof(u16) * (2 + fields.begin()[i].id),
+                  table.fields[i] - table.table, sizeof(u16));
+        }
+        Patch(table.table, static_cast<u32>(table.table - vtable), sizeof(u32));
+        return table;
+    }
+
+    std::size_t AddString(std::string_view text) {
+        Align(sizeof(u32));
+        const std::size_t position = bytes.size();
+        Put(text.size(), sizeof(u32));
+        bytes.insert(bytes.end(), text.begin(), text.end());
+        bytes.push_back(0);
+        return position;
+    }
+
+    /// Vector of structs made of words_per_struct 64-bit words each
+    std::size_t AddStructVector(std::span<const u64> words, std::size_t words_per_struct) {
+        Align(sizeof(u32));
+        if (bytes.size() % sizeof(u64) == 0) {
+            Put(0, sizeof(u32)); // Structs of 64-bit words start at a multiple of 8
+        }
+        const std::size_t position = bytes.size();
+        Put(words.size() / words_per_struct, sizeof(u32));
+        for (const u64 word : words) {
+            Put(word, sizeof(u64));
+        }
+        return position;
+    }
+
+    /// Vector of count table offsets; element i is at the returned position + 4 * (i + 1)
+    std::size_t AddTableVector(std::size_t count) {
+        Align(sizeof(u32));
+        const std::size_t position = bytes.size();
+        Put(count, sizeof(u32));
+        bytes.resize(bytes.size() + sizeof(u32) * count);
+        return position;
+    }
+
+    /// Points the offset at field to the object at target
+    void Link(std::size_t field, std::size_t target) {
+        Patch(field, target - field, sizeof(u32));
+    }
+
+    /// Pads the buffer to a multiple of 8 and returns it
+    std::vector<u8>& Finish(std::size_t root) {
+        Link(0, root);
+        Align(sizeof(u64));
+        return bytes;
+    }
+
+private:
+    void Align(std::size_t alignment) {
+        bytes.resize(AlignUp(bytes.size(), alignment));
+    }
+
+    void Put(u64 value, std::size_t size) {
+        bytes.resize(bytes.size() + size);
+        Patch(bytes.size() - size, value, size);
+    }
+
+    /// FlatBuffers are little endian regardless of the host
+    void Patch(std::size_t position, u64 value, std::size_t size) {
+        for (std::size_t i = 0; i < size; i++) {
+            bytes[position + i] = static_cast<u8>(value >> 8 * i);
+        }
+    }
+
+    std::vector<u8> bytes;
+};
+
+/// Adds a Schema table describing columns and links the offset at field to it
+void AddSchema(FlatBufferBuilder& builder, std::size_t field,
+               std::span<const FieldAccessor> columns) {
+    const u16 endianness = FieldAccessDetail::HOST_BIG_ENDIAN ? ENDIANNESS_BIG : ENDIANNESS_LITTLE;
+    const FlatBufferBuilder::Table schema = builder.AddTable({{0, 2, endianness}, {1, 4}});
+    builder.Link(field, schema.table);
+    const std::size_t fields = builder.AddTableVector(columns.size());
+    builder.Link(schema.fields[1], fields);
+
+    for (std::size_t i = 0; i < columns.size(); i++) {
+        const FieldInfo& info = *columns[i].field;
+        const ColumnType type = ColumnTypeOf(info);
+        // name, nullable, type_type, type, children; the reader requires children even if empty
+        const FlatBufferBuilder::Table column = builder.AddTable(
+            {{0, 4}, {1, 1, 0}, {2, 1, static_cast<u8>(type)}, {3, 4}, {5, 4}});
+        builder.Link(fields + sizeof(u32) * (i + 1), column.table);
+        builder.Link(column.fields[0], builder.AddString(info.name));
+
+        FlatBufferBuilder::Table type_table;
+        switch (type) {
+        case ColumnType::Int:
+            type_table = builder.AddTable({{0, 4, IntWidth(info) * 8}, {1, 1, 0}});
+            break;
+        case ColumnType::FixedSizeBinary:
+            type_table = builder.AddTable({{0, 4, info.size}});
+            break;
+        case ColumnType::Utf8:
+        case ColumnType::Bool:
+            type_table = builder.AddTable({});
+            break;
+        }
+        builder.Link(column.fields[3], type_table.table);
+        builder.Link(column.fields[4], builder.AddTableVector(0));
+    }
+}
+
+/// Fills the data buffers of one column from count records
+void EncodeColumn(const FieldAccessor& column, const u8* records, std::size_t record_size,
+                  std::size_t count, std::vector<u8>* buffers) {
+    const FieldInfo& field = *column.field;
+    std::vector<u8>& values = buffers[0];
+    switch (ColumnTypeOf(field)) {
+    case ColumnType::Int: {
+        const std::size_t width = IntWidth(field);
+        values.resize(count * width);
+        for (std::size_t i = 0; i < count; i++) {
+            const u64 value = column.read(records + i * record_size);
+            switch (width) {
+            case 1:
+                values[i] = static_cast<u8>(value);
+                break;
+            case 2:
+                reinterpret_cast<u16*>(values.data())[i] = static_cast<u16>(value);
+                break;
+            case 4:
+                reinterpret_cast<u32*>(values.data())[i] = static_cast<u32>(value);
+                break;
+            default:
+                reinterpret_cast<u64*>(values.data())[i] = value;
+                break;
+            }
+        }
+        break;
+    }
+    case ColumnType::Bool:
+        values.assign((count + 7) / 8, 0);
+        for (std::size_t i = 0; i < count; i++) {
+            values[i / 8] |= static_cast<u8>(column.read(records + i * record_size) << i % 8);
+        }
+        break;
+    case ColumnType::Utf8: {
+        std::vector<u8>& characters = buffers[1];
+        values.resize((count + 1) * sizeof(u32));
+        characters.resize(count * MaxUtf8Size(field));
+        auto* offsets = reinterpret_cast<u32*>(values.data());
+        std::size_t length = 0;
+        for (std::size_t i = 0; i < count; i++) {
+            offsets[i] = static_cast<u32>(length);
+            length += FieldToUtf8(records + i * record_size, field,
+                                  reinterpret_cast<char*>(characters.data()) + length);
+        }
+        offsets[count] = static_cast<u32>(length);
+        characters.resize(length);
+        break;
+    }
+    case ColumnType::FixedSizeBinary:
+        values.resize(count * field.size);
+        for (std::size_t i = 0; i < count; i++) {
+            std::copy_n(records + i * record_size + field.offset, field.size,
+                        values.data() + i * field.size);
+        }
+        break;
+    }
+}
+
+} // namespace
+
+ArrowWriter::ArrowWriter(std::span<const FieldAccessor> columns, std::size_t record_size)
+    : columns(columns), record_size(record_size) {
+    for (const FieldAccessor& column : columns) {
+        first_buffers.push_back(buffers.size());
+        buffers.resize(buffers.size() + DataBufferCount(*column.field));
+    }
+    first_buffers.push_back(buffers.size());
+}
+
+ArrowWriter::~ArrowWriter() {
+    if (file) {
+        std::fclose(file);
+    }
+}
+
+bool ArrowWriter::Write(const void* data, std::size_t size) {
+    failed |= std::fwrite(data, 1, size, file) != size;
+    position += size;
+    return !failed;
+}
+
+bool ArrowWriter::WritePadding(std::size_t size) {
+    static constexpr std::array<u8, ARROW_ALIGNMENT> zeros{};
+    return Write(zeros.data(), size);
+}
+
+bool ArrowWriter::WriteMessage(const std::vector<u8>& metadata, u64 body_size, Block* block) {
+    const std::size_t prefix_size = 2 * sizeof(u32_le);
+    const std::size_t padded_size =
+        AlignUp(position + prefix_size + metadata.size(), ARROW_ALIGNMENT) - position;
+    if (block) {
+        *block = {position, static_cast<u32>(padded_size), body_size};
+    }
+    const std::array<u32_le, 2> prefix{CONTINUATION_MARKER,
+                                       static_cast<u32>(padded_size - prefix_size)};
+    return Write(prefix.data(), prefix_size) && Write(metadata.data(), metadata.size()) &&
+           WritePadding(padded_size - prefix_size - metadata.size());
+}
+
+bool ArrowWriter::Open(const std::string& path) {
+    batches.clear();
+    failed = false;
+    position = 0;
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+
+    FlatBufferBuilder builder;
+    const FlatBufferBuilder::Table message = builder.AddTable(
+        {{0, 2, METADATA_V5}, {1, 1, MESSAGE_SCHEMA}, {2, 4}, {3, 8, 0}});
+    AddSchema(builder, message.fields[2], columns);
+    return Write(ARROW_MAGIC.data(), ARROW_MAGIC.size()) &&
+           WriteMessage(builder.Finish(message.table), 0);
+}
+
+bool ArrowWriter::WriteBatch(std::span<const u8> records) {
+    const std::size_t count = records.size() / record_size;
+    if (!file || count == 0) {
+        return file != nullptr;
+    }
+
+    ParallelFor(
+        columns.size(),
+        [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; i++) {
+                EncodeColumn(columns[i], records.data(), record_size, count,
+                             &buffers[first_buffers[i]]);
+            }
+        },
+        4);
+
+    // Every column has an empty validity buffer, then its data buffers
+    std::vector<u64> nodes;
+    std::vector<u64> layout;
+    u64 body_size = 0;
+    for (std::size_t i = 0; i < columns.size(); i++) {
+        nodes.insert(nodes.end(), {count, 0});
+        layout.insert(layout.end(), {body_size, 0});
+        for (std::size_t j = first_buffers[i]; j < first_buffers[i + 1]; j++) {
+            layout.insert(layout.end(), {body_size, buffers[j].size()});
+            body_size += AlignUp(buffers[j].size(), ARROW_ALIGNMENT);
+        }
+    }
+
+    FlatBufferBuilder builder;
+    const FlatBufferBuilder::Table message = builder.AddTable(
+        {{0, 2, METADATA_V5}, {1, 1, MESSAGE_RECORD_BATCH}, {2, 4}, {3, 8, body_size}});
+    const FlatBufferBuilder::Table batch = builder.AddTable({{0, 8, count}, {1, 4}, {2, 4}});
+    builder.Link(message.fields[2], batch.table);
+    builder.Link(batch.fields[1], builder.AddStructVector(nodes, 2));
+    builder.Link(batch.fields[2], builder.AddStructVector(layout, 2));
+
+    Block block;
+    if (!WriteMessage(builder.Finish(message.table), body_size, &block)) {
+        return false;
+    }
+    for (const std::vector<u8>& buffer : buffers) {
+        if (!Write(buffer.data(), buffer.size()) ||
+            !WritePadding(AlignUp(buffer.size(), ARROW_ALIGNMENT) - buffer.size())) {
+            return false;
+        }
+    }
+    batches.push_back(block);
+    return true;
+}
+
+bool ArrowWriter::Close() {
+    if (!file) {
+        return false;
+    }
+
+    // Block is a struct of offset, metadata size padded to 8 bytes, and body size
+    std::vector<u64> blocks;
+    for (const Block& block : batches) {
+        blocks.insert(blocks.end(), {block.offset, block.metadata_size, block.body_size});
+    }
+    FlatBufferBuilder builder;
+    const FlatBufferBuilder::Table footer =
+        builder.AddTable({{0, 2, METADATA_V5}, {1, 4}, {2, 4}, {3, 4}});
+    AddSchema(builder, footer.fields[1], columns);
+    builder.Link(footer.fields[2], builder.AddStructVector({}, 3));
+    builder.Link(footer.fields[3], builder.AddStructVector(blocks, 3));
+    const std::vector<u8>& metadata = builder.Finish(footer.table);
+
+    const std::array<u32_le, 2> end_of_stream{CONTINUATION_MARKER, 0};
+    const u32_le footer_size = static_cast<u32>(metadata.size());
+    Write(end_of_stream.data(), sizeof(end_of_stream));
+    Write(metadata.data(), metadata.size());
+    Write(&footer_size, sizeof(footer_size));
+    Write(ARROW_MAGIC.data(), 6);
+    const bool closed = std::fclose(file) == 0;
+    file = nullptr;
+    return closed && !failed;
+}
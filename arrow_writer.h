@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdio>
+#include <span>
+#include <string>
+#include <vector>
+#include "field_access.h"
+
+/// Records per record batch written by the --arrow export
+inline constexpr std::size_t ARROW_BATCH_ROWS = 0x10000;
+
+/**
+ * Writes records as an Apache Arrow IPC file (metadata version V5) with one column per field of a
+ * field table, named by its dotted path: Unsigned members and BitFields become unsigned integers of
+ * the next power of two width, one bit BitFields become booleans, UTF-16 arrays become UTF-8
+ * strings up to their first NUL, and byte arrays become fixed size binary. Values are written in
+ * host byte order, which the schema records. No column has nulls, so validity buffers are empty.
+ *
+ * The FlatBuffers metadata is encoded by hand, so no Arrow library is needed. Every buffer starts
+ * at a file offset that is a multiple of 64 and is padded to a multiple of 64 bytes, so readers can
+ * map the file and use the columns in place.
+ */
+class ArrowWriter {
+public:
+    /// columns must outlive the writer, e.g. FieldAccessorsOf<Record>()
+    ArrowWriter(std::span<const FieldAccessor> columns, std::size_t record_size);
+    ~ArrowWriter();
+
+    ArrowWriter(const ArrowWriter&) = delete;
+    ArrowWriter& operator=(const ArrowWriter&) = delete;
+
+    /// Creates the file at path and writes the schema
+    bool Open(const std::string& path);
+
+    /// Writes records, packed back to back, as one record batch. Columns are encoded in parallel.
+    bool WriteBatch(std::span<const u8> records);
+
+    /// Writes the footer and closes the file; returns false if any write failed
+    bool Close();
+
+    /// Location of a record batch, as listed in the footer
+    struct Block {
+        u64 offset;
+        u32 metadata_size; ///< Including the message prefix and padding
+        u64 body_size;
+    };
+
+private:
+    bool Write(const void* data, std::size_t size);
+    bool WritePadding(std::size_t size);
+
+    /// Writes an encapsulated message whose body, of body_size bytes, follows it at a multiple of 64
+    bool WriteMessage(const std::vector<u8>& metadata, u64 body_size, Block* block = nullptr);
+
+    std::span<const FieldAccessor> columns;
+    std::size_t record_size;
+    std::vector<std::size_t> first_buffers; ///< Index in buffers of the first one of each column
+    std::vector<std::vector<u8>> buffers;   ///< Data buffers of the current batch, reused
+    std::vector<Block> batches;
+    FILE* file = nullptr;
+    u64 position = 0;
+    bool failed = false;
+};
@@ -0,0 +1,390 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "batch_reader.h"
+
+namespace {
+
+constexpr unsigned BATCH_SIZE = 256;   ///< Files in flight per io_uring round trip
+constexpr std::size_t SLOT_SIZE = 512; ///< Registered buffer bytes per file in flight
+static_assert(SLOT_SIZE >= sizeof(FRDMyData), "Registered buffer slots are too small");
+
+// The operation of a completion is tagged in the top bits of its user_data, above the slot index
+constexpr u64 OPEN_TAG = u64{1} << 62;
+constexpr u64 READ_TAG = u64{2} << 62;
+constexpr u64 CLOSE_TAG = u64{3} << 62;
+constexpr u64 TAG_MASK = u64{3} << 62;
+
+/// Minimal io_uring wrapper over the raw syscalls, so the build does not need liburing
+class IoUring {
+public:
+    IoUring() = default;
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    ~IoUring() {
+        if (sqes != MAP_FAILED) {
+            munmap(sqes, sqes_size);
+        }
+        if (cq_ring != MAP_FAILED && cq_ring != sq_ring) {
+            munmap(cq_ring, cq_ring_size);
+        }
+        if (sq_ring != MAP_FAILED) {
+            munmap(sq_ring, sq_ring_size);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    bool Init(unsigned entries) {
+        io_uring_params params{};
+        fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) {
+            return false;
+        }
+
+        sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+        cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap) {
+            sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+        }
+
+        sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       fd, IORING_OFF_SQ_RING);
+        if (sq_ring == MAP_FAILED) {
+            return false;
+        }
+        cq_ring = single_mmap ? sq_ring
+                              : mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE,
+                                     MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cq_ring == MAP_FAILED) {
+            return false;
+        }
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                    IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            return false;
+        }
+
+        auto* sq = static_cast<char*>(sq_ring);
+        sq_tail = reinterpret_cast<u32*>(sq + params.sq_off.tail);
+        sq_mask = *reinterpret_cast<u32*>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<u32*>(sq + params.sq_off.array);
+
+        auto* cq = static_cast<char*>(cq_ring);
+        cq_head = reinterpret_cast<u32*>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<u32*>(cq + params.cq_off.tail);
+        cq_mask = *reinterpret_cast<u32*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    /// Checks that the kernel implements every opcode the reader submits
+    bool SupportsReaderOps() const {
+        constexpr unsigned max_ops = 256;
+        std::vector<char> buffer(sizeof(io_uring_probe) + max_ops * sizeof(io_uring_probe_op));
+        auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+        if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, max_ops) < 0) {
+            return false;
+        }
+        for (const u8 op : {IORING_OP_OPENAT, IORING_OP_READ_FIXED, IORING_OP_CLOSE}) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool RegisterBuffers(const iovec* iovecs, unsigned count) {
+        return syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, iovecs, count) == 0;
+    }
+
+    /// Returns a zeroed submission queue entry; at most `entries` may be queued per submit
+    io_uring_sqe* NextSqe() {
+        const u32 tail = *sq_tail + queued;
+        const u32 index = tail & sq_mask;
+        auto* sqe = static_cast<io_uring_sqe*>(sqes) + index;
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array[index] = index;
+        queued++;
+        return sqe;
+    }
+
+    /**
+     * Submits every queued entry. Returns how many the kernel accepted, in queue order, which is
+     * fewer only if it failed; the ring should be abandoned then.
+     */
+    unsigned Submit() {
+        std::atomic_ref<u32>(*sq_tail).store(*sq_tail + queued, std::memory_order_release);
+        unsigned submitted = 0;
+        while (submitted < queued) {
+            const long ret = syscall(__NR_io_uring_enter, fd, queued - submitted, 0, 0, nullptr, 0);
+            if (ret < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            submitted += static_cast<unsigned>(ret);
+        }
+        queued = 0;
+        return submitted;
+    }
+
+    /**
+     * Passes completions to func until count of them have arrived. A signal can end a wait early,
+     * so completions are counted rather than assumed. Returns false if waiting fails.
+     */
+    template <typename Func>
+    bool Reap(unsigned count, Func&& func) {
+        while (true) {
+            u32 head = *cq_head;
+            const u32 tail = std::atomic_ref<u32>(*cq_tail).load(std::memory_order_acquire);
+            for (; head != tail && count != 0; head++, count--) {
+                func(cqes[head & cq_mask]);
+            }
+            std::atomic_ref<u32>(*cq_head).store(head, std::memory_order_release);
+            if (count == 0) {
+                return true;
+            }
+            const long ret =
+                syscall(__NR_io_uring_enter, fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (ret < 0 && errno != EINTR) {
+                return false;
+            }
+        }
+    }
+
+private:
+    int fd = -1;
+    void* sq_ring = MAP_FAILED;
+    void* cq_ring = MAP_FAILED;
+    void* sqes = MAP_FAILED;
+    std::size_t sq_ring_size = 0;
+    std::size_t cq_ring_size = 0;
+    std::size_t sqes_size = 0;
+
+    u32* sq_tail = nullptr;
+    u32 sq_mask = 0;
+    u32* sq_array = nullptr;
+    u32* cq_head = nullptr;
+    u32* cq_tail = nullptr;
+    u32 cq_mask = 0;
+    io_uring_cqe* cqes = nullptr;
+    unsigned queued = 0;
+};
+
+struct FreeDeleter {
+    void operator()(void* ptr) const {
+        std::free(ptr);
+    }
+};
+
+/**
+ * Reads files in batches of BATCH_SIZE: one submission opens the batch (and closes the previous
+ * one), a second reads every opened file into its registered buffer slot.
+ * Returns the number of leading paths handled, which is less than paths.size() on failure.
+ */
+std::size_t ReadWithIoUring(std::span<const std::string> paths,
+                            std::vector<MyDataReadResult>& results) {
+    std::unique_ptr<u8, FreeDeleter> pool(
+        static_cast<u8*>(std::aligned_alloc(4096, BATCH_SIZE * SLOT_SIZE)));
+    if (!pool) {
+        return 0;
+    }
+
+    // Declared after the pool so the ring, and with it the buffer registration, goes first
+    IoUring ring;
+    if (!ring.Init(BATCH_SIZE * 2) || !ring.SupportsReaderOps()) {
+        return 0;
+    }
+
+    std::array<iovec, BATCH_SIZE> iovecs;
+    for (unsigned i = 0; i < BATCH_SIZE; i++) {
+        iovecs[i] = {pool.get() + i * SLOT_SIZE, SLOT_SIZE};
+    }
+    if (!ring.RegisterBuffers(iovecs.data(), BATCH_SIZE)) {
+        return 0;
+    }
+
+    // Every slot starts a batch at -1, so a slot whose open or read never completed reads as failed
+    std::array<int, BATCH_SIZE> fds;
+    std::array<int, BATCH_SIZE> lengths;
+    std::array<int, BATCH_SIZE> closing; ///< fds of the previous batch, until their close completes
+    closing.fill(-1);
+    unsigned reaped = 0; ///< Completions of the current submission passed to on_completion
+
+    const auto on_completion = [&](const io_uring_cqe& cqe) {
+        const std::size_t i = cqe.user_data & ~TAG_MASK;
+        reaped++;
+        switch (cqe.user_data & TAG_MASK) {
+        case OPEN_TAG:
+            fds[i] = cqe.res;
+            break;
+        case READ_TAG:
+            lengths[i] = cqe.res;
+            break;
+        case CLOSE_TAG:
+            closing[i] = -1;
+            break;
+        }
+    };
+
+    // Queues a close for every fd of the previous batch, returning how many were queued
+    const auto queue_closes = [&](unsigned count) {
+        unsigned queued = 0;
+        for (unsigned i = 0; i < count; i++) {
+            closing[i] = fds[i];
+            if (fds[i] >= 0) {
+                io_uring_sqe* sqe = ring.NextSqe();
+                sqe->opcode = IORING_OP_CLOSE;
+                sqe->fd = fds[i];
+                sqe->user_data = CLOSE_TAG | i;
+                queued++;
+            }
+        }
+        return queued;
+    };
+
+    // Submits what is queued and reaps every completion of it. On failure, first drains whatever
+    // the kernel accepted, polling the completion queue if waiting keeps failing, so every open
+    // has reported its fd and every close has finished. The fds left in closing and fds are then
+    // exactly those still open, and are closed directly.
+    const auto submit_and_reap = [&](unsigned queued, unsigned count) {
+        reaped = 0;
+        const unsigned submitted = ring.Submit();
+        if (submitted == queued && ring.Reap(queued, on_completion)) {
+            return true;
+        }
+        while (reaped < submitted && !ring.Reap(submitted - reaped, on_completion)) {
+            std::this_thread::yield();
+        }
+        for (unsigned i = 0; i < BATCH_SIZE; i++) {
+            if (closing[i] >= 0) {
+                close(std::exchange(closing[i], -1));
+            }
+        }
+        for (unsigned i = 0; i < count; i++) {
+            if (fds[i] >= 0) {
+                close(fds[i]);
+            }
+        }
+        return false;
+    };
+
+    std::size_t base = 0;
+    unsigned previous_count = 0;
+    for (; base < paths.size(); base += BATCH_SIZE) {
+        const auto count = static_cast<unsigned>(std::min<std::size_t>(BATCH_SIZE, paths.size() - base));
+
+        const unsigned closes = queue_closes(previous_count);
+        fds.fill(-1);
+        lengths.fill(-1);
+        for (unsigned i = 0; i < count; i++) {
+            io_uring_sqe* sqe = ring.NextSqe();
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = reinterpret_cast<u64>(paths[base + i].c_str());
+            sqe->open_flags = O_RDONLY | O_CLOEXEC;
+            sqe->user_data = OPEN_TAG | i;
+        }
+        if (!submit_and_reap(closes + count, count)) {
+            return base;
+        }
+
+        unsigned reads = 0;
+        for (unsigned i = 0; i < count; i++) {
+            if (fds[i] < 0) {
+                continue;
+            }
+            io_uring_sqe* sqe = ring.NextSqe();
+            sqe->opcode = IORING_OP_READ_FIXED;
+            sqe->fd = fds[i];
+            sqe->addr = reinterpret_cast<u64>(iovecs[i].iov_base);
+            sqe->len = sizeof(FRDMyData);
+            sqe->off = 0;
+            sqe->buf_index = static_cast<u16>(i);
+            sqe->user_data = READ_TAG | i;
+            reads++;
+        }
+        if (!submit_and_reap(reads, count)) {
+            return base;
+        }
+
+        for (unsigned i = 0; i < count; i++) {
+            if (lengths[i] >= 0) {
+                MyDataReadResult& result = results[base + i];
+                result.opened = true;
+                std::memcpy(&result.data, iovecs[i].iov_base, lengths[i]);
+            }
+        }
+        previous_count = count;
+    }
+
+    const unsigned closes = queue_closes(previous_count);
+    fds.fill(-1);
+    submit_and_reap(closes, 0);
+    return paths.size();
+}
+
+void ReadOne(const std::string& path, MyDataReadResult& result) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    const ssize_t length = pread(fd, &result.data, sizeof(FRDMyData), 0);
+    close(fd);
+    result.opened = length >= 0;
+}
+
+void ReadWithThreadPool(std::span<const std::string> paths, std::vector<MyDataReadResult>& results,
+                        std::size_t begin) {
+    std::atomic<std::size_t> next{begin};
+    const auto worker = [&] {
+        for (std::size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < paths.size();) {
+            ReadOne(paths[i], results[i]);
+        }
+    };
+
+    const std::size_t thread_count =
+        std::min<std::size_t>(std::max(1u, std::thread::hardware_concurrency()), paths.size() - begin);
+    std::vector<std::jthread> threads;
+    for (std::size_t i = 1; i < thread_count; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+}
+
+} // namespace
+
+std::vector<MyDataReadResult> ReadMyDataFiles(std::span<const std::string> paths,
+                                              ReadBackend backend) {
+    std::vector<MyDataReadResult> results(paths.size());
+    if (paths.empty()) {
+        return results;
+    }
+
+    std::size_t done = 0;
+    if (backend != ReadBackend::ThreadPool) {
+        done = ReadWithIoUring(paths, results);
+    }
+    if (done < paths.size()) {
+        ReadWithThreadPool(paths, results, done);
+    }
+    return results;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+#include "main.h"
+
+enum class ReadBackend {
+    Auto,       ///< io_uring when the kernel supports it, otherwise ThreadPool
+    IoUring,    ///< Batched openat/read/close submissions through io_uring
+    ThreadPool, ///< open/pread/close per file on a pool of worker threads
+};
+
+struct MyDataReadResult {
+    bool opened = false; ///< False if the file could not be opened or read
+    FRDMyData data{};    ///< File contents, read the same way as MyDataTest
+};
+
+/**
+ * Reads many small FRDMyData files. Like MyDataTest, up to sizeof(FRDMyData) bytes of each file
+ * are copied over a default constructed FRDMyData. Results are returned in the order of paths.
+ * An explicit IoUring request falls back to ThreadPool if io_uring is unavailable.
+ */
+[[nodiscard]] std::vector<MyDataReadResult> ReadMyDataFiles(std::span<const std::string> paths,
+                                                           ReadBackend backend = ReadBackend::Auto);
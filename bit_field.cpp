@@ -0,0 +1,212 @@
+#include <cstring>
+#include <immintrin.h>
+#include "bit_field.h"
+
+namespace {
+
+/// Eight values in the byte lanes of a u64, and the same values widened to u16 lanes
+typedef u8 ByteLanes __attribute__((vector_size(8)));
+typedef u16 WordLanes __attribute__((vector_size(16)));
+
+/// Low bits of each byte lane, where pdep/pext deposit and extract the values of a group
+constexpr u64 LaneMask(std::size_t bits) {
+    return 0x0101010101010101 * ((u64{1} << bits) - 1);
+}
+
+// The group size is a template parameter so that loads and stores compile to single moves
+
+/**
+ * The Bits bytes of a group as an integer whose lowest bits hold the last value in the group.
+ * Reads a whole word when the buffer extends far enough: assembling one from narrower loads
+ * stalls on store forwarding.
+ */
+template <std::size_t Bits>
+u64 LoadGroup(const u8* packed, bool big_endian, bool can_read_word) {
+    u64 group = 0;
+    if (can_read_word) {
+        std::memcpy(&group, packed, sizeof(group));
+    } else {
+        std::memcpy(&group, packed, Bits);
+    }
+    if (big_endian) {
+        return __builtin_bswap64(group) >> (64 - 8 * Bits);
+    }
+    return Bits == 8 ? group : group & ((u64{1} << (8 * Bits)) - 1);
+}
+
+/// Leading groups that are followed by enough bytes for LoadGroup to read a whole word
+template <std::size_t Bits>
+std::size_t WordGroups(std::size_t groups) {
+    return groups * Bits < 8 ? 0 : (groups * Bits - 8) / Bits + 1;
+}
+
+template <std::size_t Bits>
+void StoreGroup(u8* packed, bool big_endian, u64 group) {
+    if (big_endian) {
+        group = __builtin_bswap64(group << (64 - 8 * Bits));
+    }
+    std::memcpy(packed, &group, Bits);
+}
+
+// In big endian streams the first value is in the top bits of a group, so after pdep it lands in
+// the last byte lane; swapping the lanes restores the order
+
+template <std::size_t Bits>
+__attribute__((target("bmi2"))) u64 DepositGroup(const u8* packed, bool big_endian,
+                                                 bool can_read_word) {
+    const u64 lanes =
+        _pdep_u64(LoadGroup<Bits>(packed, big_endian, can_read_word), LaneMask(Bits));
+    return big_endian ? __builtin_bswap64(lanes) : lanes;
+}
+
+template <std::size_t Bits>
+__attribute__((target("bmi2"))) void ExtractGroup(u64 lanes, bool big_endian, u8* packed) {
+    lanes = big_endian ? __builtin_bswap64(lanes) : lanes;
+    StoreGroup<Bits>(packed, big_endian, _pext_u64(lanes, LaneMask(Bits)));
+}
+
+template <std::size_t Bits>
+__attribute__((target("avx2,bmi2"))) void UnpackBmi2(const u8* packed, std::size_t groups,
+                                                     bool big_endian, u8* out) {
+    const std::size_t word_groups = WordGroups<Bits>(groups);
+    for (std::size_t group = 0; group < groups; group++) {
+        const u64 lanes = DepositGroup<Bits>(packed + group * Bits, big_endian,
+                                                      group < word_groups);
+        std::memcpy(out + group * 8, &lanes, sizeof(lanes));
+    }
+}
+
+template <std::size_t Bits>
+__attribute__((target("avx2,bmi2"))) void UnpackBmi2(const u8* packed, std::size_t groups,
+                                                     bool big_endian, u16* out) {
+    const std::size_t word_groups = WordGroups<Bits>(groups);
+    for (std::size_t group = 0; group < groups; group++) {
+        ByteLanes lanes;
+        const u64 deposited = DepositGroup<Bits>(packed + group * Bits, big_endian,
+                                                      group < word_groups);
+        std::memcpy(&lanes, &deposited, sizeof(lanes));
+        const WordLanes widened = __builtin_convertvector(lanes, WordLanes);
+        std::memcpy(out + group * 8, &widened, sizeof(widened));
+    }
+}
+
+template <std::size_t Bits>
+__attribute__((target("avx2,bmi2"))) void PackBmi2(const u8* values, std::size_t groups,
+                                                   bool big_endian, u8* packed) {
+    for (std::size_t group = 0; group < groups; group++) {
+        u64 lanes;
+        std::memcpy(&lanes, values + group * 8, sizeof(lanes));
+        ExtractGroup<Bits>(lanes, big_endian, packed + group * Bits);
+    }
+}
+
+template <std::size_t Bits>
+__attribute__((target("avx2,bmi2"))) void PackBmi2(const u16* values, std::size_t groups,
+                                                   bool big_endian, u8* packed) {
+    for (std::size_t group = 0; group < groups; group++) {
+        WordLanes words;
+        std::memcpy(&words, values + group * 8, sizeof(words));
+        const ByteLanes narrowed = __builtin_convertvector(words, ByteLanes);
+        u64 lanes;
+        std::memcpy(&lanes, &narrowed, sizeof(lanes));
+        ExtractGroup<Bits>(lanes, big_endian, packed + group * Bits);
+    }
+}
+
+/// Calls func with bits (1 to 8) as a std::integral_constant
+template <typename Func>
+void WithBits(std::size_t bits, Func&& func) {
+    switch (bits) {
+    case 1:
+        return func(std::integral_constant<std::size_t, 1>{});
+    case 2:
+        return func(std::integral_constant<std::size_t, 2>{});
+    case 3:
+        return func(std::integral_constant<std::size_t, 3>{});
+    case 4:
+        return func(std::integral_constant<std::size_t, 4>{});
+    case 5:
+        return func(std::integral_constant<std::size_t, 5>{});
+    case 6:
+        return func(std::integral_constant<std::size_t, 6>{});
+    case 7:
+        return func(std::integral_constant<std::size_t, 7>{});
+    default:
+        return func(std::integral_constant<std::size_t, 8>{});
+    }
+}
+
+/// The kernels need BMI2 for pdep and pext, and AVX2 to widen and narrow lanes
+bool HasBmi2() {
+    static const bool supported = __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+template <typename T>
+void UnpackPortable(const u8* packed, std::size_t groups, std::size_t bits, bool big_endian,
+                    T* out) {
+    const std::span<const u8> bytes(packed, groups * bits);
+    for (std::size_t i = 0; i < groups * 8; i++) {
+        out[i] = static_cast<T>(big_endian ? ReadPackedBits<BETag>(bytes, i * bits, bits)
+                                           : ReadPackedBits<LETag>(bytes, i * bits, bits));
+    }
+}
+
+template <typename T>
+void PackPortable(const T* values, std::size_t groups, std::size_t bits, bool big_endian,
+                  u8* packed) {
+    const std::span<u8> bytes(packed, groups * bits);
+    for (std::size_t i = 0; i < groups * 8; i++) {
+        if (big_endian) {
+            WritePackedBits<BETag>(bytes, i * bits, bits, values[i]);
+        } else {
+            WritePackedBits<LETag>(bytes, i * bits, bits, values[i]);
+        }
+    }
+}
+
+} // namespace
+
+void UnpackBitGroups(const u8* packed, std::size_t groups, std::size_t bits, bool big_endian,
+                     u8* out) {
+    if (HasBmi2()) {
+        WithBits(bits, [&](auto group_bits) {
+            UnpackBmi2<group_bits>(packed, groups, big_endian, out);
+        });
+    } else {
+        UnpackPortable(packed, groups, bits, big_endian, out);
+    }
+}
+
+void UnpackBitGroups(const u8* packed, std::size_t groups, std::size_t bits, bool big_endian,
+                     u16* out) {
+    if (HasBmi2()) {
+        WithBits(bits, [&](auto group_bits) {
+            UnpackBmi2<group_bits>(packed, groups, big_endian, out);
+        });
+    } else {
+        UnpackPortable(packed, groups, bits, big_endian, out);
+    }
+}
+
+void PackBitGroups(const u8* values, std::size_t groups, std::size_t bits, bool big_endian,
+                   u8* packed) {
+    if (HasBmi2()) {
+        WithBits(bits, [&](auto group_bits) {
+            PackBmi2<group_bits>(values, groups, big_endian, packed);
+        });
+    } else {
+        PackPortable(values, groups, bits, big_endian, packed);
+    }
+}
+
+void PackBitGroups(const u16* values, std::size_t groups, std::size_t bits, bool big_endian,
+                   u8* packed) {
+    if (HasBmi2()) {
+        WithBits(bits, [&](auto group_bits) {
+            PackBmi2<group_bits>(values, groups, big_endian, packed);
+        });
+    } else {
+        PackPortable(values, groups, bits, big_endian, packed);
+    }
+}
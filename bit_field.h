@@ -30,8 +30,12 @@
 
 #pragma once
 
+#include <array>
+#include <bit>
 #include <cstddef>
+#include <cstdint>
 #include <limits>
+#include <span>
 #include <type_traits>
 #include "swap.h"
 
@@ -179,6 +183,27 @@ public:
         return ExtractValue(storage);
     }
 
+    /**
+     * Assigns value to this field through raw, the raw member of the field's union, so that raw
+     * stays the active member. Unlike Assign this works in constant expressions, which can only
+     * read the union member last written. raw may have a different byte order than the field: the
+     * bits land where Assign would put them in the bytes both share.
+     */
+    template <typename Raw>
+    static constexpr void AssignRaw(Raw& raw, const T& value) {
+        static_assert(sizeof(Raw) == sizeof(StorageTypeWithEndian), "raw must overlay the field");
+        const auto storage = static_cast<StorageType>(std::bit_cast<StorageTypeWithEndian>(raw));
+        const auto updated = static_cast<StorageType>((storage & ~mask) | FormatValue(value));
+        raw = std::bit_cast<Raw>(StorageTypeWithEndian(updated));
+    }
+
+    /// Reads this field through raw, the raw member of the field's union; the inverse of AssignRaw
+    template <typename Raw>
+    [[nodiscard]] static constexpr T ExtractRaw(const Raw& raw) {
+        static_assert(sizeof(Raw) == sizeof(StorageTypeWithEndian), "raw must overlay the field");
+        return ExtractValue(static_cast<StorageType>(std::bit_cast<StorageTypeWithEndian>(raw)));
+    }
+
     [[nodiscard]] constexpr explicit operator bool() const {
         return Value() != 0;
     }
@@ -198,3 +223,132 @@ private:
 
 template <std::size_t Position, std::size_t Bits, typename T>
 using BitFieldBE = BitField<Position, Bits, T, BETag>;
+
+/*
+ * Packed array of unsigned bit fields
+ *
+ * BitFieldArray<Bits, Count, EndianTag> stores Count values of Bits (1 to 16) bits back to back in
+ * (Bits * Count + 7) / 8 bytes, so values freely cross byte boundaries: 3-bit values take 3/8 of
+ * the space of one byte per value. With LETag each byte is filled from its least significant bit,
+ * with BETag from its most significant bit, as in a big endian bit stream.
+ *
+ * Get and Set work on single values and are constexpr. Pack and Unpack convert runs of values
+ * to and from u8 or u16 spans; for fields of up to 8 bits they go through bulk kernels that
+ * deposit or extract eight values per pdep/pext instruction on CPUs with BMI2 and AVX2.
+ */
+
+/// Reads bits (1 to 16) bits starting at bit offset of a packed bit stream
+template <typename EndianTag>
+[[nodiscard]] constexpr u32 ReadPackedBits(std::span<const u8> bytes, std::size_t offset,
+                                           std::size_t bits) {
+    constexpr bool big_endian = std::is_same_v<EndianTag, BETag>;
+    const std::size_t first = offset / 8;
+    u32 window = 0;
+    for (std::size_t i = 0; i < 3 && first + i < bytes.size(); i++) {
+        window |= u32{bytes[first + i]} << (big_endian ? 16 - 8 * i : 8 * i);
+    }
+    const std::size_t shift = big_endian ? 24 - offset % 8 - bits : offset % 8;
+    return (window >> shift) & ((u32{1} << bits) - 1);
+}
+
+/// Writes the low bits (1 to 16) bits of value starting at bit offset of a packed bit stream
+template <typename EndianTag>
+constexpr void WritePackedBits(std::span<u8> bytes, std::size_t offset, std::size_t bits,
+                               u32 value) {
+    constexpr bool big_endian = std::is_same_v<EndianTag, BETag>;
+    const std::size_t first = offset / 8;
+    const std::size_t shift = big_endian ? 24 - offset % 8 - bits : offset % 8;
+    const u32 mask = ((u32{1} << bits) - 1) << shift;
+    const u32 field = (value << shift) & mask;
+    for (std::size_t i = 0; i < 3 && first + i < bytes.size(); i++) {
+        const std::size_t byte_shift = big_endian ? 16 - 8 * i : 8 * i;
+        bytes[first + i] = static_cast<u8>((bytes[first + i] & ~(mask >> byte_shift)) |
+                                           (field >> byte_shift));
+    }
+}
+
+/**
+ * Bulk kernels behind BitFieldArray::Pack and Unpack. They convert groups of eight values of bits
+ * (1 to 8) bits, each group being exactly bits bytes of the packed stream.
+ */
+void UnpackBitGroups(const u8* packed, std::size_t groups, std::size_t bits, bool big_endian,
+                     u8* out);
+void UnpackBitGroups(const u8* packed, std::size_t groups, std::size_t bits, bool big_endian,
+                     u16* out);
+void PackBitGroups(const u8* values, std::size_t groups, std::size_t bits, bool big_endian,
+                   u8* packed);
+void PackBitGroups(const u16* values, std::size_t groups, std::size_t bits, bool big_endian,
+                   u8* packed);
+
+template <std::size_t Bits, std::size_t Count, typename EndianTag = LETag>
+struct BitFieldArray {
+    /// Smallest of u8 and u16 that holds a value
+    using ValueType = std::conditional_t<(Bits <= 8), u8, u16>;
+
+    static constexpr std::size_t bits = Bits;
+    static constexpr std::size_t count = Count;
+    static constexpr std::size_t size_bytes = (Bits * Count + 7) / 8;
+    static constexpr ValueType mask = static_cast<ValueType>((u32{1} << Bits) - 1);
+
+    [[nodiscard]] constexpr ValueType Get(std::size_t index) const {
+        return static_cast<ValueType>(ReadPackedBits<EndianTag>(bytes, index * Bits, Bits));
+    }
+
+    /// Stores the low Bits bits of value
+    constexpr void Set(std::size_t index, ValueType value) {
+        WritePackedBits<EndianTag>(bytes, index * Bits, Bits, value);
+    }
+
+    /// Unpacks values [first, first + out.size()) into out
+    template <typename T>
+    constexpr void Unpack(std::span<T> out, std::size_t first = 0) const {
+        static_assert(std::is_same_v<T, u8> || std::is_same_v<T, u16>);
+        static_assert(sizeof(T) >= sizeof(ValueType), "Values do not fit in the output type");
+        Convert(out, first, [this](std::size_t index, T& value) { value = Get(index); },
+                [this](std::size_t index, std::span<T> group_out) {
+                    UnpackBitGroups(bytes.data() + index / 8 * Bits, group_out.size() / 8, Bits,
+                                    std::is_same_v<EndianTag, BETag>, group_out.data());
+                });
+    }
+
+    /// Stores the low Bits bits of every value as values [first, first + values.size())
+    template <typename T>
+    constexpr void Pack(std::span<const T> values, std::size_t first = 0) {
+        static_assert(std::is_same_v<T, u8> || std::is_same_v<T, u16>);
+        Convert(values, first,
+                [this](std::size_t index, const T& value) {
+                    Set(index, static_cast<ValueType>(value));
+                },
+                [this](std::size_t index, std::span<const T> group_values) {
+                    PackBitGroups(group_values.data(), group_values.size() / 8, Bits,
+                                  std::is_same_v<EndianTag, BETag>,
+                                  bytes.data() + index / 8 * Bits);
+                });
+    }
+
+    std::array<u8, size_bytes> bytes{};
+
+private:
+    /// Handles values one at a time up to a multiple of eight, whole groups in bulk, then the tail
+    template <typename Span, typename One, typename Groups>
+    constexpr void Convert(Span values, std::size_t first, One&& one, Groups&& groups) const {
+        std::size_t i = 0;
+        if constexpr (Bits <= 8) {
+            if (!std::is_constant_evaluated()) {
+                for (; i < values.size() && (first + i) % 8 != 0; i++) {
+                    one(first + i, values[i]);
+                }
+                const std::size_t bulk = (values.size() - i) / 8 * 8;
+                if (bulk != 0) {
+                    groups(first + i, values.subspan(i, bulk));
+                    i += bulk;
+                }
+            }
+        }
+        for (; i < values.size(); i++) {
+            one(first + i, values[i]);
+        }
+    }
+
+    static_assert(Bits > 0 && Bits <= 16, "Invalid number of bits");
+};
@@ -0,0 +1,165 @@
+#include <cstdio>
+#include <cstring>
+#include "bloom_filter.h"
+
+namespace {
+
+constexpr std::array<char, 8> BLOOM_FILTER_MAGIC{'F', 'R', 'D', 'B', 'L', 'O', 'O', 'M'};
+constexpr std::size_t PREFETCH_DISTANCE = 8;
+
+/// Odd constants multiplied into the low hash bits to pick one bit per word
+constexpr std::array<u32, 8> SALT{0x47B6137B, 0x44974D91, 0x8824AD5B, 0xA2B7289D,
+                                  0x705495C7, 0x2DF1424B, 0x9EFC4947, 0x5C6BFB31};
+
+/// Eight u32 lanes; GCC lowers this to AVX2 or to pairs of SSE2 registers depending on the target
+typedef u32 LaneVector __attribute__((vector_size(32)));
+
+std::size_t BlockIndex(u64 hash, std::size_t block_count) {
+    return static_cast<std::size_t>(((hash >> 32) * block_count) >> 32);
+}
+
+// Macro rather than a function, as passing 32 byte vectors by value to a non-AVX function changes
+// the ABI between the target clones
+#define BLOCK_MASK(hash)                                                                           \
+    (LaneVector{1, 1, 1, 1, 1, 1, 1, 1}                                                            \
+     << ((LaneVector{} + static_cast<u32>(hash)) *                                                 \
+             LaneVector{SALT[0], SALT[1], SALT[2], SALT[3], SALT[4], SALT[5], SALT[6], SALT[7]} >> \
+         27))
+
+__attribute__((target_clones("avx2", "default"))) bool Probe(const BloomFilter::Block& block,
+                                                             u64 hash) {
+    LaneVector words;
+    std::memcpy(&words, block.words.data(), sizeof(words));
+    const LaneVector mask = BLOCK_MASK(hash);
+    const LaneVector missing = (words & mask) ^ mask;
+    u32 any = 0;
+    for (int lane = 0; lane < 8; lane++) {
+        any |= missing[lane];
+    }
+    return any == 0;
+}
+
+__attribute__((target_clones("avx2", "default"))) void Set(BloomFilter::Block& block, u64 hash) {
+    LaneVector words;
+    std::memcpy(&words, block.words.data(), sizeof(words));
+    words |= BLOCK_MASK(hash);
+    std::memcpy(block.words.data(), &words, sizeof(words));
+}
+
+#undef BLOCK_MASK
+
+struct FileHeader {
+    std::array<char, 8> magic;
+    u64 block_count;
+};
+
+} // namespace
+
+u64 BloomHash(std::span<const u8> key) {
+    u64 hash = BloomHash(key.size());
+    while (key.size() >= 8) {
+        u64 chunk;
+        std::memcpy(&chunk, key.data(), sizeof(chunk));
+        hash = BloomHash(hash ^ chunk);
+        key = key.subspan(8);
+    }
+    u64 tail = 0;
+    std::memcpy(&tail, key.data(), key.size());
+    return BloomHash(hash ^ tail ^ 0x9E3779B97F4A7C15);
+}
+
+BloomFilter::BloomFilter(std::size_t expected_keys, std::size_t bits_per_key)
+    : storage(std::max<std::size_t>((expected_keys * bits_per_key + 255) / 256, 1)),
+      blocks(storage.data()), block_count(storage.size()) {}
+
+BloomFilter::BloomFilter(BloomFilter&& other) noexcept {
+    *this = std::move(other);
+}
+
+BloomFilter& BloomFilter::operator=(BloomFilter&& other) noexcept {
+    const bool owned = other.blocks == other.storage.data() && !other.storage.empty();
+    storage = std::move(other.storage);
+    blocks = owned ? storage.data() : other.blocks;
+    block_count = other.block_count;
+    other.blocks = nullptr;
+    other.block_count = 0;
+    return *this;
+}
+
+BloomFilter BloomFilter::View(std::span<const u8> bytes) {
+    BloomFilter filter;
+    filter.blocks = reinterpret_cast<const Block*>(bytes.data());
+    filter.block_count = bytes.size() / sizeof(Block);
+    return filter;
+}
+
+void BloomFilter::Insert(u64 hash) {
+    Set(storage[BlockIndex(hash, block_count)], hash);
+}
+
+bool BloomFilter::MayContain(u64 hash) const {
+    return block_count == 0 || Probe(blocks[BlockIndex(hash, block_count)], hash);
+}
+
+void BloomFilter::MayContain(std::span<const u64> hashes, std::span<u64> bitmap) const {
+    std::fill_n(bitmap.begin(), (hashes.size() + 63) / 64, block_count == 0 ? ~u64{0} : 0);
+    if (block_count == 0) {
+        return;
+    }
+    for (std::size_t i = 0; i < hashes.size(); i++) {
+        if (i + PREFETCH_DISTANCE < hashes.size()) {
+            __builtin_prefetch(&blocks[BlockIndex(hashes[i + PREFETCH_DISTANCE], block_count)]);
+        }
+        if (Probe(blocks[BlockIndex(hashes[i], block_count)], hashes[i])) {
+            bitmap[i / 64] |= u64{1} << (i % 64);
+        }
+    }
+}
+
+bool BloomFilter::Merge(const BloomFilter& other) {
+    if (other.block_count != block_count || storage.size() != block_count) {
+        return false;
+    }
+    for (std::size_t i = 0; i < block_count; i++) {
+        for (std::size_t word = 0; word < 8; word++) {
+            storage[i].words[word] |= other.blocks[i].words[word];
+        }
+    }
+    return true;
+}
+
+bool BloomFilter::Save(const std::string& path) const {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    const FileHeader header{BLOOM_FILTER_MAGIC, block_count};
+    const bool written = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                         std::fwrite(blocks, sizeof(Block), block_count, file) == block_count;
+    return std::fclose(file) == 0 && written;
+}
+
+bool BloomFilter::Load(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    FileHeader header;
+    bool loaded = std::fseek(file, 0, SEEK_END) == 0;
+    const long size = std::ftell(file);
+    loaded = loaded && std::fseek(file, 0, SEEK_SET) == 0 &&
+             std::fread(&header, sizeof(header), 1, file) == 1 &&
+             header.magic == BLOOM_FILTER_MAGIC &&
+             header.block_count == (size - sizeof(header)) / sizeof(Block);
+    if (loaded) {
+        storage.resize(header.block_count);
+        loaded = std::fread(storage.data(), sizeof(Block), storage.size(), file) == storage.size();
+    }
+    std::fclose(file);
+    if (!loaded) {
+        storage.clear();
+    }
+    blocks = storage.data();
+    block_count = storage.size();
+    return loaded;
+}
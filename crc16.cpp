@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <array>
+#include <vector>
+#include "crc16.h"
+#include "parallel.h"
+
+namespace {
+
+/// TABLES[k][b] is the CRC contribution of byte b followed by k zero bytes, for slicing by 8
+constexpr auto TABLES = [] {
+    std::array<std::array<u16, 256>, 8> tables{};
+    for (unsigned byte = 0; byte < 256; byte++) {
+        u16 crc = static_cast<u16>(byte << 8);
+        for (int bit = 0; bit < 8; bit++) {
+            crc = static_cast<u16>(crc & 0x8000 ? (crc << 1) ^ CRC16_POLYNOMIAL : crc << 1);
+        }
+        tables[0][byte] = crc;
+    }
+    for (std::size_t k = 1; k < tables.size(); k++) {
+        for (unsigned byte = 0; byte < 256; byte++) {
+            const u16 previous = tables[k - 1][byte];
+            tables[k][byte] = static_cast<u16>((previous << 8) ^ tables[0][previous >> 8]);
+        }
+    }
+    return tables;
+}();
+
+/// 16x16 matrix over GF(2), stored as one column per bit of the input
+using Matrix = std::array<u16, 16>;
+
+u16 Multiply(const Matrix& matrix, u16 vector) {
+    u16 result = 0;
+    for (int bit = 0; vector != 0; bit++, vector >>= 1) {
+        if (vector & 1) {
+            result ^= matrix[bit];
+        }
+    }
+    return result;
+}
+
+Matrix Square(const Matrix& matrix) {
+    Matrix result;
+    for (int bit = 0; bit < 16; bit++) {
+        result[bit] = Multiply(matrix, matrix[bit]);
+    }
+    return result;
+}
+
+/// ZERO_BYTE_POWERS[i] advances a CRC register over 2^i zero bytes
+const std::array<Matrix, 64> ZERO_BYTE_POWERS = [] {
+    // Operator for a single zero bit: shift left, XOR in the polynomial when the top bit falls out
+    Matrix zero_bit;
+    for (int bit = 0; bit < 15; bit++) {
+        zero_bit[bit] = static_cast<u16>(1 << (bit + 1));
+    }
+    zero_bit[15] = CRC16_POLYNOMIAL;
+
+    std::array<Matrix, 64> powers;
+    powers[0] = Square(Square(Square(zero_bit)));
+    for (std::size_t i = 1; i < powers.size(); i++) {
+        powers[i] = Square(powers[i - 1]);
+    }
+    return powers;
+}();
+
+/// Records advanced together by Crc16Batch; each one is a separate dependency chain
+constexpr std::size_t BATCH_LANES = 4;
+
+u16 Step8(u16 crc, const u8* bytes) {
+    return TABLES[7][bytes[0] ^ (crc >> 8)] ^ TABLES[6][bytes[1] ^ (crc & 0xFF)] ^
+           TABLES[5][bytes[2]] ^ TABLES[4][bytes[3]] ^ TABLES[3][bytes[4]] ^ TABLES[2][bytes[5]] ^
+           TABLES[1][bytes[6]] ^ TABLES[0][bytes[7]];
+}
+
+void Crc16BatchSerial(const u8* data, std::size_t stride, std::size_t length, std::span<u16> crcs) {
+    std::size_t record = 0;
+    for (; record + BATCH_LANES <= crcs.size(); record += BATCH_LANES) {
+        const u8* lane0 = data + record * stride;
+        const u8* lane1 = lane0 + stride;
+        const u8* lane2 = lane1 + stride;
+        const u8* lane3 = lane2 + stride;
+        u16 crc0 = 0, crc1 = 0, crc2 = 0, crc3 = 0;
+        std::size_t offset = 0;
+        for (; offset + 8 <= length; offset += 8) {
+            crc0 = Step8(crc0, lane0 + offset);
+            crc1 = Step8(crc1, lane1 + offset);
+            crc2 = Step8(crc2, lane2 + offset);
+            crc3 = Step8(crc3, lane3 + offset);
+        }
+        const std::size_t tail = length - offset;
+        crcs[record] = Crc16Update(crc0, std::as_bytes(std::span(lane0 + offset, tail)));
+        crcs[record + 1] = Crc16Update(crc1, std::as_bytes(std::span(lane1 + offset, tail)));
+        crcs[record + 2] = Crc16Update(crc2, std::as_bytes(std::span(lane2 + offset, tail)));
+        crcs[record + 3] = Crc16Update(crc3, std::as_bytes(std::span(lane3 + offset, tail)));
+    }
+    for (; record < crcs.size(); record++) {
+        crcs[record] = Crc16Update(0, std::as_bytes(std::span(data + record * stride, length)));
+    }
+}
+
+} // namespace
+
+u16 Crc16Update(u16 crc, std::span<const std::byte> data) {
+    const auto* bytes = reinterpret_cast<const u8*>(data.data());
+    std::size_t size = data.size();
+
+    while (size >= 8) {
+        crc = Step8(crc, bytes);
+        bytes += 8;
+        size -= 8;
+    }
+    for (; size != 0; bytes++, size--) {
+        crc = static_cast<u16>((crc << 8) ^ TABLES[0][(crc >> 8) ^ *bytes]);
+    }
+    return crc;
+}
+
+u16 Crc16Combine(u16 crc_a, u16 crc_b, u64 length_b) {
+    // With a zero initial value and no final XOR the CRC is linear, so CRC(A + B) is CRC(A) pushed
+    // through length_b zero bytes, XORed with CRC(B)
+    for (std::size_t i = 0; length_b != 0; i++, length_b >>= 1) {
+        if (length_b & 1) {
+            crc_a = Multiply(ZERO_BYTE_POWERS[i], crc_a);
+        }
+    }
+    return crc_a ^ crc_b;
+}
+
+u16 Crc16(std::span<const std::byte> data) {
+    if (data.size() < PARALLEL_CRC16_MIN_SIZE) {
+        return Crc16Update(0, data);
+    }
+
+    const std::size_t chunk_size = PARALLEL_CRC16_MIN_SIZE / 4;
+    const std::size_t chunks = (data.size() + chunk_size - 1) / chunk_size;
+    std::vector<u16> partial(chunks);
+    ParallelFor(
+        chunks,
+        [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; i++) {
+                partial[i] = Crc16Update(0, data.subspan(i * chunk_size).first(
+                                                std::min(chunk_size, data.size() - i * chunk_size)));
+            }
+        },
+        1);
+
+    u16 crc = partial[0];
+    for (std::size_t i = 1; i < chunks; i++) {
+        crc = Crc16Combine(crc, partial[i], std::min(chunk_size, data.size() - i * chunk_size));
+    }
+    return crc;
+}
+
+void Crc16Batch(const std::byte* data, std::size_t stride, std::size_t length, std::span<u16> crcs) {
+    const auto* bytes = reinterpret_cast<const u8*>(data);
+    ParallelFor(
+        crcs.size(),
+        [&](std::size_t begin, std::size_t end) {
+            Crc16BatchSerial(bytes + begin * stride, stride, length, crcs.subspan(begin, end - begin));
+        },
+        std::max<std::size_t>(PARALLEL_CRC16_MIN_SIZE / std::max<std::size_t>(length, 1), 1));
+}
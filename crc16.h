@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include "swap.h"
+
+/// Inputs at least this large are split across worker threads by Crc16
+inline constexpr std::size_t PARALLEL_CRC16_MIN_SIZE = 0x400000;
+
+inline constexpr u16 CRC16_POLYNOMIAL = 0x1021;
+
+/**
+ * CRC16-CCITT with polynomial 0x1021, initial value 0, no reflection and no final XOR; the checksum
+ * used by ChecksummedMiiData. Large inputs are split across worker threads and the partial CRCs are
+ * merged with Crc16Combine.
+ */
+[[nodiscard]] u16 Crc16(std::span<const std::byte> data);
+
+/// Continues crc over more data, so Crc16Update(Crc16(a), b) == Crc16(a + b). Single threaded.
+[[nodiscard]] u16 Crc16Update(u16 crc, std::span<const std::byte> data);
+
+/**
+ * CRC of each of crcs.size() records of length bytes, the i-th starting at data + i * stride.
+ * Advances several records in lockstep so that their table lookups overlap, and splits large
+ * batches across worker threads like Crc16.
+ */
+void Crc16Batch(const std::byte* data, std::size_t stride, std::size_t length, std::span<u16> crcs);
+
+/// CRC of the concatenation A + B, given Crc16(A), Crc16(B) and the length of B in bytes
+[[nodiscard]] u16 Crc16Combine(u16 crc_a, u16 crc_b, u64 length_b);
+
+/**
+ * Same CRC as Crc16, one bit at a time so that it can run in constant expressions, e.g. to
+ * checksum records baked into the binary. Far slower than Crc16 at runtime.
+ */
+[[nodiscard]] constexpr u16 ConstexprCrc16(std::span<const std::byte> data) {
+    u16 crc = 0;
+    for (const std::byte byte : data) {
+        crc ^= static_cast<u16>(std::to_integer<u16>(byte) << 8);
+        for (int bit = 0; bit < 8; bit++) {
+            crc = static_cast<u16>(crc & 0x8000 ? (crc << 1) ^ CRC16_POLYNOMIAL : crc << 1);
+        }
+    }
+    return crc;
+}
+
+static_assert(
+    [] {
+        constexpr std::string_view check = "123456789";
+        std::array<std::byte, check.size()> bytes{};
+        for (std::size_t i = 0; i < check.size(); i++) {
+            bytes[i] = static_cast<std::byte>(check[i]);
+        }
+        return ConstexprCrc16(bytes);
+    }() == 0x31C3,
+    "ConstexprCrc16 does not match the CRC16-CCITT (XMODEM) check value");
@@ -0,0 +1,75 @@
+#include <algorithm>
+#include "decode_cache.h"
+
+DecodeCache::DecodeCache(std::size_t capacity)
+    : shard_capacity(std::max<std::size_t>(capacity / SHARD_COUNT, 1)),
+      shards(std::make_unique<Shard[]>(SHARD_COUNT)) {
+    for (std::size_t i = 0; i < SHARD_COUNT; i++) {
+        shards[i].slots.reserve(shard_capacity);
+        shards[i].index.reserve(shard_capacity);
+    }
+}
+
+bool DecodeCache::Lookup(u64 system_id, u32 mii_id, u16 crc16, std::string& out) {
+    const Key key{system_id, mii_id};
+    Shard& shard = ShardOf(key);
+    {
+        std::scoped_lock lock{shard.mutex};
+        const auto it = shard.index.find(key);
+        if (it != shard.index.end() && shard.slots[it->second].crc16 == crc16) {
+            Slot& slot = shard.slots[it->second];
+            slot.referenced = true;
+            out += slot.value;
+            shard.hits.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    shard.misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void DecodeCache::Insert(u64 system_id, u32 mii_id, u16 crc16, std::string_view value) {
+    if (value.size() > MAX_VALUE_SIZE) {
+        return;
+    }
+    const Key key{system_id, mii_id};
+    Shard& shard = ShardOf(key);
+    std::scoped_lock lock{shard.mutex};
+
+    std::size_t target;
+    if (const auto it = shard.index.find(key); it != shard.index.end()) {
+        target = it->second;
+    } else if (shard.slots.size() < shard_capacity) {
+        target = shard.slots.size();
+        shard.slots.emplace_back();
+        shard.index.emplace(key, target);
+    } else {
+        // Give every referenced slot a second chance, evict the first one that is not
+        while (shard.slots[shard.hand].referenced) {
+            shard.slots[shard.hand].referenced = false;
+            shard.hand = (shard.hand + 1) % shard.slots.size();
+        }
+        target = shard.hand;
+        shard.hand = (shard.hand + 1) % shard.slots.size();
+        shard.index.erase(shard.slots[target].key);
+        shard.index.emplace(key, target);
+        shard.evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Slot& slot = shard.slots[target];
+    slot.key = key;
+    slot.crc16 = crc16;
+    slot.referenced = false;
+    // Assigning reuses the evicted value's buffer
+    slot.value.assign(value);
+}
+
+DecodeCacheStats DecodeCache::Stats() const {
+    DecodeCacheStats stats;
+    for (std::size_t i = 0; i < SHARD_COUNT; i++) {
+        stats.hits += shards[i].hits.load(std::memory_order_relaxed);
+        stats.misses += shards[i].misses.load(std::memory_order_relaxed);
+        stats.evictions += shards[i].evictions.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
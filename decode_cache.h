@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "swap.h"
+
+struct DecodeCacheStats {
+    u64 hits = 0;
+    u64 misses = 0;
+    u64 evictions = 0;
+};
+
+/**
+ * Bounded cache of decoded, formatted Mii text keyed by MiiData::system_id and mii_id. Keys are
+ * spread over independently locked shards, each evicting with the CLOCK algorithm, so concurrent
+ * readers only contend when they hit the same shard. Entries also store the Mii's crc16, and a
+ * lookup with a different crc16 misses, so a changed Mii that keeps its identity is never served
+ * stale text.
+ */
+class DecodeCache {
+public:
+    static constexpr std::size_t DEFAULT_CAPACITY = 0x10000;
+    static constexpr std::size_t SHARD_COUNT = 16;
+    /// Longer values are returned to the caller but not cached, which bounds memory use
+    static constexpr std::size_t MAX_VALUE_SIZE = 0x100;
+
+    explicit DecodeCache(std::size_t capacity = DEFAULT_CAPACITY);
+
+    /// Appends the cached value to out; returns false on a miss
+    bool Lookup(u64 system_id, u32 mii_id, u16 crc16, std::string& out);
+
+    void Insert(u64 system_id, u32 mii_id, u16 crc16, std::string_view value);
+
+    /// Appends the cached value to out, or appends with format(out) and caches what it appended
+    template <typename Format>
+    void Append(u64 system_id, u32 mii_id, u16 crc16, std::string& out, Format&& format) {
+        if (Lookup(system_id, mii_id, crc16, out)) {
+            return;
+        }
+        const std::size_t start = out.size();
+        format(out);
+        Insert(system_id, mii_id, crc16, std::string_view(out).substr(start));
+    }
+
+    [[nodiscard]] DecodeCacheStats Stats() const;
+
+private:
+    struct Key {
+        u64 system_id;
+        u32 mii_id;
+
+        bool operator==(const Key&) const = default;
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key& key) const {
+            return (key.system_id ^ key.mii_id) * 0x9E3779B97F4A7C15 >> 16;
+        }
+    };
+
+    struct Slot {
+        Key key;
+        u16 crc16;
+        bool referenced; ///< Set by every hit, cleared as the CLOCK hand passes
+        std::string value;
+    };
+
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::vector<Slot> slots;
+        std::unordered_map<Key, std::size_t, KeyHash> index;
+        std::size_t hand = 0;
+        std::atomic<u64> hits = 0;
+        std::atomic<u64> misses = 0;
+        std::atomic<u64> evictions = 0;
+    };
+
+    Shard& ShardOf(const Key& key) {
+        // High bits, so keys within a shard still spread over the shard's hash buckets
+        return shards[(KeyHash{}(key) >> 40) % SHARD_COUNT];
+    }
+
+    std::size_t shard_capacity;
+    std::unique_ptr<Shard[]> shards;
+};
@@ -0,0 +1,53 @@
+#include <algorithm>
+#include <cassert>
+#include "decoded_mii_data.h"
+
+DecodedMiiData Decode(const MiiData& mii) {
+    DecodedMiiData decoded;
+
+#define DECODE_SCALAR(name) decoded.name = mii.name;
+#define DECODE_ARRAY(name) std::copy(mii.name.begin(), mii.name.end(), decoded.name.begin());
+#define DECODE_BITFIELD(group, field) decoded.group##_##field = mii.group.field.Value();
+
+    MII_DATA_SCALARS(DECODE_SCALAR)
+    MII_DATA_ARRAYS(DECODE_ARRAY)
+    MII_DATA_BITFIELDS(DECODE_BITFIELD)
+
+#undef DECODE_SCALAR
+#undef DECODE_ARRAY
+#undef DECODE_BITFIELD
+
+    return decoded;
+}
+
+ChecksummedMiiData Encode(const DecodedMiiData& decoded) {
+    MiiData mii;
+
+#define ENCODE_SCALAR(name) mii.name = decoded.name;
+#define ENCODE_ARRAY(name) std::copy(decoded.name.begin(), decoded.name.end(), mii.name.begin());
+#define ENCODE_BITFIELD(group, field) mii.group.field.Assign(decoded.group##_##field);
+
+    MII_DATA_SCALARS(ENCODE_SCALAR)
+    MII_DATA_ARRAYS(ENCODE_ARRAY)
+    MII_DATA_BITFIELDS(ENCODE_BITFIELD)
+
+#undef ENCODE_SCALAR
+#undef ENCODE_ARRAY
+#undef ENCODE_BITFIELD
+
+    return ChecksummedMiiData(mii);
+}
+
+void DecodeBatch(std::span<const ChecksummedMiiData> in, std::span<DecodedMiiData> out) {
+    assert(out.size() >= in.size());
+    for (std::size_t i = 0; i < in.size(); i++) {
+        out[i] = Decode(in[i].mii_data);
+    }
+}
+
+void EncodeBatch(std::span<const DecodedMiiData> in, std::span<ChecksummedMiiData> out) {
+    assert(out.size() >= in.size());
+    for (std::size_t i = 0; i < in.size(); i++) {
+        out[i] = Encode(in[i]);
+    }
+}
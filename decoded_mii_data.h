@@ -0,0 +1,60 @@
+#pragma once
+
+#include <span>
+#include "main.h"
+
+/// Native type used to hold a member of a packed record once decoded
+template <typename T>
+struct NativeType {
+    using type = T;
+};
+
+template <typename T, typename F>
+struct NativeType<swap_struct_t<T, F>> {
+    using type = T;
+};
+
+template <typename T, std::size_t N>
+struct NativeType<std::array<T, N>> {
+    using type = std::array<typename NativeType<T>::type, N>;
+};
+
+template <typename T>
+using NativeTypeT = typename NativeType<T>::type;
+
+/// Smallest unsigned type able to hold a BitField of the given width
+template <std::size_t Bits>
+using DecodedFieldType =
+    std::conditional_t<Bits <= 8, u8, std::conditional_t<Bits <= 16, u16, u32>>;
+
+/**
+ * MiiData with every member, including each BitField, stored as a plain native-endian value.
+ * Members are generated from the MiiData field lists; BitFields are named <union>_<field>.
+ * Decode once and read the result many times instead of paying a swap and mask per access.
+ */
+struct DecodedMiiData {
+#define DECODED_MII_MEMBER(name) NativeTypeT<decltype(MiiData::name)> name{};
+#define DECODED_MII_BITFIELD(group, field)                                                         \
+    DecodedFieldType<decltype(MiiData::group.field)::bits> group##_##field{};
+
+    MII_DATA_SCALARS(DECODED_MII_MEMBER)
+    MII_DATA_ARRAYS(DECODED_MII_MEMBER)
+    MII_DATA_BITFIELDS(DECODED_MII_BITFIELD)
+
+#undef DECODED_MII_MEMBER
+#undef DECODED_MII_BITFIELD
+};
+
+[[nodiscard]] DecodedMiiData Decode(const MiiData& mii);
+
+/**
+ * Packs a decoded Mii back into its on-disk layout and computes its CRC. Bits of the BitField
+ * unions that no named field covers are written as zero.
+ */
+[[nodiscard]] ChecksummedMiiData Encode(const DecodedMiiData& decoded);
+
+/// Decodes in[i].mii_data into out[i]; out must be at least as large as in.
+void DecodeBatch(std::span<const ChecksummedMiiData> in, std::span<DecodedMiiData> out);
+
+/// Encodes in[i] into out[i]; out must be at least as large as in.
+void EncodeBatch(std::span<const DecodedMiiData> in, std::span<ChecksummedMiiData> out);
@@ -0,0 +1,333 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include "batch_reader.h"
+#include "directory_watcher.h"
+#include "parallel.h"
+
+namespace {
+
+constexpr u32 WATCH_MASK = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MODIFY | IN_ONLYDIR;
+
+/// Hidden files are still being written by a writer that renames them into place when done
+bool IsIgnored(std::string_view name) {
+    return name.empty() || name.front() == '.';
+}
+
+void UpdateMax(std::atomic<u64>& max, u64 value) {
+    u64 current = max.load(std::memory_order_relaxed);
+    while (current < value &&
+           !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+} // namespace
+
+DirectoryWatcher::DirectoryWatcher(std::size_t queue_capacity)
+    : queue_capacity(std::max<std::size_t>(queue_capacity, 1)) {}
+
+DirectoryWatcher::~DirectoryWatcher() {
+    Stop();
+    if (inotify_fd >= 0) {
+        close(inotify_fd);
+    }
+    if (stop_fd >= 0) {
+        close(stop_fd);
+    }
+}
+
+bool DirectoryWatcher::Watch(const std::string& directory) {
+    if (inotify_fd < 0) {
+        inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_fd < 0) {
+            return false;
+        }
+    }
+    const int wd = inotify_add_watch(inotify_fd, directory.c_str(), WATCH_MASK);
+    if (wd < 0) {
+        return false;
+    }
+    directories[wd] = directory;
+    return true;
+}
+
+bool DirectoryWatcher::Start(ResultCallback on_result_, Manifest* manifest_,
+                             std::size_t worker_count) {
+    if (inotify_fd < 0 || event_thread.joinable()) {
+        return false;
+    }
+    if (stop_fd < 0) {
+        stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (stop_fd < 0) {
+            return false;
+        }
+    }
+    on_result = std::move(on_result_);
+    manifest = manifest_;
+    stopping = false;
+    if (worker_count == 0) {
+        worker_count = ThreadCount();
+    }
+    for (std::size_t i = 0; i < worker_count; i++) {
+        workers.emplace_back([this] { RunWorker(); });
+    }
+    event_thread = std::jthread([this] { RunEvents(); });
+    return true;
+}
+
+void DirectoryWatcher::Stop() {
+    if (!event_thread.joinable()) {
+        return;
+    }
+    const u64 one = 1;
+    [[maybe_unused]] const ssize_t written = write(stop_fd, &one, sizeof(one));
+    event_thread.join();
+
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    not_empty.notify_all();
+    workers.clear();
+
+    u64 value;
+    [[maybe_unused]] const ssize_t read_size = read(stop_fd, &value, sizeof(value));
+}
+
+void DirectoryWatcher::Enqueue(std::string path, Clock::time_point ready) {
+    std::unique_lock lock(mutex);
+    if (queued.contains(path)) {
+        coalesced.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (queue.size() >= queue_capacity) {
+        stalls.fetch_add(1, std::memory_order_relaxed);
+        not_full.wait(lock, [&] { return queue.size() < queue_capacity; });
+    }
+    queued.insert(path);
+    queue.push_back({std::move(path), ready});
+    UpdateMax(max_queue_depth, queue.size());
+    lock.unlock();
+    not_empty.notify_one();
+}
+
+void DirectoryWatcher::Rescan() {
+    const Clock::time_point now = Clock::now();
+    for (const auto& [wd, directory] : directories) {
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+            if (entry.is_regular_file(ec) && !IsIgnored(entry.path().filename().native())) {
+                Enqueue(entry.path().string(), now);
+            }
+        }
+    }
+}
+
+void DirectoryWatcher::RunEvents() {
+    Rescan();
+
+    // Files written but not yet closed, by path, with the time of their last write
+    std::unordered_map<std::string, Clock::time_point> settling;
+    alignas(inotify_event) std::array<char, 0x10000> buffer;
+    std::array<pollfd, 2> fds{pollfd{inotify_fd, POLLIN, 0}, pollfd{stop_fd, POLLIN, 0}};
+
+    while (true) {
+        int timeout = -1;
+        if (!settling.empty()) {
+            Clock::time_point deadline = Clock::time_point::max();
+            for (const auto& [path, written] : settling) {
+                deadline = std::min(deadline, written + SETTLE_TIME);
+            }
+            timeout = static_cast<int>(std::max<s64>(
+                std::chrono::ceil<std::chrono::milliseconds>(deadline - Clock::now()).count(), 0));
+        }
+        if (poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR) {
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+
+        ssize_t size;
+        while ((size = read(inotify_fd, buffer.data(), buffer.size())) > 0) {
+            const Clock::time_point now = Clock::now();
+            for (ssize_t offset = 0; offset < size;) {
+                const auto* event = reinterpret_cast<const inotify_event*>(buffer.data() + offset);
+                offset += sizeof(inotify_event) + event->len;
+                events.fetch_add(1, std::memory_order_relaxed);
+
+                if (event->mask & IN_Q_OVERFLOW) {
+                    overflows.fetch_add(1, std::memory_order_relaxed);
+                    settling.clear();
+                    Rescan();
+                    continue;
+                }
+                if (event->mask & IN_IGNORED) {
+                    directories.erase(event->wd);
+                    continue;
+                }
+                const auto directory = directories.find(event->wd);
+                const std::string_view name(event->name, event->len ? std::strlen(event->name) : 0);
+                if (directory == directories.end() || (event->mask & IN_ISDIR) || IsIgnored(name)) {
+                    continue;
+                }
+
+                std::string path = directory->second + '/' + std::string(name);
+                if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                    settling.erase(path);
+                    Enqueue(std::move(path), now);
+                } else if (event->mask & IN_MODIFY) {
+                    settling[std::move(path)] = now;
+                }
+            }
+        }
+
+        const Clock::time_point now = Clock::now();
+        for (auto it = settling.begin(); it != settling.end();) {
+            if (now - it->second >= SETTLE_TIME) {
+                Enqueue(it->first, it->second + SETTLE_TIME);
+                it = settling.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+void DirectoryWatcher::RunWorker() {
+    std::vector<QueuedFile> files;
+    while (true) {
+        {
+            std::unique_lock lock(mutex);
+            not_empty.wait(lock, [&] { return !queue.empty() || stopping; });
+            if (queue.empty()) {
+                return;
+            }
+            // An even share of the queue, so that a burst is spread over the idle workers. A file
+            // written again from here on is queued again rather than coalesced.
+            const std::size_t share =
+                std::clamp<std::size_t>(queue.size() / workers.size(), 1, BATCH_SIZE);
+            while (!queue.empty() && files.size() < share) {
+                queued.erase(queue.front().path);
+                files.push_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+        }
+        not_full.notify_all();
+        Process(files);
+        files.clear();
+    }
+}
+
+void DirectoryWatcher::Process(std::vector<QueuedFile>& files) {
+    std::vector<WatchResult> results(files.size());
+    std::vector<FileIdentity> identities(files.size());
+    std::vector<std::string> changed_paths;
+    std::vector<std::size_t> changed;
+    for (std::size_t i = 0; i < files.size(); i++) {
+        results[i].path = files[i].path;
+        const std::optional<FileIdentity> identity = FileIdentity::Of(files[i].path);
+        if (!identity) {
+            if (manifest) {
+                manifest->Invalidate(files[i].path);
+            }
+            continue;
+        }
+        identities[i] = *identity;
+        if (manifest) {
+            const std::optional<ManifestEntry> entry = manifest->Lookup(files[i].path, *identity);
+            if (entry) {
+                results[i].opened = true;
+                results[i].crc16 = entry->crc16;
+                results[i].checksum_valid = entry->result;
+                continue;
+            }
+        }
+        changed_paths.push_back(files[i].path);
+        changed.push_back(i);
+    }
+
+    const std::vector<MyDataReadResult> reads = ReadMyDataFiles(changed_paths);
+    for (std::size_t j = 0; j < reads.size(); j++) {
+        WatchResult& result = results[changed[j]];
+        if (!reads[j].opened) {
+            if (manifest) {
+                manifest->Invalidate(changed_paths[j]);
+            }
+            continue;
+        }
+        const FRDMyData& obj = reads[j].data;
+        result.opened = result.changed = true;
+        result.crc16 = obj.mii_data.crc16;
+        result.checksum_valid = obj.mii_data.IsChecksumValid();
+        if (manifest) {
+            ManifestEntry entry;
+            entry.identity = identities[changed[j]];
+            entry.content_hash = ContentHash({reinterpret_cast<const u8*>(&obj), sizeof(obj)});
+            entry.crc16 = result.crc16;
+            entry.result = result.checksum_valid;
+            if (!manifest->Update(changed_paths[j], entry)) {
+                manifest_full.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    for (std::size_t i = 0; i < files.size(); i++) {
+        WatchResult& result = results[i];
+        (result.changed ? processed : result.opened ? unchanged : failed)
+            .fetch_add(1, std::memory_order_relaxed);
+        result.latency_us = static_cast<u64>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                                 Clock::now() - files[i].ready)
+                                                 .count());
+        on_result(result);
+        latency_total_us.fetch_add(result.latency_us, std::memory_order_relaxed);
+        UpdateMax(latency_max_us, result.latency_us);
+        latency_buckets[std::min<std::size_t>(std::bit_width(result.latency_us),
+                                              latency_buckets.size() - 1)]
+            .fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+WatchStats DirectoryWatcher::Stats() const {
+    WatchStats stats;
+    stats.events = events.load(std::memory_order_relaxed);
+    stats.processed = processed.load(std::memory_order_relaxed);
+    stats.unchanged = unchanged.load(std::memory_order_relaxed);
+    stats.failed = failed.load(std::memory_order_relaxed);
+    stats.coalesced = coalesced.load(std::memory_order_relaxed);
+    stats.stalls = stalls.load(std::memory_order_relaxed);
+    stats.overflows = overflows.load(std::memory_order_relaxed);
+    stats.manifest_full = manifest_full.load(std::memory_order_relaxed);
+    stats.max_queue_depth = max_queue_depth.load(std::memory_order_relaxed);
+    stats.latency_max_us = latency_max_us.load(std::memory_order_relaxed);
+
+    std::array<u64, std::tuple_size_v<decltype(latency_buckets)>> buckets;
+    u64 total = 0;
+    for (std::size_t i = 0; i < buckets.size(); i++) {
+        buckets[i] = latency_buckets[i].load(std::memory_order_relaxed);
+        total += buckets[i];
+    }
+    if (total == 0) {
+        return stats;
+    }
+    stats.latency_mean_us =
+        static_cast<double>(latency_total_us.load(std::memory_order_relaxed)) / total;
+    // A latency of bit width i is below 2^i microseconds
+    u64 seen = 0;
+    for (std::size_t i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+        if (stats.latency_p50_us == 0 && seen * 2 >= total) {
+            stats.latency_p50_us = u64{1} << i;
+        }
+        if (seen * 100 >= total * 99) {
+            stats.latency_p99_us = u64{1} << i;
+            break;
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "manifest.h"
+
+/// Outcome of processing one file, as IncrementalTest reports it
+struct WatchResult {
+    std::string path;
+    bool opened = false;         ///< False if the file could not be stat'ed or read
+    bool changed = false;        ///< False if the manifest already had this version of the file
+    u16 crc16 = 0;
+    bool checksum_valid = false; ///< Whether the Mii CRC of the record matches
+    u64 latency_us = 0;          ///< From the file becoming ready to this result
+};
+
+struct WatchStats {
+    u64 events = 0;        ///< inotify events read
+    u64 processed = 0;     ///< Files read and validated
+    u64 unchanged = 0;     ///< Files skipped by the manifest
+    u64 failed = 0;        ///< Files that could not be read
+    u64 coalesced = 0;     ///< Ready files that were already waiting in the queue
+    u64 stalls = 0;        ///< Times the event thread waited for room in the queue
+    u64 overflows = 0;     ///< Kernel event queue overflows, each followed by a rescan
+    u64 manifest_full = 0; ///< Results the manifest had no room to record
+    u64 max_queue_depth = 0;
+    u64 latency_p50_us = 0; ///< Percentiles are rounded up to a power of two
+    u64 latency_p99_us = 0;
+    u64 latency_max_us = 0;
+    double latency_mean_us = 0;
+};
+
+/**
+ * Watches directories for FRDMyData files with inotify and runs every new or rewritten file through
+ * the same read, validate and manifest steps as IncrementalTest, on a pool of worker threads.
+ *
+ * A file is ready as soon as its writer closes it or it is renamed into the directory, so results
+ * normally follow the close within a millisecond or two. Writes that are not followed by a close
+ * are debounced: the file is ready once it has gone SETTLE_TIME without another write. Names
+ * starting with '.' are ignored, so writers can fill a hidden file and rename it into place.
+ *
+ * Ready files wait in a bounded queue, where a file that is already waiting is not added twice.
+ * When the queue is full the event thread stops reading inotify events until a worker frees a
+ * slot, so a burst builds up in the kernel queue rather than in memory. If the kernel queue
+ * overflows, every watched directory is rescanned and the manifest skips the files that did not
+ * change. Directories are also scanned on Start, to catch up with files written while nothing was
+ * watching.
+ *
+ * Latency is measured from the moment the event thread saw the file become ready, which is within
+ * the scheduling delay of the close, to the moment its result is passed to the callback.
+ */
+class DirectoryWatcher {
+public:
+    static constexpr std::size_t DEFAULT_QUEUE_CAPACITY = 0x400;
+    /// Most files a worker takes from the queue at once, read in one ReadMyDataFiles batch
+    static constexpr std::size_t BATCH_SIZE = 0x40;
+    static constexpr std::chrono::milliseconds SETTLE_TIME{50};
+
+    using ResultCallback = std::function<void(const WatchResult&)>;
+
+    explicit DirectoryWatcher(std::size_t queue_capacity = DEFAULT_QUEUE_CAPACITY);
+    ~DirectoryWatcher();
+    DirectoryWatcher(const DirectoryWatcher&) = delete;
+    DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+    /// Adds a directory to watch; must be called before Start
+    bool Watch(const std::string& directory);
+
+    /**
+     * Starts the event thread and the workers, one per worker thread by default. on_result is
+     * called from the workers, concurrently. manifest, if given, must outlive the watcher.
+     */
+    bool Start(ResultCallback on_result, Manifest* manifest = nullptr, std::size_t workers = 0);
+
+    /// Stops watching, processes the files already queued and joins every thread
+    void Stop();
+
+    [[nodiscard]] WatchStats Stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct QueuedFile {
+        std::string path;
+        Clock::time_point ready;
+    };
+
+    void RunEvents();
+    void RunWorker();
+    void Rescan();
+    void Enqueue(std::string path, Clock::time_point ready);
+    void Process(std::vector<QueuedFile>& files);
+
+    int inotify_fd = -1;
+    int stop_fd = -1;
+    std::unordered_map<int, std::string> directories; ///< By watch descriptor
+    ResultCallback on_result;
+    Manifest* manifest = nullptr;
+    std::size_t queue_capacity;
+
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<QueuedFile> queue;
+    std::unordered_set<std::string> queued;
+    bool stopping = false;
+
+    std::atomic<u64> events = 0;
+    std::atomic<u64> processed = 0;
+    std::atomic<u64> unchanged = 0;
+    std::atomic<u64> failed = 0;
+    std::atomic<u64> coalesced = 0;
+    std::atomic<u64> stalls = 0;
+    std::atomic<u64> overflows = 0;
+    std::atomic<u64> manifest_full = 0;
+    std::atomic<u64> max_queue_depth = 0;
+    std::atomic<u64> latency_total_us = 0;
+    std::atomic<u64> latency_max_us = 0;
+    std::array<std::atomic<u64>, 40> latency_buckets{}; ///< By bit width of the latency in us
+
+    std::jthread event_thread;
+    std::vector<std::jthread> workers;
+};
@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <charconv>
+#include <iomanip>
+#include "field_access.h"
+
+namespace {
+
+bool Fail(std::string* error, std::string message) {
+    if (error) {
+        *error = std::move(message);
+    }
+    return false;
+}
+
+std::optional<u8> HexDigit(char c) {
+    if (c >= '0' && c <= '9') {
+        return static_cast<u8>(c - '0');
+    }
+    if (c >= 'a' && c <= 'f') {
+        return static_cast<u8>(c - 'a' + 10);
+    }
+    if (c >= 'A' && c <= 'F') {
+        return static_cast<u8>(c - 'A' + 10);
+    }
+    return std::nullopt;
+}
+
+/// Decodes the UTF-8 sequence at the start of text and advances past it; nullopt if it is invalid
+std::optional<u32> NextCodePoint(std::string_view& text) {
+    const u8 lead = static_cast<u8>(text[0]);
+    std::size_t length;
+    u32 code_point;
+    if (lead < 0x80) {
+        text.remove_prefix(1);
+        return lead;
+    } else if ((lead & 0xE0) == 0xC0) {
+        length = 2;
+        code_point = lead & 0x1F;
+    } else if ((lead & 0xF0) == 0xE0) {
+        length = 3;
+        code_point = lead & 0x0F;
+    } else if ((lead & 0xF8) == 0xF0) {
+        length = 4;
+        code_point = lead & 0x07;
+    } else {
+        return std::nullopt;
+    }
+    if (text.size() < length) {
+        return std::nullopt;
+    }
+    for (std::size_t i = 1; i < length; i++) {
+        const u8 continuation = static_cast<u8>(text[i]);
+        if ((continuation & 0xC0) != 0x80) {
+            return std::nullopt;
+        }
+        code_point = code_point << 6 | (continuation & 0x3F);
+    }
+    // Reject overlong encodings, surrogates and values past U+10FFFF
+    constexpr u32 MIN_CODE_POINT[] = {0, 0, 0x80, 0x800, 0x10000};
+    if (code_point < MIN_CODE_POINT[length] || code_point > 0x10FFFF ||
+        (code_point >= 0xD800 && code_point < 0xE000)) {
+        return std::nullopt;
+    }
+    text.remove_prefix(length);
+    return code_point;
+}
+
+} // namespace
+
+std::size_t EncodeUtf8(char* out, u32 code_point) {
+    if (code_point < 0x80) {
+        out[0] = static_cast<char>(code_point);
+        return 1;
+    } else if (code_point < 0x800) {
+        out[0] = static_cast<char>(0xC0 | code_point >> 6);
+        out[1] = static_cast<char>(0x80 | (code_point & 0x3F));
+        return 2;
+    } else if (code_point < 0x10000) {
+        out[0] = static_cast<char>(0xE0 | code_point >> 12);
+        out[1] = static_cast<char>(0x80 | (code_point >> 6 & 0x3F));
+        out[2] = static_cast<char>(0x80 | (code_point & 0x3F));
+        return 3;
+    } else {
+        out[0] = static_cast<char>(0xF0 | code_point >> 18);
+        out[1] = static_cast<char>(0x80 | (code_point >> 12 & 0x3F));
+        out[2] = static_cast<char>(0x80 | (code_point >> 6 & 0x3F));
+        out[3] = static_cast<char>(0x80 | (code_point & 0x3F));
+        return 4;
+    }
+}
+
+std::size_t FieldToUtf8(const u8* record, const FieldInfo& field, char* out) {
+    const u8* data = record + field.offset;
+    std::size_t length = 0;
+    for (std::size_t i = 0; i < field.size / 2u; i++) {
+        u32 code_unit = static_cast<u32>(LoadUnsigned(data + 2 * i, 2, field.big_endian));
+        if (code_unit == 0) {
+            break;
+        }
+        if (code_unit >= 0xD800 && code_unit < 0xE000) {
+            const u32 low = i + 1 < field.size / 2u
+                                ? static_cast<u32>(LoadUnsigned(data + 2 * i + 2, 2, field.big_endian))
+                                : 0;
+            if (code_unit < 0xDC00 && low >= 0xDC00 && low < 0xE000) {
+                code_unit = 0x10000 + ((code_unit - 0xD800) << 10 | (low - 0xDC00));
+                i++;
+            } else {
+                code_unit = 0xFFFD; // Unpaired surrogate
+            }
+        }
+        length += EncodeUtf8(out + length, code_unit);
+    }
+    return length;
+}
+
+void PrintField(std::ostream& out, const u8* record, const FieldAccessor& accessor) {
+    const FieldInfo& field = *accessor.field;
+    const u8* data = record + field.offset;
+    switch (field.type) {
+    case FieldType::Unsigned:
+    case FieldType::BitField:
+        out << accessor.read(record);
+        break;
+    case FieldType::Utf16: {
+        std::string text(MaxUtf8Size(field), '\0');
+        text.resize(FieldToUtf8(record, field, text.data()));
+        out << text;
+        break;
+    }
+    case FieldType::Bytes: {
+        const std::ios_base::fmtflags flags = out.flags();
+        const char fill = out.fill('0');
+        out << std::hex;
+        for (std::size_t i = 0; i < field.size; i++) {
+            out << std::setw(2) << static_cast<unsigned>(data[i]);
+        }
+        out.flags(flags);
+        out.fill(fill);
+        break;
+    }
+    }
+}
+
+bool ParseField(u8* record, const FieldAccessor& accessor, std::string_view text,
+                std::string* error) {
+    const FieldInfo& field = *accessor.field;
+    u8* data = record + field.offset;
+    switch (field.type) {
+    case FieldType::Unsigned:
+    case FieldType::BitField: {
+        int base = 10;
+        if (text.starts_with("0x") || text.starts_with("0X")) {
+            text.remove_prefix(2);
+            base = 16;
+        }
+        u64 value = 0;
+        const auto [end, result] = std::from_chars(text.data(), text.data() + text.size(), value, base);
+        if (result != std::errc{} || end != text.data() + text.size()) {
+            return Fail(error, "expected a number for " + std::string(field.name));
+        }
+        if (value > FieldValueMask(field)) {
+            return Fail(error, "value out of range for " + std::string(field.name));
+        }
+        accessor.write(record, value);
+        return true;
+    }
+    case FieldType::Utf16: {
+        // Transcode into a copy first so that a failure leaves the record unchanged
+        u16 code_units[0x100]{};
+        const std::size_t capacity = std::min<std::size_t>(field.size / 2u, std::size(code_units));
+        std::size_t length = 0;
+        while (!text.empty()) {
+            const std::optional<u32> code_point = NextCodePoint(text);
+            if (!code_point) {
+                return Fail(error, "invalid UTF-8 for " + std::string(field.name));
+            }
+            const std::size_t units = *code_point < 0x10000 ? 1 : 2;
+            if (length + units > capacity) {
+                return Fail(error, "text too long for " + std::string(field.name));
+            }
+            if (units == 1) {
+                code_units[length++] = static_cast<u16>(*code_point);
+            } else {
+                code_units[length++] = static_cast<u16>(0xD800 + ((*code_point - 0x10000) >> 10));
+                code_units[length++] = static_cast<u16>(0xDC00 + ((*code_point - 0x10000) & 0x3FF));
+            }
+        }
+        for (std::size_t i = 0; i < field.size / 2u; i++) {
+            StoreUnsigned(data + 2 * i, 2, field.big_endian, i < capacity ? code_units[i] : 0);
+        }
+        return true;
+    }
+    case FieldType::Bytes: {
+        if (text.size() % 2 != 0 || text.size() > 2u * field.size) {
+            return Fail(error, "expected up to " + std::to_string(field.size) + " hex bytes for " +
+                                   std::string(field.name));
+        }
+        for (const char c : text) {
+            if (!HexDigit(c)) {
+                return Fail(error, "expected hex bytes for " + std::string(field.name));
+            }
+        }
+        for (std::size_t i = 0; i < field.size; i++) {
+            data[i] = 2 * i < text.size()
+                          ? static_cast<u8>(*HexDigit(text[2 * i]) << 4 | *HexDigit(text[2 * i + 1]))
+                          : 0;
+        }
+        return true;
+    }
+    }
+    return false;
+}
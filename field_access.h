@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstring>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include "field_table.h"
+
+/**
+ * Reads and writes one field of a record by name. The read and write thunks are generated per
+ * field with its layout as constants, so a call costs an indirect jump plus the load and shifts of
+ * a direct member access; they are null for array fields.
+ */
+struct FieldAccessor {
+    const FieldInfo* field = nullptr;
+    u64 (*read)(const u8* record) = nullptr;
+    void (*write)(u8* record, u64 value) = nullptr;
+
+    /// Unsigned or BitField value of the field in record
+    template <typename Record>
+    [[nodiscard]] u64 Read(const Record& record) const {
+        return read(reinterpret_cast<const u8*>(&record));
+    }
+
+    /// Stores the low bits of value into the field, like BitField::Assign
+    template <typename Record>
+    void Write(Record& record, u64 value) const {
+        write(reinterpret_cast<u8*>(&record), value);
+    }
+};
+
+namespace FieldAccessDetail {
+
+#if COMMON_LITTLE_ENDIAN
+constexpr bool HOST_BIG_ENDIAN = false;
+#else
+constexpr bool HOST_BIG_ENDIAN = true;
+#endif
+
+template <std::size_t Size>
+using UnsignedOfSize =
+    std::conditional_t<Size == 1, u8,
+                       std::conditional_t<Size == 2, u16, std::conditional_t<Size == 4, u32, u64>>>;
+
+constexpr u8 SwapBytes(u8 value) {
+    return value;
+}
+constexpr u16 SwapBytes(u16 value) {
+    return Common::swap16(value);
+}
+constexpr u32 SwapBytes(u32 value) {
+    return Common::swap32(value);
+}
+constexpr u64 SwapBytes(u64 value) {
+    return Common::swap64(value);
+}
+
+template <const FieldInfo& Field>
+auto LoadStorage(const u8* record) {
+    UnsignedOfSize<Field.size> storage;
+    std::memcpy(&storage, record + Field.offset, sizeof(storage));
+    if constexpr (Field.big_endian != HOST_BIG_ENDIAN) {
+        storage = SwapBytes(storage);
+    }
+    return storage;
+}
+
+template <const FieldInfo& Field>
+u64 ReadThunk(const u8* record) {
+    return (u64{LoadStorage<Field>(record)} >> Field.position) & FieldValueMask(Field);
+}
+
+template <const FieldInfo& Field>
+void WriteThunk(u8* record, u64 value) {
+    using Storage = UnsignedOfSize<Field.size>;
+    constexpr Storage mask = static_cast<Storage>(FieldValueMask(Field) << Field.position);
+    Storage storage = static_cast<Storage>((LoadStorage<Field>(record) & ~mask) |
+                                           ((value << Field.position) & mask));
+    if constexpr (Field.big_endian != HOST_BIG_ENDIAN) {
+        storage = SwapBytes(storage);
+    }
+    std::memcpy(record + Field.offset, &storage, sizeof(storage));
+}
+
+template <const FieldInfo& Field>
+constexpr FieldAccessor MakeAccessor() {
+    if constexpr (Field.type == FieldType::Unsigned || Field.type == FieldType::BitField) {
+        return {&Field, ReadThunk<Field>, WriteThunk<Field>};
+    } else {
+        return {&Field, nullptr, nullptr};
+    }
+}
+
+template <const auto& Fields, std::size_t... Indices>
+constexpr auto MakeAccessors(std::index_sequence<Indices...>) {
+    return std::array{MakeAccessor<Fields[Indices]>()...};
+}
+
+} // namespace FieldAccessDetail
+
+/// Accessors of a field table, parallel to it
+template <const auto& Fields>
+inline constexpr auto FIELD_ACCESSORS =
+    FieldAccessDetail::MakeAccessors<Fields>(std::make_index_sequence<Fields.size()>{});
+
+/// Accessors of every field of Record, parallel to FieldsOf<Record>()
+template <typename Record>
+constexpr std::span<const FieldAccessor> FieldAccessorsOf() {
+    if constexpr (std::is_same_v<Record, MiiData>) {
+        return FIELD_ACCESSORS<MII_DATA_FIELDS>;
+    } else if constexpr (std::is_same_v<Record, ChecksummedMiiData>) {
+        return FIELD_ACCESSORS<CHECKSUMMED_MII_DATA_FIELDS>;
+    } else {
+        return FIELD_ACCESSORS<FRD_MY_DATA_FIELDS>;
+    }
+}
+
+/// Accessor of the field of Record named as in ResolveField, through its perfect hash index
+template <typename Record>
+[[nodiscard]] std::optional<FieldAccessor> FindFieldAccessor(std::string_view path) {
+    const std::optional<std::size_t> index = ResolveField(FieldsOf<Record>(), path);
+    if (!index) {
+        return std::nullopt;
+    }
+    return FieldAccessorsOf<Record>()[*index];
+}
+
+/// Encodes code_point as UTF-8 into out, which must have room for 4 bytes; returns the number
+/// written
+std::size_t EncodeUtf8(char* out, u32 code_point);
+
+/// Bytes of UTF-8 that a Utf16 field can transcode to: at most three per code unit
+constexpr std::size_t MaxUtf8Size(const FieldInfo& field) {
+    return field.size / 2u * 3;
+}
+
+/**
+ * Transcodes the Utf16 field of record to UTF-8 up to its first NUL, replacing unpaired surrogates
+ * with U+FFFD. out must have room for MaxUtf8Size(field) bytes; returns the number written.
+ */
+std::size_t FieldToUtf8(const u8* record, const FieldInfo& field, char* out);
+
+/**
+ * Prints the field of record as text: integers in decimal, UTF-16 arrays as UTF-8 up to the first
+ * NUL, and byte arrays as hex.
+ */
+void PrintField(std::ostream& out, const u8* record, const FieldAccessor& accessor);
+
+/**
+ * Parses text in the format of PrintField, also accepting 0x prefixed hex integers, and stores it
+ * to the field of record. Shorter arrays are padded with zeros. On failure, leaves record
+ * unchanged, returns false and describes the problem in error if it is not null.
+ */
+bool ParseField(u8* record, const FieldAccessor& accessor, std::string_view text,
+                std::string* error = nullptr);
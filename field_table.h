@@ -0,0 +1,471 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string_view>
+#include "decoded_mii_data.h"
+#include "main.h"
+
+enum class FieldType : u8 {
+    Unsigned, ///< Whole integer member
+    BitField, ///< BitField within the storage word of a union
+    Bytes,    ///< u8 array
+    Utf16,    ///< UTF-16 code unit array
+};
+
+/// Location of one named field within the packed bytes of a record
+struct FieldInfo {
+    std::string_view name; ///< Dotted member path, e.g. "eye_details.rotation"
+    FieldType type;
+    bool big_endian; ///< Byte order of an Unsigned member or BitField storage word
+    u16 offset;      ///< Byte offset of the member or BitField storage word in the record
+    u16 size;        ///< Size in bytes of the member or BitField storage word
+    u8 position;     ///< BitField only: bit offset of the value within the storage word
+    u8 bits;         ///< Width of an Unsigned or BitField value; 0 for arrays
+};
+
+namespace FieldTableDetail {
+
+template <typename T>
+struct BitFieldTraits {
+    static constexpr bool is_bit_field = false;
+};
+
+template <std::size_t Position, std::size_t Bits, typename T, typename EndianTag>
+struct BitFieldTraits<BitField<Position, Bits, T, EndianTag>> {
+    static constexpr bool is_bit_field = true;
+    static constexpr bool big_endian = sizeof(T) > 1 && std::is_same_v<EndianTag, BETag>;
+    using StorageType = T;
+};
+
+template <typename T>
+struct ArrayTraits {
+    static constexpr bool is_array = false;
+};
+
+template <typename T, std::size_t N>
+struct ArrayTraits<std::array<T, N>> {
+    static constexpr bool is_array = true;
+    using ElementType = T;
+};
+
+template <typename T>
+constexpr bool IsBigEndian =
+    sizeof(T) > 1 && std::is_same_v<T, typename AddEndian<NativeTypeT<T>, BETag>::type>;
+
+template <typename Member>
+constexpr FieldInfo MakeField(std::string_view name, std::size_t offset) {
+    FieldInfo field{name, FieldType::Unsigned, false, static_cast<u16>(offset),
+                    static_cast<u16>(sizeof(Member)), 0, 0};
+    if constexpr (BitFieldTraits<Member>::is_bit_field) {
+        using Traits = BitFieldTraits<Member>;
+        field.type = FieldType::BitField;
+        field.big_endian = Traits::big_endian;
+        field.size = sizeof(typename Traits::StorageType);
+        field.position = static_cast<u8>(Member::position);
+        field.bits = static_cast<u8>(Member::bits);
+    } else if constexpr (ArrayTraits<Member>::is_array) {
+        using ElementType = typename ArrayTraits<Member>::ElementType;
+        field.type = sizeof(ElementType) == 1 ? FieldType::Bytes : FieldType::Utf16;
+        field.big_endian = IsBigEndian<ElementType>;
+    } else {
+        field.big_endian = IsBigEndian<Member>;
+        field.bits = static_cast<u8>(8 * sizeof(Member));
+    }
+    return field;
+}
+
+template <std::size_t N>
+constexpr std::array<FieldInfo, N> SortByLayout(std::array<FieldInfo, N> fields) {
+    std::sort(fields.begin(), fields.end(), [](const FieldInfo& a, const FieldInfo& b) {
+        return a.offset != b.offset ? a.offset < b.offset : a.position < b.position;
+    });
+    return fields;
+}
+
+} // namespace FieldTableDetail
+
+// Field table entries for the members of a MiiData placed at FIELD_TABLE_BASE, with names prefixed
+// by FIELD_TABLE_PREFIX
+#define FIELD_TABLE_MII_MEMBER(name)                                                               \
+    FieldTableDetail::MakeField<decltype(MiiData::name)>(FIELD_TABLE_PREFIX #name,                 \
+                                                         FIELD_TABLE_BASE + offsetof(MiiData, name)),
+#define FIELD_TABLE_MII_BITFIELD(group, field)                                                     \
+    FieldTableDetail::MakeField<decltype(MiiData::group.field)>(                                   \
+        FIELD_TABLE_PREFIX #group "." #field, FIELD_TABLE_BASE + offsetof(MiiData, group)),
+#define FIELD_TABLE_MII_FIELDS                                                                     \
+    MII_DATA_SCALARS(FIELD_TABLE_MII_MEMBER)                                                       \
+    MII_DATA_ARRAYS(FIELD_TABLE_MII_MEMBER) MII_DATA_BITFIELDS(FIELD_TABLE_MII_BITFIELD)
+
+#define FIELD_TABLE_PREFIX ""
+#define FIELD_TABLE_BASE 0
+/// Fields of MiiData, in layout order
+inline constexpr auto MII_DATA_FIELDS =
+    FieldTableDetail::SortByLayout(std::array{FIELD_TABLE_MII_FIELDS});
+
+/// Fields of ChecksummedMiiData, in layout order
+inline constexpr auto CHECKSUMMED_MII_DATA_FIELDS = FieldTableDetail::SortByLayout(std::array{
+    FIELD_TABLE_MII_FIELDS
+    FieldTableDetail::MakeField<decltype(ChecksummedMiiData::unknown)>(
+        "unknown", offsetof(ChecksummedMiiData, unknown)),
+    FieldTableDetail::MakeField<decltype(ChecksummedMiiData::crc16)>(
+        "crc16", offsetof(ChecksummedMiiData, crc16)),
+});
+#undef FIELD_TABLE_PREFIX
+#undef FIELD_TABLE_BASE
+
+#define FIELD_TABLE_MY_DATA_MEMBER(name)                                                           \
+    FieldTableDetail::MakeField<decltype(FRDMyData::name)>(#name, offsetof(FRDMyData, name)),
+#define FIELD_TABLE_PROFILE_MEMBER(name)                                                           \
+    FieldTableDetail::MakeField<decltype(FriendProfile::name)>(                                    \
+        "profile." #name, offsetof(FRDMyData, profile) + offsetof(FriendProfile, name)),
+#define FIELD_TABLE_PREFIX "mii_data."
+#define FIELD_TABLE_BASE (offsetof(FRDMyData, mii_data) + offsetof(ChecksummedMiiData, mii_data))
+/// Fields of FRDMyData, in layout order. Fields of the embedded Mii are prefixed with "mii_data."
+inline constexpr auto FRD_MY_DATA_FIELDS = FieldTableDetail::SortByLayout(std::array{
+    FRD_MY_DATA_SCALARS(FIELD_TABLE_MY_DATA_MEMBER)
+    FRD_MY_DATA_ARRAYS(FIELD_TABLE_MY_DATA_MEMBER)
+    FRIEND_PROFILE_SCALARS(FIELD_TABLE_PROFILE_MEMBER)
+    FRIEND_PROFILE_ARRAYS(FIELD_TABLE_PROFILE_MEMBER)
+    FIELD_TABLE_MII_FIELDS
+    FieldTableDetail::MakeField<decltype(ChecksummedMiiData::unknown)>(
+        "mii_data.unknown", offsetof(FRDMyData, mii_data) + offsetof(ChecksummedMiiData, unknown)),
+    FieldTableDetail::MakeField<decltype(ChecksummedMiiData::crc16)>(
+        "mii_data.crc16", offsetof(FRDMyData, mii_data) + offsetof(ChecksummedMiiData, crc16)),
+});
+#undef FIELD_TABLE_PREFIX
+#undef FIELD_TABLE_BASE
+
+#undef FIELD_TABLE_MII_MEMBER
+#undef FIELD_TABLE_MII_BITFIELD
+#undef FIELD_TABLE_MII_FIELDS
+#undef FIELD_TABLE_MY_DATA_MEMBER
+#undef FIELD_TABLE_PROFILE_MEMBER
+
+/// Field table of a record type
+template <typename Record>
+constexpr std::span<const FieldInfo> FieldsOf() {
+    if constexpr (std::is_same_v<Record, MiiData>) {
+        return MII_DATA_FIELDS;
+    } else if constexpr (std::is_same_v<Record, ChecksummedMiiData>) {
+        return CHECKSUMMED_MII_DATA_FIELDS;
+    } else {
+        static_assert(std::is_same_v<Record, FRDMyData>, "No field table for this record type");
+        return FRD_MY_DATA_FIELDS;
+    }
+}
+
+/// Index of the field called name, found by linear search
+[[nodiscard]] constexpr std::optional<std::size_t> FindField(std::span<const FieldInfo> fields,
+                                                             std::string_view name) {
+    for (std::size_t i = 0; i < fields.size(); i++) {
+        if (fields[i].name == name) {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+namespace FieldTableDetail {
+
+/// A name that resolves to a field: its full dotted path, or an unambiguous dotted suffix of it
+struct FieldKey {
+    static constexpr u16 NO_FIELD = 0xFFFF;
+
+    std::string_view name;
+    u16 field = NO_FIELD;
+};
+
+/// FNV-1a, computed once per lookup; buckets and slots are derived from it by MixFieldHash
+[[nodiscard]] constexpr u64 FieldNameHash(std::string_view name) {
+    u64 hash = 0xCBF29CE484222325;
+    for (const char c : name) {
+        hash = (hash ^ static_cast<u8>(c)) * 0x100000001B3;
+    }
+    return hash;
+}
+
+/// Finalizer of MurmurHash3, so that every bit of the result depends on every bit of hash
+[[nodiscard]] constexpr u64 MixFieldHash(u64 hash) {
+    hash = (hash ^ (hash >> 33)) * 0xFF51AFD7ED558CCD;
+    hash = (hash ^ (hash >> 33)) * 0xC4CEB9FE1A85EC53;
+    return hash ^ (hash >> 33);
+}
+
+/**
+ * Stores the keys of fields to out, if not null, and returns how many there are. Besides every
+ * full name, a dotted suffix is a key when exactly one field ends with it and no field is called
+ * it, as ResolveField used to search for.
+ */
+constexpr std::size_t CollectFieldKeys(std::span<const FieldInfo> fields, FieldKey* out) {
+    std::size_t count = 0;
+    const auto add = [&](std::string_view name, std::size_t field) {
+        if (out) {
+            out[count] = {name, static_cast<u16>(field)};
+        }
+        count++;
+    };
+    for (std::size_t i = 0; i < fields.size(); i++) {
+        const std::string_view name = fields[i].name;
+        add(name, i);
+        for (std::size_t dot = name.find('.'); dot != std::string_view::npos;
+             dot = name.find('.', dot + 1)) {
+            const std::string_view suffix = name.substr(dot + 1);
+            std::size_t matches = 0;
+            for (const FieldInfo& other : fields) {
+                if (other.name == suffix) {
+                    matches = 2;
+                    break;
+                }
+                const std::size_t other_size = other.name.size();
+                if (other_size > suffix.size() && other.name.ends_with(suffix) &&
+                    other.name[other_size - suffix.size() - 1] == '.') {
+                    matches++;
+                }
+            }
+            if (matches == 1) {
+                add(suffix, i);
+            }
+        }
+    }
+    return count;
+}
+
+/**
+ * Perfect hash over a fixed set of keys, built at compile time by hash and displace: keys are
+ * grouped into buckets, and the largest buckets first search for a seed that sends all of their
+ * keys to free slots. A lookup hashes the name once, reads the seed of its bucket and compares the
+ * name against the one key in its slot.
+ */
+template <std::size_t KeyCount>
+struct FieldHashIndex {
+    static constexpr std::size_t BUCKETS = std::bit_ceil(std::max<std::size_t>(KeyCount / 2, 1));
+    static constexpr std::size_t SLOTS = std::bit_ceil(KeyCount * 2);
+
+    std::array<u32, BUCKETS> seeds{};
+    std::array<FieldKey, SLOTS> slots{};
+    bool complete = false; ///< Whether every key found a slot
+
+    [[nodiscard]] static constexpr std::size_t BucketOf(u64 hash) {
+        return MixFieldHash(hash) & (BUCKETS - 1);
+    }
+
+    [[nodiscard]] static constexpr std::size_t SlotOf(u64 hash, u32 seed) {
+        return MixFieldHash(hash ^ ((seed + u64{1}) * 0x9E3779B97F4A7C15)) & (SLOTS - 1);
+    }
+
+    [[nodiscard]] constexpr std::optional<std::size_t> Find(std::string_view name) const {
+        const u64 hash = FieldNameHash(name);
+        const FieldKey& key = slots[SlotOf(hash, seeds[BucketOf(hash)])];
+        if (key.field == FieldKey::NO_FIELD || key.name != name) {
+            return std::nullopt;
+        }
+        return key.field;
+    }
+};
+
+template <std::size_t KeyCount>
+constexpr FieldHashIndex<KeyCount> BuildFieldHashIndex(const std::array<FieldKey, KeyCount>& keys) {
+    using Index = FieldHashIndex<KeyCount>;
+    constexpr u32 MAX_SEED = 0x100000;
+
+    Index index;
+    std::array<u64, KeyCount> hashes{};
+    std::array<std::size_t, KeyCount> by_bucket{};
+    for (std::size_t i = 0; i < KeyCount; i++) {
+        hashes[i] = FieldNameHash(keys[i].name);
+        by_bucket[i] = i;
+    }
+    std::sort(by_bucket.begin(), by_bucket.end(), [&](std::size_t a, std::size_t b) {
+        return Index::BucketOf(hashes[a]) < Index::BucketOf(hashes[b]);
+    });
+
+    // Runs of by_bucket with the same bucket, largest first
+    std::array<std::pair<std::size_t, std::size_t>, KeyCount> runs{};
+    std::size_t run_count = 0;
+    for (std::size_t begin = 0, end; begin < KeyCount; begin = end) {
+        const std::size_t bucket = Index::BucketOf(hashes[by_bucket[begin]]);
+        for (end = begin + 1; end < KeyCount && Index::BucketOf(hashes[by_bucket[end]]) == bucket;
+             end++) {
+        }
+        runs[run_count++] = {begin, end};
+    }
+    std::sort(runs.begin(), runs.begin() + run_count, [](const auto& a, const auto& b) {
+        return a.second - a.first > b.second - b.first;
+    });
+
+    for (std::size_t run = 0; run < run_count; run++) {
+        const auto [begin, end] = runs[run];
+        std::array<std::size_t, KeyCount> placed{};
+        bool found = false;
+        for (u32 seed = 0; seed < MAX_SEED && !found; seed++) {
+            found = true;
+            for (std::size_t i = begin; i < end && found; i++) {
+                placed[i - begin] = Index::SlotOf(hashes[by_bucket[i]], seed);
+                found = index.slots[placed[i - begin]].field == FieldKey::NO_FIELD &&
+                        std::find(placed.begin(), placed.begin() + (i - begin),
+                                  placed[i - begin]) == placed.begin() + (i - begin);
+            }
+            if (found) {
+                index.seeds[Index::BucketOf(hashes[by_bucket[begin]])] = seed;
+                for (std::size_t i = begin; i < end; i++) {
+                    index.slots[placed[i - begin]] = keys[by_bucket[i]];
+                }
+            }
+        }
+        if (!found) {
+            return index;
+        }
+    }
+    index.complete = true;
+    return index;
+}
+
+template <const auto& Fields>
+inline constexpr auto FIELD_KEYS = [] {
+    std::array<FieldKey, CollectFieldKeys(Fields, nullptr)> keys{};
+    CollectFieldKeys(Fields, keys.data());
+    return keys;
+}();
+
+/// Whether the index of Fields was built and resolves every key to its field
+template <const auto& Fields, typename Index>
+constexpr bool IsHashIndexValid(const Index& index) {
+    if (!index.complete) {
+        return false;
+    }
+    for (const FieldKey& key : FIELD_KEYS<Fields>) {
+        if (index.Find(key.name) != key.field) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace FieldTableDetail
+
+/// Perfect hash index of the names of a field table, e.g. FIELD_HASH_INDEX<FRD_MY_DATA_FIELDS>
+template <const auto& Fields>
+inline constexpr auto FIELD_HASH_INDEX =
+    FieldTableDetail::BuildFieldHashIndex(FieldTableDetail::FIELD_KEYS<Fields>);
+
+static_assert(FieldTableDetail::IsHashIndexValid<MII_DATA_FIELDS>(FIELD_HASH_INDEX<MII_DATA_FIELDS>));
+static_assert(FieldTableDetail::IsHashIndexValid<CHECKSUMMED_MII_DATA_FIELDS>(
+    FIELD_HASH_INDEX<CHECKSUMMED_MII_DATA_FIELDS>));
+static_assert(
+    FieldTableDetail::IsHashIndexValid<FRD_MY_DATA_FIELDS>(FIELD_HASH_INDEX<FRD_MY_DATA_FIELDS>));
+
+/**
+ * Index of the field called name, or else of the only field with name as a dotted suffix. The
+ * tables above resolve through their perfect hash index with a single string comparison; any
+ * other table is searched.
+ */
+[[nodiscard]] constexpr std::optional<std::size_t> ResolveField(std::span<const FieldInfo> fields,
+                                                                std::string_view name) {
+    if (fields.data() == FRD_MY_DATA_FIELDS.data()) {
+        return FIELD_HASH_INDEX<FRD_MY_DATA_FIELDS>.Find(name);
+    }
+    if (fields.data() == CHECKSUMMED_MII_DATA_FIELDS.data()) {
+        return FIELD_HASH_INDEX<CHECKSUMMED_MII_DATA_FIELDS>.Find(name);
+    }
+    if (fields.data() == MII_DATA_FIELDS.data()) {
+        return FIELD_HASH_INDEX<MII_DATA_FIELDS>.Find(name);
+    }
+
+    if (const std::optional<std::size_t> index = FindField(fields, name)) {
+        return index;
+    }
+    std::optional<std::size_t> found;
+    for (std::size_t i = 0; i < fields.size(); i++) {
+        const std::string_view candidate = fields[i].name;
+        if (candidate.size() > name.size() && candidate.ends_with(name) &&
+            candidate[candidate.size() - name.size() - 1] == '.') {
+            if (found) {
+                return std::nullopt;
+            }
+            found = i;
+        }
+    }
+    return found;
+}
+
+/// Loads an unsigned integer of 1, 2, 4 or 8 bytes stored with the given byte order
+[[nodiscard]] inline u64 LoadUnsigned(const u8* data, std::size_t size, bool big_endian) {
+#if COMMON_BIG_ENDIAN
+    const bool swap = !big_endian;
+#else
+    const bool swap = big_endian;
+#endif
+    switch (size) {
+    case 1:
+        return *data;
+    case 2: {
+        u16 value;
+        std::memcpy(&value, data, sizeof(value));
+        return swap ? Common::swap16(value) : value;
+    }
+    case 4: {
+        u32 value;
+        std::memcpy(&value, data, sizeof(value));
+        return swap ? Common::swap32(value) : value;
+    }
+    default: {
+        u64 value;
+        std::memcpy(&value, data, sizeof(value));
+        return swap ? Common::swap64(value) : value;
+    }
+    }
+}
+
+/// Stores the low size bytes of value with the given byte order
+inline void StoreUnsigned(u8* data, std::size_t size, bool big_endian, u64 value) {
+#if COMMON_BIG_ENDIAN
+    const bool swap = !big_endian;
+#else
+    const bool swap = big_endian;
+#endif
+    switch (size) {
+    case 1:
+        *data = static_cast<u8>(value);
+        break;
+    case 2: {
+        const u16 stored = swap ? Common::swap16(static_cast<u16>(value)) : static_cast<u16>(value);
+        std::memcpy(data, &stored, sizeof(stored));
+        break;
+    }
+    case 4: {
+        const u32 stored = swap ? Common::swap32(static_cast<u32>(value)) : static_cast<u32>(value);
+        std::memcpy(data, &stored, sizeof(stored));
+        break;
+    }
+    default: {
+        const u64 stored = swap ? Common::swap64(value) : value;
+        std::memcpy(data, &stored, sizeof(stored));
+        break;
+    }
+    }
+}
+
+/// Mask of the value bits of an Unsigned or BitField field, before shifting by position
+[[nodiscard]] constexpr u64 FieldValueMask(const FieldInfo& field) {
+    return field.bits >= 64 ? ~u64{0} : (u64{1} << field.bits) - 1;
+}
+
+/// Reads an Unsigned or BitField value from the bytes of a record
+[[nodiscard]] inline u64 ReadFieldValue(const u8* record, const FieldInfo& field) {
+    const u64 storage = LoadUnsigned(record + field.offset, field.size, field.big_endian);
+    return (storage >> field.position) & FieldValueMask(field);
+}
+
+/// Writes an Unsigned or BitField value into the bytes of a record, like BitField::Assign
+inline void WriteFieldValue(u8* record, const FieldInfo& field, u64 value) {
+    const u64 mask = FieldValueMask(field) << field.position;
+    const u64 storage = LoadUnsigned(record + field.offset, field.size, field.big_endian);
+    StoreUnsigned(record + field.offset, field.size, field.big_endian,
+                  (storage & ~mask) | ((value << field.position) & mask));
+}
@@ -0,0 +1,61 @@
+#include <algorithm>
+#include "format.h"
+
+int CalculateCheckDigit(std::string_view serialNumber) {
+    int oddSum = 0, evenSum = 0;
+    bool even = false;
+    for (int i = 2; i < 10; i++) {
+        if (even)
+            evenSum += serialNumber[i] - '0';
+        else
+            oddSum += serialNumber[i] - '0';
+
+        even = !even;
+    }
+
+    // Apply the formula
+    int algResult = ((3 * evenSum) + oddSum) % 10;
+
+    // Calculate the check digit
+    int checkDigit = (algResult != 0) ? (10 - algResult) : 0;
+
+    return checkDigit;
+}
+
+std::string_view ConvertMacAddressToString(const std::array<u8, 6>& macAddress, Arena& arena) {
+    constexpr char digits[] = "0123456789abcdef";
+    auto* result = static_cast<char*>(arena.Allocate(17, 1));
+    for (std::size_t i = 0; i < 6; ++i) {
+        result[i * 3] = digits[macAddress[i] >> 4];
+        result[i * 3 + 1] = digits[macAddress[i] & 0xF];
+        if (i < 5) {
+            result[i * 3 + 2] = ':';
+        }
+    }
+    return {result, 17};
+}
+
+std::string_view ConvertU16ToString(std::span<const u16> u16Array, Arena& arena) {
+    std::size_t length = 0;
+    while (length < u16Array.size() && u16Array[length] != 0) {
+        length++;
+    }
+
+    auto* result = static_cast<char*>(arena.Allocate(length, 1));
+    for (std::size_t i = 0; i < length; i++) {
+        result[i] = static_cast<char>(u16Array[i] & 0xFF);
+    }
+    return {result, length};
+}
+
+std::string_view FormatSerialNumber(const FRDMyData& data, Arena& arena) {
+    const std::string_view serial = ConvertU16ArrayToString(data.serial_number, arena);
+    // The check digit reads serial[2..9]; short serials are padded with zeros for it
+    char padded[10] = {'0', '0', '0', '0', '0', '0', '0', '0', '0', '0'};
+    std::copy_n(serial.begin(), std::min<std::size_t>(serial.size(), 10), padded);
+
+    auto* result = static_cast<char*>(arena.Allocate(serial.size() + 1, 1));
+    std::copy(serial.begin(), serial.end(), result);
+    result[serial.size()] = static_cast<char>('0' + CalculateCheckDigit({padded, 10}));
+    return {result, serial.size() + 1};
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string_view>
+#include "arena.h"
+#include "main.h"
+
+template <size_t size>
+std::string ConvertMacAddressToString(std::array<u8, size> &macAddress) {
+    std::stringstream ss;
+    ss << std::hex << std::setfill('0');
+
+    for (int i = 0; i < 6; ++i) {
+        ss << std::setw(2) << static_cast<unsigned>(macAddress[i]);
+        if (i < 5) {
+            ss << ':';
+        }
+    }
+
+    return ss.str();
+}
+
+template <size_t size>
+std::string ConvertU16ArrayToString(std::array<u16, size> u16Array) {
+    std::string result;
+    std::size_t length = 0;
+    while (u16Array[length] != 0) {
+        char lowerByte = static_cast<char>(u16Array[length] & 0xFF);
+        result += lowerByte;
+        length++;
+    }
+    return result;
+}
+
+int CalculateCheckDigit(std::string_view serialNumber);
+
+// Arena backed variants of the conversions above for batch processing. They never touch the
+// global heap, and the returned views stay valid until the arena is reset.
+
+std::string_view ConvertMacAddressToString(const std::array<u8, 6>& macAddress, Arena& arena);
+
+/// Stops at the first NUL or at the end of the array, whichever comes first
+std::string_view ConvertU16ToString(std::span<const u16> u16Array, Arena& arena);
+
+template <size_t size>
+std::string_view ConvertU16ArrayToString(const std::array<u16, size>& u16Array, Arena& arena) {
+    return ConvertU16ToString(u16Array, arena);
+}
+
+/// Converts into a stack buffer and interns the result, so repeated names share storage
+template <size_t size>
+std::string_view ConvertU16ArrayToString(const std::array<u16, size>& u16Array,
+                                         StringInterner& interner) {
+    char result[size];
+    std::size_t length = 0;
+    while (length < size && u16Array[length] != 0) {
+        result[length] = static_cast<char>(u16Array[length] & 0xFF);
+        length++;
+    }
+    return interner.Intern({result, length});
+}
+
+/// Serial number followed by its check digit, as printed by WriteMyData
+std::string_view FormatSerialNumber(const FRDMyData& data, Arena& arena);
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdio>
+#include "friend_code.h"
+#include "parallel.h"
+
+namespace {
+
+constexpr std::size_t LANES = 8;
+
+/// Eight u32 lanes; GCC lowers this to AVX2 or to pairs of SSE2 registers depending on the target
+typedef u32 LaneVector __attribute__((vector_size(LANES * sizeof(u32))));
+
+// A macro rather than a function, as passing 32 byte vectors by value to a non-AVX function
+// changes the ABI between the target clones
+#define ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+/**
+ * First SHA-1 digest byte for eight principal IDs at once. The message is always a single block:
+ * the four ID bytes, the 0x80 terminator, zeros and a bit length of 32, so most of the message
+ * schedule is constant.
+ */
+__attribute__((target_clones("avx2", "default"))) void FirstDigestBytes(const u32* ids, u8* out) {
+    LaneVector id;
+    for (std::size_t lane = 0; lane < LANES; lane++) {
+        id[lane] = ids[lane];
+    }
+
+    LaneVector w[16] = {};
+    // SHA-1 reads the message big endian, the ID is stored little endian
+    w[0] = (id >> 24) | ((id >> 8) & 0xFF00) | ((id << 8) & 0xFF0000) | (id << 24);
+    w[1] = w[1] + 0x80000000u;
+    w[15] = w[15] + 32u;
+
+    constexpr u32 h0 = 0x67452301, h1 = 0xEFCDAB89, h2 = 0x98BADCFE, h3 = 0x10325476,
+                  h4 = 0xC3D2E1F0;
+    LaneVector a = LaneVector{} + h0;
+    LaneVector b = LaneVector{} + h1;
+    LaneVector c = LaneVector{} + h2;
+    LaneVector d = LaneVector{} + h3;
+    LaneVector e = LaneVector{} + h4;
+
+    for (int t = 0; t < 80; t++) {
+        if (t >= 16) {
+            w[t & 15] = ROTL(w[(t - 3) & 15] ^ w[(t - 8) & 15] ^ w[(t - 14) & 15] ^ w[t & 15], 1);
+        }
+
+        LaneVector f;
+        u32 k;
+        if (t < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (t < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (t < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+
+        const LaneVector temp = ROTL(a, 5) + f + e + k + w[t & 15];
+        e = d;
+        d = c;
+        c = ROTL(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    const LaneVector digest0 = a + h0;
+    for (std::size_t lane = 0; lane < LANES; lane++) {
+        out[lane] = static_cast<u8>(digest0[lane] >> 24);
+    }
+}
+
+#undef ROTL
+
+constexpr u64 ComposeFriendCode(u32 principal_id, u8 digest_byte) {
+    return u64{static_cast<u8>(digest_byte >> 1)} << 32 | principal_id;
+}
+
+} // namespace
+
+u64 PrincipalIdToFriendCode(u32 principal_id) {
+    std::array<u32, LANES> ids{principal_id};
+    std::array<u8, LANES> digest;
+    FirstDigestBytes(ids.data(), digest.data());
+    return ComposeFriendCode(principal_id, digest[0]);
+}
+
+void PrincipalIdsToFriendCodes(std::span<const u32> principal_ids, std::span<u64> out) {
+    assert(out.size() >= principal_ids.size());
+    const std::size_t blocks = (principal_ids.size() + LANES - 1) / LANES;
+    ParallelFor(blocks, [&](std::size_t begin, std::size_t end) {
+        std::array<u32, LANES> ids{};
+        std::array<u8, LANES> digest;
+        for (std::size_t block = begin; block < end; block++) {
+            const std::size_t first = block * LANES;
+            const std::size_t count = std::min(LANES, principal_ids.size() - first);
+            std::copy_n(principal_ids.begin() + first, count, ids.begin());
+            FirstDigestBytes(ids.data(), digest.data());
+            for (std::size_t lane = 0; lane < count; lane++) {
+                out[first + lane] = ComposeFriendCode(ids[lane], digest[lane]);
+            }
+        }
+    });
+}
+
+bool IsValidFriendCode(u64 friend_code) {
+    return friend_code >> 39 == 0 &&
+           PrincipalIdToFriendCode(static_cast<u32>(friend_code)) == friend_code;
+}
+
+std::string FormatFriendCode(u64 friend_code) {
+    char digits[13];
+    std::snprintf(digits, sizeof(digits), "%012llu",
+                  static_cast<unsigned long long>(friend_code % 1000000000000ULL));
+    const std::string_view view(digits, 12);
+    std::string result;
+    result.reserve(14);
+    result.append(view.substr(0, 4)).append(1, '-');
+    result.append(view.substr(4, 4)).append(1, '-');
+    result.append(view.substr(8, 4));
+    return result;
+}
+
+std::optional<u64> ParseFriendCode(std::string_view text) {
+    u64 value = 0;
+    std::size_t digits = 0;
+    for (const char c : text) {
+        if (c == '-' || c == ' ') {
+            continue;
+        }
+        if (c < '0' || c > '9' || ++digits > 12) {
+            return std::nullopt;
+        }
+        value = value * 10 + static_cast<u64>(c - '0');
+    }
+    if (digits != 12) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+FriendCodeIndex::FriendCodeIndex(std::span<const u32> principal_ids)
+    : friend_codes(principal_ids.size()) {
+    PrincipalIdsToFriendCodes(principal_ids, friend_codes);
+    ParallelSort(friend_codes);
+    friend_codes.erase(std::unique(friend_codes.begin(), friend_codes.end()), friend_codes.end());
+}
+
+std::optional<u32> FriendCodeIndex::Find(u64 friend_code) const {
+    const auto it = std::lower_bound(friend_codes.begin(), friend_codes.end(), friend_code);
+    if (it == friend_codes.end() || *it != friend_code) {
+        return std::nullopt;
+    }
+    return static_cast<u32>(*it);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "swap.h"
+
+/**
+ * Friend code of a principal ID: bits 32-38 hold the first byte of SHA-1(principal ID as 4 little
+ * endian bytes) shifted right by one, the low 32 bits hold the principal ID itself.
+ */
+[[nodiscard]] u64 PrincipalIdToFriendCode(u32 principal_id);
+
+/// Derives out[i] from principal_ids[i], eight IDs at a time in SIMD lanes; out must be as large
+void PrincipalIdsToFriendCodes(std::span<const u32> principal_ids, std::span<u64> out);
+
+/// True if the checksum bits match the principal ID in the low 32 bits
+[[nodiscard]] bool IsValidFriendCode(u64 friend_code);
+
+/// Formats as the 12 digit "XXXX-XXXX-XXXX" shown on the console
+[[nodiscard]] std::string FormatFriendCode(u64 friend_code);
+
+/// Parses 12 digits, optionally separated by dashes or spaces; does not check validity
+[[nodiscard]] std::optional<u64> ParseFriendCode(std::string_view text);
+
+/// Sorted friend codes of a known set of accounts, for matching codes back to principal IDs
+class FriendCodeIndex {
+public:
+    FriendCodeIndex() = default;
+    explicit FriendCodeIndex(std::span<const u32> principal_ids);
+
+    /// Principal ID of the account owning friend_code, if it is part of the set
+    [[nodiscard]] std::optional<u32> Find(u64 friend_code) const;
+
+    [[nodiscard]] std::size_t Size() const {
+        return friend_codes.size();
+    }
+
+private:
+    std::vector<u64> friend_codes;
+};
@@ -0,0 +1,438 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <numeric>
+#include "friend_graph.h"
+#include "parallel.h"
+
+struct FriendGraph::Header {
+    std::array<char, 8> magic;
+    u64 vertex_count;
+    u64 target_count; ///< Twice the edge count
+    u64 offsets_offset;
+    u64 targets_offset;
+    u64 principal_ids_offset;
+    u64 owner_records_offset;
+    u64 reserved;
+};
+
+namespace {
+
+constexpr std::array<char, 8> FRIEND_GRAPH_MAGIC{'F', 'R', 'D', 'G', 'R', 'P', 'H', '1'};
+static_assert(sizeof(FriendGraph::Header) == 64);
+
+/// Never a real edge, whose low principal ID is strictly below its high one
+constexpr u64 INVALID_EDGE = ~u64{0};
+
+/// Bottom-up once the frontier's edges exceed 1/ALPHA of the unexplored ones, and back to top-down
+/// once the frontier holds fewer than 1/BETA of the vertices (Beamer et al.)
+constexpr u64 BFS_ALPHA = 14;
+constexpr u64 BFS_BETA = 24;
+
+u32 IndexOf(std::span<const u32> sorted, u32 value) {
+    return static_cast<u32>(std::lower_bound(sorted.begin(), sorted.end(), value) - sorted.begin());
+}
+
+/// Vertex of a principal ID known to be in the sorted ID list. A table over the top 16 bits of the
+/// largest ID narrows the binary search to a handful of entries.
+class VertexLookup {
+public:
+    explicit VertexLookup(std::span<const u32> ids_)
+        : ids(ids_), shift(std::max<int>(std::bit_width(ids.empty() ? 0u : ids.back()), 16) - 16),
+          buckets(BUCKETS + 1) {
+        std::size_t i = 0;
+        for (std::size_t bucket = 0; bucket < BUCKETS; bucket++) {
+            buckets[bucket] = static_cast<u32>(i);
+            while (i < ids.size() && ids[i] >> shift == bucket) {
+                i++;
+            }
+        }
+        buckets[BUCKETS] = static_cast<u32>(ids.size());
+    }
+
+    u32 operator()(u32 principal_id) const {
+        const std::size_t bucket = principal_id >> shift;
+        return static_cast<u32>(std::lower_bound(ids.begin() + buckets[bucket],
+                                                 ids.begin() + buckets[bucket + 1], principal_id) -
+                                ids.begin());
+    }
+
+private:
+    static constexpr std::size_t BUCKETS = 0x10000;
+
+    std::span<const u32> ids;
+    int shift;
+    std::vector<u32> buckets;
+};
+
+/// Root of v's set, halving the path on the way. Parents only ever move to smaller vertices.
+u32 FindRoot(std::vector<u32>& parent, u32 v) {
+    while (true) {
+        u32 p = std::atomic_ref<u32>(parent[v]).load(std::memory_order_relaxed);
+        if (p == v) {
+            return v;
+        }
+        const u32 grandparent = std::atomic_ref<u32>(parent[p]).load(std::memory_order_relaxed);
+        if (grandparent != p) {
+            std::atomic_ref<u32>(parent[v]).compare_exchange_weak(p, grandparent,
+                                                                  std::memory_order_relaxed);
+        }
+        v = grandparent;
+    }
+}
+
+/// Links the larger root below the smaller one, so every root is the smallest of its set
+void Unite(std::vector<u32>& parent, u32 a, u32 b) {
+    while (true) {
+        a = FindRoot(parent, a);
+        b = FindRoot(parent, b);
+        if (a == b) {
+            return;
+        }
+        if (a < b) {
+            std::swap(a, b);
+        }
+        u32 expected = a;
+        if (std::atomic_ref<u32>(parent[a]).compare_exchange_strong(expected, b,
+                                                                    std::memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+} // namespace
+
+bool FriendGraph::Build(std::span<const FriendList> lists, const std::string& path) {
+    // Every entry becomes (low principal ID << 32 | high principal ID), so that two consoles
+    // listing each other collapse into one edge once sorted
+    std::vector<u64> list_offsets(lists.size() + 1);
+    for (std::size_t i = 0; i < lists.size(); i++) {
+        list_offsets[i + 1] =
+            list_offsets[i] + std::min<std::size_t>(lists[i].friends.size(), FRIEND_LIST_SIZE);
+    }
+    std::vector<u64> edges(list_offsets.back());
+    ParallelFor(
+        lists.size(),
+        [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; i++) {
+                const u32 owner = lists[i].owner;
+                u64* out = edges.data() + list_offsets[i];
+                for (std::size_t j = 0; j < list_offsets[i + 1] - list_offsets[i]; j++) {
+                    const u32 other = lists[i].friends[j].principal_id;
+                    out[j] = other == 0 || other == owner
+                                 ? INVALID_EDGE
+                                 : u64{std::min(owner, other)} << 32 | std::max(owner, other);
+                }
+            }
+        },
+        0x100);
+    ParallelSort(edges);
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    if (!edges.empty() && edges.back() == INVALID_EDGE) {
+        edges.pop_back();
+    }
+
+    // Vertices are every owner and every listed friend, numbered by principal ID. Edges are sorted
+    // by their low end, so those only need deduplicating against their neighbour.
+    std::vector<u32> ids(lists.size() + edges.size());
+    for (std::size_t i = 0; i < lists.size(); i++) {
+        ids[i] = lists[i].owner;
+    }
+    ParallelFor(edges.size(), [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            ids[lists.size() + i] = static_cast<u32>(edges[i]);
+        }
+    });
+    for (std::size_t i = 0; i < edges.size(); i++) {
+        if (i == 0 || edges[i] >> 32 != edges[i - 1] >> 32) {
+            ids.push_back(static_cast<u32>(edges[i] >> 32));
+        }
+    }
+    ParallelSort(ids);
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    const std::size_t vertices = ids.size();
+    const VertexLookup lookup(ids);
+
+    // Renumber edge ends to vertices in place, counting degrees into offsets[v + 1]
+    std::vector<u64> offsets(vertices + 1);
+    ParallelFor(edges.size(), [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            const u32 low = lookup(static_cast<u32>(edges[i] >> 32));
+            const u32 high = lookup(static_cast<u32>(edges[i]));
+            edges[i] = u64{low} << 32 | high;
+            std::atomic_ref<u64>(offsets[low + 1]).fetch_add(1, std::memory_order_relaxed);
+            std::atomic_ref<u64>(offsets[high + 1]).fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    std::vector<u32> targets(offsets.back());
+    std::vector<u64> cursors(offsets.begin(), offsets.end() - 1);
+    ParallelFor(edges.size(), [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            const u32 low = static_cast<u32>(edges[i] >> 32);
+            const u32 high = static_cast<u32>(edges[i]);
+            targets[std::atomic_ref<u64>(cursors[low]).fetch_add(1, std::memory_order_relaxed)] =
+                high;
+            targets[std::atomic_ref<u64>(cursors[high]).fetch_add(1, std::memory_order_relaxed)] =
+                low;
+        }
+    });
+    edges = {};
+    cursors = {};
+    ParallelFor(vertices, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t v = begin; v < end; v++) {
+            std::sort(targets.begin() + offsets[v], targets.begin() + offsets[v + 1]);
+        }
+    });
+
+    // The first list of an owner names its record
+    std::vector<u32> owner_records(vertices, FriendList::NO_RECORD);
+    for (const FriendList& list : lists) {
+        u32& record = owner_records[lookup(list.owner)];
+        if (record == FriendList::NO_RECORD) {
+            record = list.owner_record;
+        }
+    }
+
+    Header header{};
+    header.magic = FRIEND_GRAPH_MAGIC;
+    header.vertex_count = vertices;
+    header.target_count = targets.size();
+    header.offsets_offset = sizeof(Header);
+    header.targets_offset = header.offsets_offset + offsets.size() * sizeof(u64);
+    header.principal_ids_offset = header.targets_offset + targets.size() * sizeof(u32);
+    header.owner_records_offset = header.principal_ids_offset + ids.size() * sizeof(u32);
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    const bool written =
+        WriteSection(file, 0, &header, sizeof(header)) &&
+        WriteSection(file, header.offsets_offset, offsets.data(), offsets.size() * sizeof(u64)) &&
+        WriteSection(file, header.targets_offset, targets.data(), targets.size() * sizeof(u32)) &&
+        WriteSection(file, header.principal_ids_offset, ids.data(), ids.size() * sizeof(u32)) &&
+        WriteSection(file, header.owner_records_offset, owner_records.data(),
+                     owner_records.size() * sizeof(u32));
+    return std::fclose(file) == 0 && written;
+}
+
+bool FriendGraph::Open(const std::string& path) {
+    vertex_count = 0;
+    offsets = nullptr;
+    targets = principal_ids = owner_records = nullptr;
+    if (!file.Open(path)) {
+        return false;
+    }
+
+    const std::span<const u8> bytes = file.Bytes();
+    Header header;
+    if (bytes.size() < sizeof(header)) {
+        file.Close();
+        return false;
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    const u64 vertices = header.vertex_count;
+    // Sizes are checked one at a time against what is left, so corrupt counts cannot overflow
+    if (header.magic != FRIEND_GRAPH_MAGIC || header.offsets_offset != sizeof(Header) ||
+        vertices >= std::numeric_limits<u32>::max() ||
+        (vertices + 1) * sizeof(u64) > bytes.size() - header.offsets_offset ||
+        header.targets_offset != header.offsets_offset + (vertices + 1) * sizeof(u64) ||
+        header.target_count > (bytes.size() - header.targets_offset) / sizeof(u32) ||
+        header.principal_ids_offset != header.targets_offset + header.target_count * sizeof(u32) ||
+        vertices > (bytes.size() - header.principal_ids_offset) / sizeof(u32) ||
+        header.owner_records_offset != header.principal_ids_offset + vertices * sizeof(u32) ||
+        vertices > (bytes.size() - header.owner_records_offset) / sizeof(u32)) {
+        file.Close();
+        return false;
+    }
+
+    offsets = reinterpret_cast<const u64*>(bytes.data() + header.offsets_offset);
+    targets = reinterpret_cast<const u32*>(bytes.data() + header.targets_offset);
+    // Traversals index by offsets and targets without checks, so every row must lie within the
+    // targets and name only existing vertices. One parallel pass, as cheap as a traversal.
+    std::atomic<bool> valid = offsets[0] == 0 && offsets[vertices] == header.target_count;
+    if (valid) {
+        ParallelFor(vertices, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t v = begin; v < end && valid.load(std::memory_order_relaxed); v++) {
+                if (offsets[v] > offsets[v + 1] || offsets[v + 1] > header.target_count ||
+                    !std::all_of(targets + offsets[v], targets + offsets[v + 1],
+                                 [&](u32 target) { return target < vertices; })) {
+                    valid.store(false, std::memory_order_relaxed);
+                }
+            }
+        });
+    }
+    if (!valid) {
+        offsets = nullptr;
+        targets = nullptr;
+        file.Close();
+        return false;
+    }
+    vertex_count = vertices;
+    principal_ids = reinterpret_cast<const u32*>(bytes.data() + header.principal_ids_offset);
+    owner_records = reinterpret_cast<const u32*>(bytes.data() + header.owner_records_offset);
+    return true;
+}
+
+std::optional<u32> FriendGraph::FindVertex(u32 principal_id) const {
+    const std::span<const u32> ids(principal_ids, vertex_count);
+    const u32 vertex = IndexOf(ids, principal_id);
+    if (vertex == vertex_count || ids[vertex] != principal_id) {
+        return std::nullopt;
+    }
+    return vertex;
+}
+
+std::vector<u32> FriendGraph::Bfs(u32 source) const {
+    std::vector<u32> depth(vertex_count, UNREACHED);
+    if (source >= vertex_count) {
+        return depth;
+    }
+    const auto degree = [this](u32 v) { return offsets[v + 1] - offsets[v]; };
+
+    depth[source] = 0;
+    std::vector<u32> frontier{source};
+    std::vector<u64> frontier_bits;
+    bool bottom_up = false;
+    u64 frontier_size = 1;
+    u64 frontier_edges = degree(source);
+    u64 unexplored_edges = offsets[vertex_count] - frontier_edges;
+    std::mutex mutex;
+
+    for (u32 level = 1; frontier_size != 0; level++) {
+        if (!bottom_up && frontier_edges > unexplored_edges / BFS_ALPHA) {
+            frontier_bits.assign((vertex_count + 63) / 64, 0);
+            for (const u32 v : frontier) {
+                frontier_bits[v / 64] |= u64{1} << (v % 64);
+            }
+            bottom_up = true;
+        } else if (bottom_up && frontier_size < vertex_count / BFS_BETA) {
+            frontier.clear();
+            for (std::size_t word = 0; word < frontier_bits.size(); word++) {
+                for (u64 bits = frontier_bits[word]; bits != 0; bits &= bits - 1) {
+                    frontier.push_back(static_cast<u32>(word * 64 + std::countr_zero(bits)));
+                }
+            }
+            bottom_up = false;
+        }
+
+        u64 next_size = 0;
+        u64 next_edges = 0;
+        if (bottom_up) {
+            // Each worker owns whole words of the next frontier and the depths of their vertices
+            std::vector<u64> next_bits(frontier_bits.size());
+            ParallelFor(
+                next_bits.size(),
+                [&](std::size_t begin, std::size_t end) {
+                    u64 size = 0;
+                    u64 edges = 0;
+                    for (std::size_t v = begin * 64; v < std::min(end * 64, vertex_count); v++) {
+                        if (depth[v] != UNREACHED) {
+                            continue;
+                        }
+                        for (const u32 parent : Neighbours(static_cast<u32>(v))) {
+                            if (frontier_bits[parent / 64] >> (parent % 64) & 1) {
+                                depth[v] = level;
+                                next_bits[v / 64] |= u64{1} << (v % 64);
+                                size++;
+                                edges += degree(static_cast<u32>(v));
+                                break;
+                            }
+                        }
+                    }
+                    const std::scoped_lock lock(mutex);
+                    next_size += size;
+                    next_edges += edges;
+                },
+                0x40);
+            frontier_bits.swap(next_bits);
+        } else {
+            std::vector<u32> next;
+            ParallelFor(
+                frontier.size(),
+                [&](std::size_t begin, std::size_t end) {
+                    std::vector<u32> local;
+                    u64 edges = 0;
+                    for (std::size_t i = begin; i < end; i++) {
+                        for (const u32 child : Neighbours(frontier[i])) {
+                            std::atomic_ref<u32> child_depth(depth[child]);
+                            u32 expected = UNREACHED;
+                            if (child_depth.load(std::memory_order_relaxed) == UNREACHED &&
+                                child_depth.compare_exchange_strong(expected, level,
+                                                                    std::memory_order_relaxed)) {
+                                local.push_back(child);
+                                edges += degree(child);
+                            }
+                        }
+                    }
+                    const std::scoped_lock lock(mutex);
+                    next.insert(next.end(), local.begin(), local.end());
+                    next_edges += edges;
+                },
+                0x100);
+            next_size = next.size();
+            frontier.swap(next);
+        }
+        frontier_size = next_size;
+        frontier_edges = next_edges;
+        unexplored_edges -= std::min(unexplored_edges, next_edges);
+    }
+    return depth;
+}
+
+std::vector<u32> FriendGraph::ConnectedComponents() const {
+    std::vector<u32> parent(vertex_count);
+    std::iota(parent.begin(), parent.end(), 0);
+    ParallelFor(vertex_count, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t v = begin; v < end; v++) {
+            for (const u32 u : Neighbours(static_cast<u32>(v))) {
+                if (u > v) {
+                    Unite(parent, static_cast<u32>(v), u);
+                }
+            }
+        }
+    });
+    ParallelFor(vertex_count, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t v = begin; v < end; v++) {
+            parent[v] = FindRoot(parent, static_cast<u32>(v));
+        }
+    });
+    return parent;
+}
+
+DegreeStats FriendGraph::Degrees() const {
+    DegreeStats stats;
+    stats.vertex_count = vertex_count;
+    stats.edge_count = EdgeCount();
+    if (vertex_count == 0) {
+        return stats;
+    }
+    stats.min_degree = std::numeric_limits<u32>::max();
+    stats.mean_degree = static_cast<double>(offsets[vertex_count]) / vertex_count;
+
+    std::mutex mutex;
+    ParallelFor(vertex_count, [&](std::size_t begin, std::size_t end) {
+        DegreeStats local;
+        local.min_degree = std::numeric_limits<u32>::max();
+        for (std::size_t v = begin; v < end; v++) {
+            const u32 degree = static_cast<u32>(offsets[v + 1] - offsets[v]);
+            local.min_degree = std::min(local.min_degree, degree);
+            local.max_degree = std::max(local.max_degree, degree);
+            local.isolated += degree == 0;
+            local.histogram[std::bit_width(degree)]++;
+        }
+        const std::scoped_lock lock(mutex);
+        stats.min_degree = std::min(stats.min_degree, local.min_degree);
+        stats.max_degree = std::max(stats.max_degree, local.max_degree);
+        stats.isolated += local.isolated;
+        for (std::size_t i = 0; i < stats.histogram.size(); i++) {
+            stats.histogram[i] += local.histogram[i];
+        }
+    });
+    return stats;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+#include "main.h"
+#include "mapped_file.h"
+
+/// One console's friend list, keyed by the principal ID of its owner
+struct FriendList {
+    static constexpr u32 NO_RECORD = std::numeric_limits<u32>::max();
+
+    u32 owner;                          ///< Principal ID of the owner
+    u32 owner_record = NO_RECORD;       ///< Index of the owner's FRDMyData in its corpus, if known
+    std::span<const FriendKey> friends; ///< Only the first FRIEND_LIST_SIZE are used
+};
+
+struct DegreeStats {
+    u64 vertex_count = 0;
+    u64 edge_count = 0; ///< Undirected edges
+    u32 min_degree = 0;
+    u32 max_degree = 0;
+    double mean_degree = 0;
+    u64 isolated = 0; ///< Owners without any friends
+    /// Vertices by degree: [0] is degree 0, [i] is degrees in [2^(i-1), 2^i)
+    std::array<u64, 33> histogram{};
+};
+
+/**
+ * Undirected graph of friendships between principal IDs, stored as compressed sparse rows: the
+ * neighbours of vertex v are targets[offsets[v], offsets[v + 1]), sorted. Vertices are numbered
+ * by ascending principal ID. A friendship is an edge if either side lists the other, so pending
+ * one-way entries count too.
+ *
+ * Built in parallel into a file, which Open maps without parsing, like RecordIndex, and checks
+ * in one parallel pass so traversals can index it unchecked. Traversals run on all cores.
+ */
+class FriendGraph {
+public:
+    static constexpr u32 UNREACHED = std::numeric_limits<u32>::max();
+
+    /**
+     * Builds the graph of lists and writes it to path. Entries with principal ID 0 (empty slots)
+     * and self-friendships are skipped; lists of the same owner are merged.
+     */
+    static bool Build(std::span<const FriendList> lists, const std::string& path);
+
+    bool Open(const std::string& path);
+
+    [[nodiscard]] u64 VertexCount() const {
+        return vertex_count;
+    }
+
+    /// Undirected edges; each is stored once per direction
+    [[nodiscard]] u64 EdgeCount() const {
+        return offsets ? offsets[vertex_count] / 2 : 0;
+    }
+
+    [[nodiscard]] u32 PrincipalId(u32 vertex) const {
+        return principal_ids[vertex];
+    }
+
+    /// Owner record passed to Build for this vertex, or FriendList::NO_RECORD
+    [[nodiscard]] u32 OwnerRecord(u32 vertex) const {
+        return owner_records[vertex];
+    }
+
+    [[nodiscard]] std::optional<u32> FindVertex(u32 principal_id) const;
+
+    [[nodiscard]] std::span<const u32> Neighbours(u32 vertex) const {
+        return {targets + offsets[vertex], targets + offsets[vertex + 1]};
+    }
+
+    /**
+     * Hop count from source to every vertex, UNREACHED if disconnected. Direction optimizing:
+     * small frontiers expand top-down over their edges, large ones switch to bottom-up, where every
+     * unvisited vertex looks for any parent in the frontier and stops at the first.
+     */
+    [[nodiscard]] std::vector<u32> Bfs(u32 source) const;
+
+    /// Component of every vertex, labelled by its smallest vertex
+    [[nodiscard]] std::vector<u32> ConnectedComponents() const;
+
+    [[nodiscard]] DegreeStats Degrees() const;
+
+    struct Header;
+
+private:
+    MappedFile file;
+    u64 vertex_count = 0;
+    const u64* offsets = nullptr;
+    const u32* targets = nullptr;
+    const u32* principal_ids = nullptr;
+    const u32* owner_records = nullptr;
+};
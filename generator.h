@@ -0,0 +1,109 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+/**
+ * Minimal lazy coroutine generator (a subset of C++23 std::generator).
+ * Yielded values are exposed by const reference and stay valid until the iterator is advanced.
+ */
+template <typename T>
+class Generator {
+public:
+    struct promise_type {
+        const T* current = nullptr;
+        std::exception_ptr exception;
+
+        Generator get_return_object() {
+            return Generator{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+        std::suspend_always final_suspend() noexcept {
+            return {};
+        }
+        std::suspend_always yield_value(const T& value) noexcept {
+            current = std::addressof(value);
+            return {};
+        }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept {
+            exception = std::current_exception();
+        }
+    };
+
+    using Handle = std::coroutine_handle<promise_type>;
+
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+        using value_type = T;
+
+        iterator() = default;
+        explicit iterator(Handle handle_) : handle(handle_) {}
+
+        const T& operator*() const {
+            return *handle.promise().current;
+        }
+        const T* operator->() const {
+            return handle.promise().current;
+        }
+        iterator& operator++() {
+            Resume(handle);
+            return *this;
+        }
+        void operator++(int) {
+            ++*this;
+        }
+        bool operator==(std::default_sentinel_t) const {
+            return !handle || handle.done();
+        }
+
+    private:
+        Handle handle{};
+    };
+
+    Generator(Generator&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Generator& operator=(Generator&& other) noexcept {
+        if (this != &other) {
+            if (handle) {
+                handle.destroy();
+            }
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+    Generator(const Generator&) = delete;
+    Generator& operator=(const Generator&) = delete;
+
+    ~Generator() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    iterator begin() {
+        Resume(handle);
+        return iterator{handle};
+    }
+    std::default_sentinel_t end() const {
+        return {};
+    }
+
+private:
+    explicit Generator(Handle handle_) : handle(handle_) {}
+
+    static void Resume(Handle handle) {
+        handle.resume();
+        if (handle.done() && handle.promise().exception) {
+            std::rethrow_exception(handle.promise().exception);
+        }
+    }
+
+    Handle handle;
+};
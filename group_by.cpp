@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <mutex>
+#include <unordered_map>
+#include "group_by.h"
+#include "parallel.h"
+
+namespace {
+
+/// Widest packed (group key, value) pair whose distinct pairs are marked in one shared bitmap
+constexpr std::size_t DENSE_DISTINCT_BITS = 24;
+
+using GroupKey = std::array<u64, 2>;
+
+struct GroupKeyHash {
+    std::size_t operator()(const GroupKey& key) const {
+        return std::hash<u64>{}(key[0] * 0x9E3779B97F4A7C15 ^ key[1]);
+    }
+};
+
+struct Accumulator {
+    u64 count = 0;
+    u64 min = ~u64{0};
+    u64 max = 0;
+
+    void Add(u64 value) {
+        min = std::min(min, value);
+        max = std::max(max, value);
+    }
+
+    void Merge(const Accumulator& other) {
+        count += other.count;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+};
+
+/// Flat table indexed by the group field values packed side by side
+class DenseTable {
+public:
+    DenseTable(std::size_t first_bits_, std::size_t key_bits)
+        : first_bits(first_bits_), accumulators(std::size_t{1} << key_bits) {}
+
+    Accumulator& At(const GroupKey& key) {
+        return accumulators[key[0] | key[1] << first_bits];
+    }
+
+    void Merge(const DenseTable& other) {
+        for (std::size_t i = 0; i < accumulators.size(); i++) {
+            if (other.accumulators[i].count != 0) {
+                accumulators[i].Merge(other.accumulators[i]);
+            }
+        }
+    }
+
+    template <typename Func>
+    void ForEach(Func&& func) const {
+        const u64 first_mask = (u64{1} << first_bits) - 1;
+        for (std::size_t i = 0; i < accumulators.size(); i++) {
+            if (accumulators[i].count != 0) {
+                func(GroupKey{i & first_mask, i >> first_bits}, accumulators[i]);
+            }
+        }
+    }
+
+private:
+    std::size_t first_bits;
+    std::vector<Accumulator> accumulators;
+};
+
+class SparseTable {
+public:
+    SparseTable(std::size_t, std::size_t) {}
+
+    Accumulator& At(const GroupKey& key) {
+        return accumulators[key];
+    }
+
+    void Merge(const SparseTable& other) {
+        for (const auto& [key, accumulator] : other.accumulators) {
+            accumulators[key].Merge(accumulator);
+        }
+    }
+
+    template <typename Func>
+    void ForEach(Func&& func) const {
+        for (const auto& [key, accumulator] : accumulators) {
+            func(key, accumulator);
+        }
+    }
+
+private:
+    std::unordered_map<GroupKey, Accumulator, GroupKeyHash> accumulators;
+};
+
+/// Number of set bits of bitmap in [begin, end)
+u64 CountBits(std::span<const u64> bitmap, std::size_t begin, std::size_t end) {
+    u64 count = 0;
+    while (begin < end) {
+        const std::size_t word_end = std::min(end, (begin / 64 + 1) * 64);
+        const std::size_t width = word_end - begin;
+        const u64 mask = width == 64 ? ~u64{0} : ((u64{1} << width) - 1) << (begin % 64);
+        count += std::popcount(bitmap[begin / 64] & mask);
+        begin = word_end;
+    }
+    return count;
+}
+
+/**
+ * Fills in the distinct count of the value field for groups, which are sorted by key. When the
+ * group key and the value packed side by side fit in DENSE_DISTINCT_BITS, every (key, value) pair
+ * sets one bit of a bitmap shared by the worker threads, and a group's count is the number of bits
+ * set in its range. Otherwise the pairs are sorted and counted in runs.
+ */
+void CountDistinct(std::span<const u8> records, std::size_t record_size,
+                   std::span<const FieldInfo* const> group_fields, const FieldInfo& value_field,
+                   std::span<GroupStats> groups) {
+    const std::size_t record_count = records.size() / record_size;
+    const std::size_t first_bits = group_fields[0]->bits;
+    const std::size_t key_bits = first_bits + (group_fields.size() > 1 ? group_fields[1]->bits : 0);
+    const std::size_t value_bits = value_field.bits;
+    const auto read_key = [&](const u8* record) {
+        GroupKey key{};
+        for (std::size_t field = 0; field < group_fields.size(); field++) {
+            key[field] = ReadFieldValue(record, *group_fields[field]);
+        }
+        return key;
+    };
+
+    if (key_bits + value_bits <= DENSE_DISTINCT_BITS) {
+        std::vector<u64> bitmap(((std::size_t{1} << (key_bits + value_bits)) + 63) / 64);
+        ParallelFor(record_count, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; i++) {
+                const u8* record = records.data() + i * record_size;
+                const GroupKey key = read_key(record);
+                const u64 bit = (key[0] | key[1] << first_bits) << value_bits |
+                                ReadFieldValue(record, value_field);
+                std::atomic_ref<u64> word(bitmap[bit / 64]);
+                const u64 mask = u64{1} << (bit % 64);
+                if (!(word.load(std::memory_order_relaxed) & mask)) {
+                    word.fetch_or(mask, std::memory_order_relaxed);
+                }
+            }
+        });
+        ParallelFor(
+            groups.size(),
+            [&](std::size_t begin, std::size_t end) {
+                for (std::size_t i = begin; i < end; i++) {
+                    const u64 first = (groups[i].key[0] | groups[i].key[1] << first_bits)
+                                      << value_bits;
+                    groups[i].distinct =
+                        CountBits(bitmap, first, first + (std::size_t{1} << value_bits));
+                }
+            },
+            0x100);
+        return;
+    }
+
+    struct Pair {
+        GroupKey key;
+        u64 value;
+
+        auto operator<=>(const Pair&) const = default;
+    };
+    std::vector<Pair> pairs(record_count);
+    ParallelFor(record_count, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            const u8* record = records.data() + i * record_size;
+            pairs[i] = {read_key(record), ReadFieldValue(record, value_field)};
+        }
+    });
+    ParallelSort(pairs, std::less<>{});
+    // Both are sorted by key, and every key in pairs has a group
+    std::size_t group = 0;
+    for (std::size_t i = 0; i < pairs.size(); i++) {
+        while (groups[group].key != pairs[i].key) {
+            group++;
+        }
+        groups[group].distinct += i == 0 || pairs[i] != pairs[i - 1];
+    }
+}
+
+template <typename Table>
+std::vector<GroupStats> Aggregate(std::span<const u8> records, std::size_t record_size,
+                                  std::span<const FieldInfo* const> group_fields,
+                                  const FieldInfo* value_field) {
+    const std::size_t first_bits = group_fields[0]->bits;
+    const std::size_t key_bits = first_bits + (group_fields.size() > 1 ? group_fields[1]->bits : 0);
+
+    std::mutex mutex;
+    std::optional<Table> merged;
+
+    ParallelFor(records.size() / record_size, [&](std::size_t begin, std::size_t end) {
+        Table table(first_bits, key_bits);
+        for (std::size_t i = begin; i < end; i++) {
+            const u8* record = records.data() + i * record_size;
+            GroupKey key{};
+            for (std::size_t field = 0; field < group_fields.size(); field++) {
+                key[field] = ReadFieldValue(record, *group_fields[field]);
+            }
+            Accumulator& accumulator = table.At(key);
+            accumulator.count++;
+            if (value_field) {
+                accumulator.Add(ReadFieldValue(record, *value_field));
+            }
+        }
+
+        std::scoped_lock lock{mutex};
+        if (!merged) {
+            merged.emplace(std::move(table));
+        } else {
+            merged->Merge(table);
+        }
+    });
+
+    std::vector<GroupStats> groups;
+    if (merged) {
+        merged->ForEach([&](const GroupKey& key, const Accumulator& accumulator) {
+            GroupStats& group = groups.emplace_back();
+            group.key = key;
+            group.count = accumulator.count;
+            if (value_field) {
+                group.min = accumulator.min;
+                group.max = accumulator.max;
+            }
+        });
+    }
+    std::sort(groups.begin(), groups.end(),
+              [](const GroupStats& a, const GroupStats& b) { return a.key < b.key; });
+    if (value_field) {
+        CountDistinct(records, record_size, group_fields, *value_field, groups);
+    }
+    return groups;
+}
+
+} // namespace
+
+std::optional<GroupByResult> GroupBy(std::span<const u8> records, std::size_t record_size,
+                                     std::span<const FieldInfo> fields,
+                                     std::span<const std::string_view> group_by,
+                                     std::string_view value_field, std::string* error) {
+    const auto fail = [&](std::string message) -> std::optional<GroupByResult> {
+        if (error) {
+            *error = std::move(message);
+        }
+        return std::nullopt;
+    };
+    const auto resolve = [&](std::string_view name) -> std::optional<std::size_t> {
+        const std::optional<std::size_t> index = ResolveField(fields, name);
+        if (!index) {
+            fail("unknown or ambiguous field " + std::string(name));
+        } else if (fields[*index].type != FieldType::Unsigned &&
+                   fields[*index].type != FieldType::BitField) {
+            fail(std::string(fields[*index].name) + " is an array and cannot be aggregated");
+            return std::nullopt;
+        }
+        return index;
+    };
+
+    if (group_by.empty() || group_by.size() > 2) {
+        return fail("expected one or two group fields");
+    }
+    GroupByResult result;
+    std::vector<const FieldInfo*> group_fields;
+    for (const std::string_view name : group_by) {
+        const std::optional<std::size_t> index = resolve(name);
+        if (!index) {
+            return std::nullopt;
+        }
+        result.group_fields.push_back(*index);
+        group_fields.push_back(&fields[*index]);
+    }
+    const FieldInfo* value = nullptr;
+    if (!value_field.empty()) {
+        result.value_field = resolve(value_field);
+        if (!result.value_field) {
+            return std::nullopt;
+        }
+        value = &fields[*result.value_field];
+    }
+
+    std::size_t key_bits = 0;
+    for (const FieldInfo* field : group_fields) {
+        key_bits += field->bits;
+    }
+    result.groups = key_bits <= DENSE_GROUP_KEY_BITS
+                        ? Aggregate<DenseTable>(records, record_size, group_fields, value)
+                        : Aggregate<SparseTable>(records, record_size, group_fields, value);
+    return result;
+}
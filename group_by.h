@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "field_table.h"
+
+/// Widest packed group key counted in flat per-thread arrays
+inline constexpr std::size_t DENSE_GROUP_KEY_BITS = 16;
+
+/// Aggregates of the records sharing one group key
+struct GroupStats {
+    std::array<u64, 2> key{}; ///< Values of the group fields; key[1] is 0 when grouping by one field
+    u64 count = 0;
+    u64 min = 0;      ///< Smallest value field value, if a value field was given
+    u64 max = 0;      ///< Largest value field value, if a value field was given
+    u64 distinct = 0; ///< Number of distinct value field values, if a value field was given
+};
+
+struct GroupByResult {
+    std::vector<std::size_t> group_fields;  ///< Indices into the record's field table
+    std::optional<std::size_t> value_field; ///< Index into the record's field table
+    std::vector<GroupStats> groups;         ///< Ordered by key
+};
+
+/**
+ * Counts records of record_size bytes grouped by the values of one or two fields and, when
+ * value_field is not empty, finds the min, max and distinct count of that field per group. Fields are
+ * named as in ResolveField and must be Unsigned or BitField fields. On failure, returns nullopt and
+ * stores a description of the problem in error, if given.
+ *
+ * Records are split across the worker threads. When the group fields span at most
+ * DENSE_GROUP_KEY_BITS bits together, each thread keeps flat arrays indexed by the packed key, sized
+ * from the fields' bit widths; wider keys fall back to hash maps. The per-thread tables are merged
+ * at the end. Distinct counts are taken in a separate pass, so that groups stay a few words each:
+ * from a bitmap over the packed (key, value) pairs when it is small enough, otherwise by sorting
+ * the pairs.
+ */
+[[nodiscard]] std::optional<GroupByResult> GroupBy(std::span<const u8> records,
+                                                   std::size_t record_size,
+                                                   std::span<const FieldInfo> fields,
+                                                   std::span<const std::string_view> group_by,
+                                                   std::string_view value_field,
+                                                   std::string* error = nullptr);
+
+template <typename Record>
+[[nodiscard]] std::optional<GroupByResult> GroupBy(std::span<const Record> records,
+                                                   std::span<const std::string_view> group_by,
+                                                   std::string_view value_field = {},
+                                                   std::string* error = nullptr) {
+    return GroupBy(std::span(reinterpret_cast<const u8*>(records.data()), records.size_bytes()),
+                   sizeof(Record), FieldsOf<Record>(), group_by, value_field, error);
+}
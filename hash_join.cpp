@@ -0,0 +1,315 @@
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include "hash_join.h"
+#include "parallel.h"
+
+namespace {
+
+/// Build partitions are aimed at this size, so their tuples and hash table stay in L2
+constexpr std::size_t JOIN_PARTITION_SIZE = 0x40000;
+constexpr int MAX_JOIN_PARTITION_BITS = 12;
+/// At most 2^8 temporary files per side
+constexpr int MAX_SPILL_PARTITION_BITS = 8;
+
+constexpr u32 EMPTY_SLOT = std::numeric_limits<u32>::max();
+
+struct JoinTuple {
+    u64 hash;
+    u32 record;
+    u8 size;
+    RecordIndex::KeyBytes key;
+};
+
+/// Fills out[0, end - begin) with the tuples of records [begin, end) of one side
+using TupleSource = std::function<void(std::size_t begin, std::size_t end, JoinTuple* out)>;
+
+template <typename Record>
+TupleSource MakeTupleSource(std::span<const Record> records, RecordKey key) {
+    return [records, key](std::size_t begin, std::size_t end, JoinTuple* out) {
+        Arena arena;
+        for (std::size_t i = begin; i < end; i++, out++) {
+            out->record = static_cast<u32>(i);
+            if constexpr (std::is_same_v<Record, FRDMyData>) {
+                out->size = static_cast<u8>(ExtractRecordKey(records[i], key, out->key, arena));
+            } else {
+                out->size = static_cast<u8>(ExtractRecordKey(records[i], out->key));
+            }
+            out->hash = BloomHash(std::span(out->key.data(), out->size));
+        }
+    };
+}
+
+bool SameKey(const JoinTuple& a, const JoinTuple& b) {
+    return a.hash == b.hash && a.size == b.size &&
+           std::memcmp(a.key.data(), b.key.data(), a.size) == 0;
+}
+
+std::vector<JoinTuple> ExtractTuples(const TupleSource& source, std::size_t begin,
+                                     std::size_t end) {
+    std::vector<JoinTuple> tuples(end - begin);
+    ParallelFor(tuples.size(), [&](std::size_t first, std::size_t last) {
+        source(begin + first, begin + last, tuples.data() + first);
+    });
+    return tuples;
+}
+
+/// Fewest radix bits that bring bytes down to target per partition
+int PartitionBits(std::size_t bytes, std::size_t target, int max_bits) {
+    if (bytes <= target) {
+        return 0;
+    }
+    return std::min(static_cast<int>(std::bit_width((bytes - 1) / target)), max_bits);
+}
+
+std::size_t PartitionOf(u64 hash, int shift, int bits) {
+    return bits == 0 ? 0 : (hash >> shift) & ((u64{1} << bits) - 1);
+}
+
+/**
+ * Reorders tuples so that every partition is contiguous, and returns the 2^bits + 1 partition
+ * offsets. Each worker histograms its own chunk, then scatters it to the positions given by a
+ * prefix sum over (partition, chunk), so no two workers write to the same place.
+ */
+std::vector<std::size_t> RadixPartition(std::vector<JoinTuple>& tuples, int shift, int bits) {
+    if (bits == 0) {
+        return {0, tuples.size()};
+    }
+    const std::size_t partitions = std::size_t{1} << bits;
+    const std::size_t chunks = std::clamp<std::size_t>(tuples.size() / 0x4000, 1, ThreadCount());
+    const auto chunk_begin = [&](std::size_t chunk) { return tuples.size() * chunk / chunks; };
+
+    std::vector<std::size_t> positions(chunks * partitions);
+    ParallelFor(
+        chunks,
+        [&](std::size_t begin, std::size_t end) {
+            for (std::size_t chunk = begin; chunk < end; chunk++) {
+                std::size_t* counts = positions.data() + chunk * partitions;
+                for (std::size_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); i++) {
+                    counts[PartitionOf(tuples[i].hash, shift, bits)]++;
+                }
+            }
+        },
+        1);
+
+    std::vector<std::size_t> offsets(partitions + 1);
+    std::size_t total = 0;
+    for (std::size_t partition = 0; partition < partitions; partition++) {
+        offsets[partition] = total;
+        for (std::size_t chunk = 0; chunk < chunks; chunk++) {
+            total += std::exchange(positions[chunk * partitions + partition], total);
+        }
+    }
+    offsets[partitions] = total;
+
+    std::vector<JoinTuple> partitioned(tuples.size());
+    ParallelFor(
+        chunks,
+        [&](std::size_t begin, std::size_t end) {
+            for (std::size_t chunk = begin; chunk < end; chunk++) {
+                std::size_t* next = positions.data() + chunk * partitions;
+                for (std::size_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); i++) {
+                    partitioned[next[PartitionOf(tuples[i].hash, shift, bits)]++] = tuples[i];
+                }
+            }
+        },
+        1);
+    tuples.swap(partitioned);
+    return offsets;
+}
+
+/// Joins one partition pair; table is scratch space reused across partitions
+void JoinPartition(std::span<const JoinTuple> build, std::span<const JoinTuple> probe,
+                   JoinType type, std::vector<u32>& table, JoinResult& result) {
+    if (build.empty()) {
+        if (type == JoinType::Anti) {
+            for (const JoinTuple& tuple : probe) {
+                result.records.push_back(tuple.record);
+            }
+        }
+        return;
+    }
+    if (probe.empty()) {
+        return;
+    }
+
+    // Linear probing on the low hash bits; the radix partitioning used the high ones
+    const std::size_t mask = std::bit_ceil(build.size() * 2) - 1;
+    table.assign(mask + 1, EMPTY_SLOT);
+    for (std::size_t i = 0; i < build.size(); i++) {
+        std::size_t slot = build[i].hash & mask;
+        while (table[slot] != EMPTY_SLOT) {
+            slot = (slot + 1) & mask;
+        }
+        table[slot] = static_cast<u32>(i);
+    }
+
+    for (const JoinTuple& tuple : probe) {
+        bool matched = false;
+        for (std::size_t slot = tuple.hash & mask; table[slot] != EMPTY_SLOT;
+             slot = (slot + 1) & mask) {
+            const JoinTuple& candidate = build[table[slot]];
+            if (!SameKey(candidate, tuple)) {
+                continue;
+            }
+            matched = true;
+            if (type != JoinType::Inner) {
+                break;
+            }
+            result.pairs.emplace_back(tuple.record, candidate.record);
+        }
+        if ((type == JoinType::Semi && matched) || (type == JoinType::Anti && !matched)) {
+            result.records.push_back(tuple.record);
+        }
+    }
+}
+
+/// Joins tuples whose top used_bits hash bits are already known to be equal on both sides
+void JoinInMemory(std::vector<JoinTuple>& left, std::vector<JoinTuple>& right, JoinType type,
+                  int used_bits, JoinResult& result) {
+    const int bits = std::min(PartitionBits(right.size() * sizeof(JoinTuple), JOIN_PARTITION_SIZE,
+                                            MAX_JOIN_PARTITION_BITS),
+                              64 - used_bits);
+    const int shift = 64 - used_bits - bits;
+    const std::vector<std::size_t> left_offsets = RadixPartition(left, shift, bits);
+    const std::vector<std::size_t> right_offsets = RadixPartition(right, shift, bits);
+
+    const std::size_t partitions = left_offsets.size() - 1;
+    std::vector<JoinResult> partials(partitions);
+    ParallelFor(
+        partitions,
+        [&](std::size_t begin, std::size_t end) {
+            std::vector<u32> table;
+            for (std::size_t partition = begin; partition < end; partition++) {
+                const std::span<const JoinTuple> build(right.data() + right_offsets[partition],
+                                                       right.data() + right_offsets[partition + 1]);
+                const std::span<const JoinTuple> probe(left.data() + left_offsets[partition],
+                                                       left.data() + left_offsets[partition + 1]);
+                JoinPartition(build, probe, type, table, partials[partition]);
+            }
+        },
+        1);
+
+    for (const JoinResult& partial : partials) {
+        result.pairs.insert(result.pairs.end(), partial.pairs.begin(), partial.pairs.end());
+        result.records.insert(result.records.end(), partial.records.begin(), partial.records.end());
+    }
+}
+
+/// One temporary file per spill partition, deleted when closed
+struct SpillFiles {
+    std::vector<std::FILE*> files;
+
+    ~SpillFiles() {
+        for (std::FILE* file : files) {
+            if (file) {
+                std::fclose(file);
+            }
+        }
+    }
+};
+
+/// Streams one side into its spill partitions, chunk_size records at a time
+bool Spill(const TupleSource& source, std::size_t count, int bits, std::size_t chunk_size,
+           SpillFiles& spill) {
+    spill.files.assign(std::size_t{1} << bits, nullptr);
+    for (std::FILE*& file : spill.files) {
+        if (!(file = std::tmpfile())) {
+            return false;
+        }
+    }
+    for (std::size_t begin = 0; begin < count; begin += chunk_size) {
+        std::vector<JoinTuple> tuples =
+            ExtractTuples(source, begin, std::min(count, begin + chunk_size));
+        const std::vector<std::size_t> offsets = RadixPartition(tuples, 64 - bits, bits);
+        for (std::size_t partition = 0; partition + 1 < offsets.size(); partition++) {
+            const std::size_t size = offsets[partition + 1] - offsets[partition];
+            if (size != 0 && std::fwrite(tuples.data() + offsets[partition], sizeof(JoinTuple),
+                                         size, spill.files[partition]) != size) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/// Reads back a spill partition and deletes its file
+bool ReadSpill(std::FILE*& file, std::vector<JoinTuple>& tuples) {
+    const long size = std::ftell(file);
+    bool ok = size >= 0 && std::fseek(file, 0, SEEK_SET) == 0;
+    if (ok) {
+        tuples.resize(static_cast<std::size_t>(size) / sizeof(JoinTuple));
+        ok = std::fread(tuples.data(), sizeof(JoinTuple), tuples.size(), file) == tuples.size();
+    }
+    std::fclose(std::exchange(file, nullptr));
+    return ok;
+}
+
+std::optional<JoinResult> Join(std::size_t left_count, const TupleSource& left,
+                               std::size_t right_count, const TupleSource& right, JoinType type,
+                               std::size_t memory_budget) {
+    JoinResult result;
+    // Extracted tuples plus their partitioned copy
+    const std::size_t tuple_bytes = (left_count + right_count) * sizeof(JoinTuple) * 2;
+    if (tuple_bytes <= memory_budget) {
+        std::vector<JoinTuple> left_tuples = ExtractTuples(left, 0, left_count);
+        std::vector<JoinTuple> right_tuples = ExtractTuples(right, 0, right_count);
+        JoinInMemory(left_tuples, right_tuples, type, 0, result);
+    } else {
+        // A partition pair should fit the budget, though a skewed key can still overshoot it
+        const int bits =
+            std::max(PartitionBits(tuple_bytes, memory_budget, MAX_SPILL_PARTITION_BITS), 1);
+        const std::size_t chunk_size =
+            std::max<std::size_t>(memory_budget / (sizeof(JoinTuple) * 2), 0x1000);
+        SpillFiles left_spill, right_spill;
+        if (!Spill(left, left_count, bits, chunk_size, left_spill) ||
+            !Spill(right, right_count, bits, chunk_size, right_spill)) {
+            return std::nullopt;
+        }
+        std::vector<JoinTuple> left_tuples, right_tuples;
+        for (std::size_t partition = 0; partition < left_spill.files.size(); partition++) {
+            if (!ReadSpill(left_spill.files[partition], left_tuples) ||
+                !ReadSpill(right_spill.files[partition], right_tuples)) {
+                return std::nullopt;
+            }
+            JoinInMemory(left_tuples, right_tuples, type, bits, result);
+        }
+    }
+    ParallelSort(result.pairs);
+    ParallelSort(result.records);
+    return result;
+}
+
+} // namespace
+
+std::optional<JoinResult> HashJoin(std::span<const FRDMyData> left,
+                                   std::span<const FRDMyData> right, RecordKey key, JoinType type,
+                                   std::size_t memory_budget) {
+    return Join(left.size(), MakeTupleSource(left, key), right.size(), MakeTupleSource(right, key),
+                type, memory_budget);
+}
+
+std::optional<JoinResult> HashJoin(std::span<const ChecksummedMiiData> left,
+                                   std::span<const ChecksummedMiiData> right, JoinType type,
+                                   std::size_t memory_budget) {
+    return Join(left.size(), MakeTupleSource(left, RecordKey::MiiIdentity), right.size(),
+                MakeTupleSource(right, RecordKey::MiiIdentity), type, memory_budget);
+}
+
+std::optional<JoinResult> HashJoin(std::span<const FRDMyData> left,
+                                   std::span<const ChecksummedMiiData> right, JoinType type,
+                                   std::size_t memory_budget) {
+    return Join(left.size(), MakeTupleSource(left, RecordKey::MiiIdentity), right.size(),
+                MakeTupleSource(right, RecordKey::MiiIdentity), type, memory_budget);
+}
+
+std::optional<JoinResult> HashJoin(std::span<const ChecksummedMiiData> left,
+                                   std::span<const FRDMyData> right, JoinType type,
+                                   std::size_t memory_budget) {
+    return Join(left.size(), MakeTupleSource(left, RecordKey::MiiIdentity), right.size(),
+                MakeTupleSource(right, RecordKey::MiiIdentity), type, memory_budget);
+}
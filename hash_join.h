@@ -0,0 +1,49 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+#include "main.h"
+#include "record_index.h"
+
+enum class JoinType : u8 {
+    Inner, ///< Every (left, right) pair of records with equal keys
+    Semi,  ///< Left records with at least one matching right record
+    Anti,  ///< Left records without any matching right record
+};
+
+struct JoinResult {
+    /// Inner joins: (left record, right record) pairs in ascending order
+    std::vector<std::pair<u32, u32>> pairs;
+    /// Semi and anti joins: left record numbers in ascending order
+    std::vector<u32> records;
+};
+
+/// Memory the join may use for its (key, record) tuples before it spills them to disk
+constexpr std::size_t DEFAULT_JOIN_MEMORY_BUDGET = std::size_t{1} << 30;
+
+/**
+ * Joins two corpora on a key, the right side being the build side. Keys are hashed once, then both
+ * sides are radix partitioned in parallel on the top bits of the hash until a build partition is
+ * about the size of an L2 cache, and every partition pair is joined independently with an open
+ * addressing table. When the tuples would not fit in memory_budget, both sides are first streamed
+ * into per-partition temporary files (a grace hash join) and joined one partition pair at a time,
+ * so only the input records, which may be memory mapped, need to be addressable.
+ *
+ * Returns nullopt if spilling to disk fails. Records are numbered by their index in each span.
+ */
+[[nodiscard]] std::optional<JoinResult> HashJoin(
+    std::span<const FRDMyData> left, std::span<const FRDMyData> right, RecordKey key, JoinType type,
+    std::size_t memory_budget = DEFAULT_JOIN_MEMORY_BUDGET);
+
+/// Joins standalone Miis, and Miis against the Mii of FRDMyData records, on their MiiIdentity
+[[nodiscard]] std::optional<JoinResult> HashJoin(
+    std::span<const ChecksummedMiiData> left, std::span<const ChecksummedMiiData> right,
+    JoinType type, std::size_t memory_budget = DEFAULT_JOIN_MEMORY_BUDGET);
+[[nodiscard]] std::optional<JoinResult> HashJoin(
+    std::span<const FRDMyData> left, std::span<const ChecksummedMiiData> right, JoinType type,
+    std::size_t memory_budget = DEFAULT_JOIN_MEMORY_BUDGET);
+[[nodiscard]] std::optional<JoinResult> HashJoin(
+    std::span<const ChecksummedMiiData> left, std::span<const FRDMyData> right, JoinType type,
+    std::size_t memory_budget = DEFAULT_JOIN_MEMORY_BUDGET);
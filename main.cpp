@@ -1,57 +1,32 @@
 #include "main.h"
-
-template <size_t size>
-std::string ConvertMacAddressToString(std::array<u8, size> &macAddress) {
-    std::stringstream ss;
-    ss << std::hex << std::setfill('0');
-
-    for (int i = 0; i < 6; ++i) {
-        ss << std::setw(2) << static_cast<unsigned>(macAddress[i]);
-        if (i < 5) {
-            ss << ':';
-        }
-    }
-
-    return ss.str();
-}
-
-template <size_t size>
-std::string ConvertU16ArrayToString(std::array<u16, size> u16Array) {
-    std::string result;
-    std::size_t length = 0;
-    while (u16Array[length] != 0) {
-        char lowerByte = static_cast<char>(u16Array[length] & 0xFF);
-        result += lowerByte;
-        length++;
-    }
-    return result;
-}
-
-u16 ChecksummedMiiData::CalcChecksum() {
-    // Calculate the checksum of the selected Mii, see https://www.3dbrew.org/wiki/Mii#Checksum
-    return boost::crc<16, 0x1021, 0, 0, false, false>(this, offsetof(ChecksummedMiiData, crc16));
-}
-
-int CalculateCheckDigit(const std::string& serialNumber) {
-    int oddSum = 0, evenSum = 0;
-    bool even = false;
-    for (int i = 2; i < 10; i++) {
-        if (even)
-            evenSum += serialNumber[i] - '0';
-        else
-            oddSum += serialNumber[i] - '0';
-
-        even = !even;
-    }
-
-    // Apply the formula
-    int algResult = ((3 * evenSum) + oddSum) % 10;
-
-    // Calculate the check digit
-    int checkDigit = (algResult != 0) ? (10 - algResult) : 0;
-
-    return checkDigit;
-}
+#include <atomic>
+#include <csignal>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include "alloc_hook.h"
+#include "arrow_writer.h"
+#include "batch_reader.h"
+#include "crc16.h"
+#include "directory_watcher.h"
+#include "field_access.h"
+#include "format.h"
+#include "group_by.h"
+#include "hash_join.h"
+#include "friend_code.h"
+#include "friend_graph.h"
+#include "manifest.h"
+#include "mii_database.h"
+#include "mapped_file.h"
+#include "name_index.h"
+#include "parallel.h"
+#include "record_diff.h"
+#include "record_filter.h"
+#include "record_import.h"
+#include "record_index.h"
+#include "record_stream.h"
+#include "server.h"
+#include "snapshot_store.h"
 
 void WriteMiiData(ChecksummedMiiData mii) {
     std::cout << "magic: " << static_cast<unsigned>(mii.mii_data.magic) << '\n';
@@ -155,6 +130,61 @@ void WriteMiiData(ChecksummedMiiData mii) {
     std::cout << "author_name: " << ConvertU16ArrayToString(mii.mii_data.author_name) << "\n\n" << "end of miidata" << "\n\n\n";
 }
 
+void WriteMyData(const FRDMyData& obj) {
+    // Print the data
+    std::cout << "magic: " << obj.magic << std::endl;
+
+    std::cout << "magic_number: " << obj.magic_number << std::endl;
+
+    std::cout << "padding1: " << obj.padding1 << std::endl;
+
+    std::cout << "unk10: ";
+    for (const auto& value : obj.unk10) {
+        std::cout << static_cast<unsigned>(value) << " ";
+    }
+    std::cout << std::endl;
+
+    std::cout << "comment: ";
+    for (const auto& value : obj.comment) {
+        std::string str(reinterpret_cast<const char*>(&value));
+        std::cout << str;
+    }
+    std::cout << std::endl;
+
+    std::cout << "unk50: " << obj.unk50 << std::endl;
+
+    // Print the values of the members in the FriendProfile struct
+
+    std::cout << "local_friend_code_seed: " << obj.local_friend_code_seed << std::endl;
+
+    std::cout << "unk68 (potentially password): ";
+    std::string pass = ConvertU16ArrayToString(obj.unk68);
+    std::cout << pass << std::endl;
+
+    std::cout << "serial_number: ";
+    std::string serial = ConvertU16ArrayToString(obj.serial_number);
+    std::cout << serial << CalculateCheckDigit(serial) << std::endl;
+
+    std::cout << "display_name: ";
+    std::string display_name = ConvertU16ArrayToString(obj.display_name);
+    std::cout << display_name << std::endl;
+
+    std::cout << "padding2: ";
+    for (const auto& value : obj.padding2) {
+        std::cout << static_cast<unsigned>(value) << " ";
+    }
+    std::cout << std::endl;
+
+    std::cout << "mii_data: " << std::endl; // Print the values of the members in the ChecksummedMiiData struct
+    WriteMiiData(obj.mii_data);
+
+    std::cout << "padding3: ";
+    for (const auto& value : obj.padding3) {
+        std::cout << static_cast<unsigned>(value) << " ";
+    }
+    std::cout << std::endl;
+}
+
 void MyDataTest() {
     FRDMyData obj;
 
@@ -167,65 +197,872 @@ void MyDataTest() {
         // Close the file
         std::fclose(file);
 
-        // Print the data
-        std::cout << "magic: " << obj.magic << std::endl;
+        WriteMyData(obj);
+    }
+    else {
+        std::cerr << "Failed to open file." << std::endl;
+    }
+}
+
+// Reads every file named on the command line in one batch and prints each record
+void MyDataFilesTest(std::span<const std::string> paths) {
+    const std::vector<MyDataReadResult> results = ReadMyDataFiles(paths);
+    for (std::size_t i = 0; i < results.size(); i++) {
+        std::cout << "file: " << paths[i] << std::endl;
+        if (results[i].opened) {
+            WriteMyData(results[i].data);
+        }
+        else {
+            std::cerr << "Failed to open file " << paths[i] << "." << std::endl;
+        }
+    }
+}
+
+// Prints every record of a concatenated record stream piped over stdin
+template <typename Record>
+void StreamTest(Generator<Record> records, const StreamStats& stats) {
+    for (const Record& record : records) {
+        if constexpr (std::is_same_v<Record, FRDMyData>) {
+            WriteMyData(record);
+        } else {
+            WriteMiiData(record);
+        }
+    }
+    std::cerr << "records: " << stats.records << ", skipped bytes: " << stats.skipped_bytes
+              << std::endl;
+}
+
+/**
+ * Prints one summary line per record from stdin, formatting into a per-batch arena. When built with
+ * -DFRD_COUNT_ALLOCATIONS it also reports the global heap allocations made after the first batch,
+ * which should be zero.
+ */
+void StreamSummaryTest() {
+    constexpr std::size_t BATCH_SIZE = 0x1000;
+
+    Arena arena;
+    StringInterner names(arena);
+    std::size_t batch_records = 0;
+    bool warmed_up = false;
+    u64 steady_state_allocations = GetGlobalAllocationCount();
+
+    for (const FRDMyData& obj : StreamMyData(STDIN_FILENO)) {
+        const MiiData& mii = obj.mii_data.mii_data;
+        std::cout << FormatSerialNumber(obj, arena) << ' '
+                  << ConvertMacAddressToString(mii.mac, arena) << ' '
+                  << ConvertU16ArrayToString(obj.display_name, names) << ' '
+                  << ConvertU16ArrayToString(mii.mii_name, names) << ' '
+                  << ConvertU16ArrayToString(mii.author_name, names) << '\n';
+
+        if (++batch_records == BATCH_SIZE) {
+            arena.Reset();
+            names.Reset();
+            batch_records = 0;
+            if (!warmed_up) {
+                warmed_up = true;
+                steady_state_allocations = GetGlobalAllocationCount();
+            }
+        }
+    }
+    std::cout.flush();
+
+    if (warmed_up) {
+        std::cerr << "steady state allocations: "
+                  << GetGlobalAllocationCount() - steady_state_allocations << std::endl;
+    }
+}
 
-        std::cout << "magic_number: " << obj.magic_number << std::endl;
+// Reads every FRDMyData record of a concatenated record stream
+std::vector<FRDMyData> ReadMyDataStream(int fd) {
+    std::vector<FRDMyData> records;
+    for (const FRDMyData& obj : StreamMyData(fd)) {
+        records.push_back(obj);
+    }
+    return records;
+}
 
-        std::cout << "padding1: " << obj.padding1 << std::endl;
+std::vector<FRDMyData> ReadMyDataStream(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "Failed to open file " << path << "." << std::endl;
+        return {};
+    }
+    std::vector<FRDMyData> records = ReadMyDataStream(fd);
+    close(fd);
+    return records;
+}
 
-        std::cout << "unk10: ";
-        for (const auto& value : obj.unk10) {
-            std::cout << static_cast<unsigned>(value) << " ";
+// Builds a name index over the FRDMyData records piped over stdin, numbered in stream order
+void BuildNameIndexTest(const std::string& path) {
+    const std::vector<FRDMyData> records = ReadMyDataStream(STDIN_FILENO);
+    if (!NameIndex::Build(records, path)) {
+        std::cerr << "Failed to build name index." << std::endl;
+    }
+}
+
+void FindNameTest(const std::string& path, std::string_view mode, std::string_view name) {
+    NameIndex index;
+    if (!index.Open(path)) {
+        std::cerr << "Failed to open name index." << std::endl;
+        return;
+    }
+
+    const std::u16string query = WidenName(name);
+    std::vector<NameHit> hits;
+    if (mode == "exact") {
+        hits = index.FindExact(query);
+    } else if (mode == "prefix") {
+        hits = index.FindPrefix(query);
+    } else {
+        hits = index.FindSubstring(query);
+    }
+
+    constexpr const char* field_names[] = {"display_name", "mii_name", "author_name"};
+    for (const NameHit& hit : hits) {
+        std::cout << hit.record << ' ' << field_names[static_cast<int>(hit.field)] << '\n';
+    }
+}
+
+// Prints the friend code of every principal ID given in decimal
+void FriendCodeTest(std::span<char*> args) {
+    std::vector<u32> principal_ids;
+    for (const char* arg : args) {
+        principal_ids.push_back(static_cast<u32>(std::strtoul(arg, nullptr, 10)));
+    }
+    std::vector<u64> friend_codes(principal_ids.size());
+    PrincipalIdsToFriendCodes(principal_ids, friend_codes);
+    for (std::size_t i = 0; i < principal_ids.size(); i++) {
+        std::cout << principal_ids[i] << ": " << FormatFriendCode(friend_codes[i]) << '\n';
+    }
+}
+
+// Prints the fields that changed between two record streams, then how often each field changed
+void DiffTest(const std::string& before_path, const std::string& after_path) {
+    const std::vector<FRDMyData> before = ReadMyDataStream(before_path);
+    const std::vector<FRDMyData> after = ReadMyDataStream(after_path);
+    const DiffResult diff = DiffRecords(before, after);
+
+    const auto field_name = [](u16 field) {
+        return field == DiffResult::UNNAMED_FIELD ? std::string_view("(unnamed bits)")
+                                                  : FRD_MY_DATA_FIELDS[field].name;
+    };
+    for (const FieldChange& change : diff.changes) {
+        std::cout << change.record << ' ' << field_name(change.field);
+        if (change.field != DiffResult::UNNAMED_FIELD) {
+            const FieldInfo& field = FRD_MY_DATA_FIELDS[change.field];
+            if (field.type == FieldType::Unsigned || field.type == FieldType::BitField) {
+                std::cout << ": " << ReadFieldValue(reinterpret_cast<const u8*>(&before[change.record]), field)
+                          << " -> " << ReadFieldValue(reinterpret_cast<const u8*>(&after[change.record]), field);
+            }
         }
-        std::cout << std::endl;
+        std::cout << '\n';
+    }
 
-        std::cout << "comment: ";
-        for (const auto& value : obj.comment) {
-            std::string str(reinterpret_cast<const char*>(&value));
-            std::cout << str;
+    std::cout << "\nchanged records: " << diff.changed_records << '\n';
+    for (std::size_t i = 0; i < diff.histogram.size(); i++) {
+        if (diff.histogram[i] != 0) {
+            const u16 field = i < FRD_MY_DATA_FIELDS.size() ? static_cast<u16>(i) : DiffResult::UNNAMED_FIELD;
+            std::cout << field_name(field) << ": " << diff.histogram[i] << '\n';
         }
-        std::cout << std::endl;
+    }
+}
 
-        std::cout << "unk50: " << obj.unk50 << std::endl;
+// Processes only the files whose identity changed since the manifest was last updated
+void IncrementalTest(const std::string& manifest_path, std::span<const std::string> paths) {
+    Manifest manifest;
+    if (!manifest.Open(manifest_path, std::max(Manifest::DEFAULT_CAPACITY, paths.size() * 2))) {
+        std::cerr << "Failed to open manifest." << std::endl;
+        return;
+    }
 
-        // Print the values of the members in the FriendProfile struct
+    std::vector<std::string> changed_paths;
+    std::vector<FileIdentity> changed_identities;
+    for (const std::string& path : paths) {
+        const std::optional<FileIdentity> identity = FileIdentity::Of(path);
+        if (!identity) {
+            manifest.Invalidate(path);
+            std::cerr << "Failed to open file " << path << "." << std::endl;
+            continue;
+        }
+        if (const std::optional<ManifestEntry> entry = manifest.Lookup(path, *identity)) {
+            std::cout << path << ": unchanged, crc16 " << entry->crc16 << ", checksum valid "
+                      << entry->result << '\n';
+            continue;
+        }
+        changed_paths.push_back(path);
+        changed_identities.push_back(*identity);
+    }
 
-        std::cout << "local_friend_code_seed: " << obj.local_friend_code_seed << std::endl;
+    std::vector<MyDataReadResult> results = ReadMyDataFiles(changed_paths);
+    std::atomic<u64> manifest_full = 0; ///< Results the manifest had no room to record
+    ParallelFor(results.size(), [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            if (!results[i].opened) {
+                manifest.Invalidate(changed_paths[i]);
+                continue;
+            }
+            FRDMyData& obj = results[i].data;
+            ManifestEntry entry;
+            entry.identity = changed_identities[i];
+            entry.content_hash = ContentHash({reinterpret_cast<const u8*>(&obj), sizeof(obj)});
+            entry.crc16 = obj.mii_data.crc16;
+            entry.result = obj.mii_data.IsChecksumValid();
+            if (!manifest.Update(changed_paths[i], entry)) {
+                manifest_full.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }, 0x100);
 
-        std::cout << "unk68 (potentially password): ";
-        std::string pass = ConvertU16ArrayToString(obj.unk68);
-        std::cout << pass << std::endl;
+    for (std::size_t i = 0; i < results.size(); i++) {
+        if (results[i].opened) {
+            std::cout << changed_paths[i] << ": processed, crc16 "
+                      << static_cast<u16>(results[i].data.mii_data.crc16)
+                      << '\n';
+        }
+        else {
+            std::cerr << "Failed to open file " << changed_paths[i] << "." << std::endl;
+        }
+    }
+    if (manifest_full != 0) {
+        std::cerr << "manifest full: " << manifest_full << " results not recorded" << std::endl;
+    }
+    manifest.Sync();
+}
 
-        std::cout << "serial_number: ";
-        std::string serial = ConvertU16ArrayToString(obj.serial_number);
-        std::cout << serial << CalculateCheckDigit(serial) << std::endl;
+// Prints the CRC16 of each whole file, computed across all worker threads
+void Crc16Test(std::span<char*> paths) {
+    for (const char* path : paths) {
+        MappedFile file;
+        if (!file.Open(path)) {
+            std::cerr << "Failed to open file " << path << "." << std::endl;
+            continue;
+        }
+        std::cout << path << ": " << std::hex << std::setw(4) << std::setfill('0')
+                  << Crc16(std::as_bytes(file.Bytes())) << std::dec << '\n';
+    }
+}
 
-        std::cout << "display_name: ";
-        std::string display_name = ConvertU16ArrayToString(obj.display_name);
-        std::cout << display_name << std::endl;
+// Prints the stream order index of every record piped over stdin that matches expression
+void FilterTest(std::string_view expression) {
+    std::string error;
+    const std::optional<RecordFilter> filter = RecordFilter::Compile<FRDMyData>(expression, &error);
+    if (!filter) {
+        std::cerr << "Invalid filter: " << error << "." << std::endl;
+        return;
+    }
 
-        std::cout << "padding2: ";
-        for (const auto& value : obj.padding2) {
-            std::cout << static_cast<unsigned>(value) << " ";
+    const std::vector<FRDMyData> records = ReadMyDataStream(STDIN_FILENO);
+    const std::vector<u64> selected = filter->Select(std::span<const FRDMyData>(records));
+    for (std::size_t word = 0; word < selected.size(); word++) {
+        for (u64 bits = selected[word]; bits != 0; bits &= bits - 1) {
+            std::cout << word * 64 + std::countr_zero(bits) << '\n';
         }
-        std::cout << std::endl;
+    }
+    std::cout << "matched: " << CountSelected(selected) << std::endl;
+}
+
+// Prints count, and min, max and distinct count of value_field, per group of the records on stdin
+void GroupByTest(std::string_view group_list, std::string_view value_field) {
+    std::vector<std::string_view> group_by;
+    for (std::size_t start = 0; start <= group_list.size();) {
+        const std::size_t end = std::min(group_list.find(',', start), group_list.size());
+        group_by.push_back(group_list.substr(start, end - start));
+        start = end + 1;
+    }
 
-        std::cout << "mii_data: " << std::endl; // Print the values of the members in the ChecksummedMiiData struct
-        WriteMiiData(obj.mii_data);
+    const std::vector<FRDMyData> records = ReadMyDataStream(STDIN_FILENO);
+    std::string error;
+    const std::optional<GroupByResult> result =
+        GroupBy(std::span<const FRDMyData>(records), group_by, value_field, &error);
+    if (!result) {
+        std::cerr << "Invalid group by: " << error << "." << std::endl;
+        return;
+    }
 
-        std::cout << "padding3: ";
-        for (const auto& value : obj.padding3) {
-            std::cout << static_cast<unsigned>(value) << " ";
+    for (const std::size_t field : result->group_fields) {
+        std::cout << FRD_MY_DATA_FIELDS[field].name << ' ';
+    }
+    std::cout << "count";
+    if (result->value_field) {
+        const std::string_view name = FRD_MY_DATA_FIELDS[*result->value_field].name;
+        std::cout << " min(" << name << ") max(" << name << ") distinct(" << name << ')';
+    }
+    std::cout << '\n';
+    for (const GroupStats& group : result->groups) {
+        for (std::size_t i = 0; i < result->group_fields.size(); i++) {
+            std::cout << group.key[i] << ' ';
+        }
+        std::cout << group.count;
+        if (result->value_field) {
+            std::cout << ' ' << group.min << ' ' << group.max << ' ' << group.distinct;
         }
-        std::cout << std::endl;
+        std::cout << '\n';
     }
-    else {
-        std::cerr << "Failed to open file." << std::endl;
+}
+
+// Serves the records of a stream file until interrupted; address is a Unix socket path or TCP port
+void ServeTest(const std::string& path, const std::string& address) {
+    const std::vector<FRDMyData> records = ReadMyDataStream(path);
+
+    // Block the stop signals before the shards start so that only sigwait below receives them
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    RecordServer server;
+    const bool is_port = !address.empty() &&
+                         std::all_of(address.begin(), address.end(), [](char c) { return std::isdigit(c); });
+    if (!server.Load(records)) {
+        std::cerr << "Failed to index records." << std::endl;
+        return;
+    }
+    if (!(is_port ? server.ListenTcp(static_cast<u16>(std::stoul(address)))
+                  : server.ListenUnix(address)) ||
+        !server.Start()) {
+        std::cerr << "Failed to listen on " << address << "." << std::endl;
+        return;
+    }
+    std::cerr << "serving " << records.size() << " records on " << address << std::endl;
+
+    int signal;
+    sigwait(&signals, &signal);
+    server.Stop();
+}
+
+// Builds a record index over the FRDMyData records piped over stdin, numbered in stream order
+void BuildRecordIndexTest(std::string_view kind, const std::string& path) {
+    RecordKey key;
+    if (kind == "mii") {
+        key = RecordKey::MiiIdentity;
+    } else if (kind == "serial") {
+        key = RecordKey::SerialNumber;
+    } else if (kind == "seed") {
+        key = RecordKey::FriendCodeSeed;
+    } else {
+        std::cerr << "Unknown key " << kind << ", expected mii, serial or seed." << std::endl;
+        return;
+    }
+    const std::vector<FRDMyData> records = ReadMyDataStream(STDIN_FILENO);
+    if (!RecordIndex::Build(records, key, path)) {
+        std::cerr << "Failed to build record index." << std::endl;
+    }
+}
+
+// Prints the records matching a key: "<system_id> <mii_id>", "<serial>" or "<seed>" by index kind
+void FindRecordTest(const std::string& path, std::span<char*> key) {
+    RecordIndex index;
+    if (!index.Open(path)) {
+        std::cerr << "Failed to open record index." << std::endl;
+        return;
+    }
+
+    std::vector<u32> records;
+    switch (index.Key()) {
+    case RecordKey::MiiIdentity:
+        if (key.size() > 1) {
+            records = index.FindMiiIdentity(std::strtoull(key[0], nullptr, 0),
+                                            static_cast<u32>(std::strtoul(key[1], nullptr, 0)));
+        }
+        break;
+    case RecordKey::SerialNumber:
+        records = index.FindSerialNumber(key[0]);
+        break;
+    case RecordKey::FriendCodeSeed:
+        records = index.FindFriendCodeSeed(std::strtoull(key[0], nullptr, 0));
+        break;
+    }
+    for (const u32 record : records) {
+        std::cout << record << '\n';
+    }
+}
+
+// Joins two FRDMyData record streams and prints "<left> <right>" pairs or left record numbers
+void JoinTest(std::string_view type_name, std::string_view kind, const std::string& left_path,
+              const std::string& right_path, const char* budget_mib) {
+    JoinType type;
+    if (type_name == "inner") {
+        type = JoinType::Inner;
+    } else if (type_name == "semi") {
+        type = JoinType::Semi;
+    } else if (type_name == "anti") {
+        type = JoinType::Anti;
+    } else {
+        std::cerr << "Unknown join " << type_name << ", expected inner, semi or anti." << std::endl;
+        return;
+    }
+    RecordKey key;
+    if (kind == "mii") {
+        key = RecordKey::MiiIdentity;
+    } else if (kind == "serial") {
+        key = RecordKey::SerialNumber;
+    } else if (kind == "seed") {
+        key = RecordKey::FriendCodeSeed;
+    } else {
+        std::cerr << "Unknown key " << kind << ", expected mii, serial or seed." << std::endl;
+        return;
+    }
+
+    const std::vector<FRDMyData> left = ReadMyDataStream(left_path);
+    const std::vector<FRDMyData> right = ReadMyDataStream(right_path);
+    const std::size_t budget =
+        budget_mib ? std::strtoull(budget_mib, nullptr, 0) << 20 : DEFAULT_JOIN_MEMORY_BUDGET;
+    const std::optional<JoinResult> result = HashJoin(left, right, key, type, budget);
+    if (!result) {
+        std::cerr << "Failed to spill join partitions." << std::endl;
+        return;
+    }
+    for (const auto& [left_record, right_record] : result->pairs) {
+        std::cout << left_record << ' ' << right_record << '\n';
+    }
+    for (const u32 record : result->records) {
+        std::cout << record << '\n';
+    }
+    std::cerr << (type == JoinType::Inner ? result->pairs.size() : result->records.size())
+              << " rows" << std::endl;
+}
+
+// Builds a friend graph from stdin lines "<owner principal id> <friend principal id>...", taking
+// each line's number as its owner's record
+void BuildFriendGraphTest(const std::string& path) {
+    std::vector<std::vector<FriendKey>> friends;
+    std::vector<FriendList> lists;
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        std::istringstream fields(line);
+        u32 owner;
+        if (!(fields >> owner)) {
+            continue;
+        }
+        std::vector<FriendKey>& keys = friends.emplace_back();
+        for (u32 principal_id; fields >> principal_id;) {
+            keys.emplace_back().principal_id = principal_id;
+        }
+        lists.push_back({owner, static_cast<u32>(lists.size()), {}});
+    }
+    for (std::size_t i = 0; i < lists.size(); i++) {
+        lists[i].friends = friends[i];
+    }
+    if (!FriendGraph::Build(lists, path)) {
+        std::cerr << "Failed to build friend graph." << std::endl;
+    }
+}
+
+// Prints degree statistics, "components", or the vertices per hop of "bfs <principal id>"
+void FriendGraphTest(const std::string& path, std::span<char*> args) {
+    FriendGraph graph;
+    if (!graph.Open(path)) {
+        std::cerr << "Failed to open friend graph." << std::endl;
+        return;
+    }
+    const std::string_view mode = args.empty() ? "" : args[0];
+    if (mode == "bfs" && args.size() > 1) {
+        const std::optional<u32> source =
+            graph.FindVertex(static_cast<u32>(std::strtoul(args[1], nullptr, 0)));
+        if (!source) {
+            std::cerr << "Unknown principal ID " << args[1] << "." << std::endl;
+            return;
+        }
+        std::vector<u64> per_hop;
+        for (const u32 depth : graph.Bfs(*source)) {
+            if (depth != FriendGraph::UNREACHED) {
+                per_hop.resize(std::max<std::size_t>(per_hop.size(), depth + 1));
+                per_hop[depth]++;
+            }
+        }
+        for (std::size_t hop = 0; hop < per_hop.size(); hop++) {
+            std::cout << hop << ' ' << per_hop[hop] << '\n';
+        }
+    } else if (mode == "components") {
+        std::vector<u64> sizes(graph.VertexCount());
+        for (const u32 label : graph.ConnectedComponents()) {
+            sizes[label]++;
+        }
+        std::erase(sizes, 0);
+        const u64 largest = sizes.empty() ? 0 : *std::max_element(sizes.begin(), sizes.end());
+        std::cout << "components: " << sizes.size() << '\n' << "largest: " << largest << '\n';
+    } else {
+        const DegreeStats stats = graph.Degrees();
+        std::cout << "vertices: " << stats.vertex_count << '\n'
+                  << "edges: " << stats.edge_count << '\n'
+                  << "degree: min " << stats.min_degree << ", max " << stats.max_degree << ", mean "
+                  << stats.mean_degree << '\n'
+                  << "isolated: " << stats.isolated << '\n';
+        for (std::size_t i = 0; i < stats.histogram.size(); i++) {
+            if (stats.histogram[i] != 0) {
+                std::cout << "degree < " << (u64{1} << i) << ": " << stats.histogram[i] << '\n';
+            }
+        }
+    }
+}
+
+// Prints the fields in the comma separated path_list of every record on stdin, tab separated
+void GetFieldsTest(std::string_view path_list) {
+    std::vector<FieldAccessor> accessors;
+    for (std::size_t start = 0; start <= path_list.size();) {
+        const std::size_t end = std::min(path_list.find(',', start), path_list.size());
+        const std::string_view path = path_list.substr(start, end - start);
+        const std::optional<FieldAccessor> accessor = FindFieldAccessor<FRDMyData>(path);
+        if (!accessor) {
+            std::cerr << "Unknown or ambiguous field " << path << "." << std::endl;
+            return;
+        }
+        accessors.push_back(*accessor);
+        start = end + 1;
+    }
+
+    for (std::size_t i = 0; i < accessors.size(); i++) {
+        std::cout << (i == 0 ? "" : "\t") << accessors[i].field->name;
+    }
+    std::cout << '\n';
+    for (const FRDMyData& obj : StreamMyData(STDIN_FILENO)) {
+        for (std::size_t i = 0; i < accessors.size(); i++) {
+            std::cout << (i == 0 ? "" : "\t");
+            PrintField(std::cout, reinterpret_cast<const u8*>(&obj), accessors[i]);
+        }
+        std::cout << '\n';
+    }
+}
+
+// Applies the "path=value" assignments to every record on stdin and writes the records to stdout.
+// The Mii checksum is refreshed unless it is assigned itself.
+void SetFieldsTest(std::span<char*> assignments) {
+    std::vector<std::pair<FieldAccessor, std::string_view>> updates;
+    bool sets_crc16 = false;
+    for (const std::string_view assignment : assignments) {
+        const std::size_t equals = assignment.find('=');
+        const std::string_view path = assignment.substr(0, equals);
+        const std::optional<FieldAccessor> accessor = FindFieldAccessor<FRDMyData>(path);
+        if (equals == std::string_view::npos || !accessor) {
+            std::cerr << "Expected path=value with a known field, got " << assignment << "."
+                      << std::endl;
+            return;
+        }
+        updates.emplace_back(*accessor, assignment.substr(equals + 1));
+        sets_crc16 |= accessor->field->name == "mii_data.crc16";
+    }
+
+    for (FRDMyData obj : StreamMyData(STDIN_FILENO)) {
+        for (const auto& [accessor, value] : updates) {
+            std::string error;
+            if (!ParseField(reinterpret_cast<u8*>(&obj), accessor, value, &error)) {
+                std::cerr << "Invalid value: " << error << "." << std::endl;
+                return;
+            }
+        }
+        if (!sets_crc16) {
+            obj.mii_data.crc16 = obj.mii_data.CalcChecksum();
+        }
+        std::cout.write(reinterpret_cast<const char*>(&obj), sizeof(obj));
+    }
+}
+
+// Imports "ndjson" or "csv" text from path as FRDMyData records, or as Miis if mii is given, and
+// writes them packed to stdout
+void ImportTest(std::string_view format_name, const std::string& path, bool mii) {
+    if (format_name != "ndjson" && format_name != "csv") {
+        std::cerr << "Unknown import format " << format_name << "." << std::endl;
+        return;
+    }
+    const ImportFormat format = format_name == "ndjson" ? ImportFormat::Ndjson : ImportFormat::Csv;
+    MappedFile file;
+    if (!file.Open(path)) {
+        std::cerr << "Failed to open file " << path << "." << std::endl;
+        return;
+    }
+    const std::span<const char> text(reinterpret_cast<const char*>(file.Bytes().data()),
+                                     file.Bytes().size());
+    std::string error;
+    const std::optional<ImportResult> result =
+        mii ? ImportRecords<ChecksummedMiiData>(text, format, &error)
+            : ImportRecords<FRDMyData>(text, format, &error);
+    if (!result) {
+        std::cerr << "Invalid import: " << error << "." << std::endl;
+        return;
+    }
+    std::cout.write(reinterpret_cast<const char*>(result->records.data()),
+                    static_cast<std::streamsize>(result->records.size()));
+    std::cerr << "imported: " << result->record_count << ", rejected: " << result->rejected << '\n';
+    if (!result->first_error.empty()) {
+        std::cerr << "first error: " << result->first_error << '\n';
+    }
+}
+
+// Validates Mii Maker databases, printing the entry count, invalid entries and file CRC of each
+void MiiDatabaseTest(std::span<char*> args) {
+    const std::vector<std::string> paths(args.begin(), args.end());
+    const std::vector<MiiDatabaseReport> reports = ValidateMiiDatabases(paths);
+    for (std::size_t i = 0; i < paths.size(); i++) {
+        if (!reports[i].opened) {
+            std::cerr << "Failed to open database " << paths[i] << "." << std::endl;
+            continue;
+        }
+        std::cout << paths[i] << ": entries " << reports[i].entries << ", invalid entries "
+                  << reports[i].invalid_entries << ", checksum valid " << reports[i].checksum_valid
+                  << '\n';
     }
 }
 
-int main() {
+// Without a mode, prints the size of the snapshot log at path. "append" adds the FRDMyData records
+// on stdin as the next versions of their consoles, keyed by local friend code seed, "get <console>
+// <version>" writes one version to stdout and "compact <out> [interval]" rewrites the log.
+void SnapshotTest(const std::string& path, std::span<char*> args) {
+    const std::string_view mode = args.empty() ? "" : args[0];
+    if (mode == "append") {
+        SnapshotWriter writer;
+        if (!writer.Open(path)) {
+            std::cerr << "Failed to open snapshot log." << std::endl;
+            return;
+        }
+        u64 appended = 0;
+        for (const FRDMyData& obj : StreamMyData(STDIN_FILENO)) {
+            if (!writer.Append(obj.local_friend_code_seed, obj)) {
+                break;
+            }
+            appended++;
+        }
+        if (!writer.Close()) {
+            std::cerr << "Failed to write snapshot log." << std::endl;
+        }
+        std::cerr << "appended: " << appended << ", bytes: " << writer.BytesWritten() << ", raw bytes: "
+                  << appended * sizeof(FRDMyData) << '\n';
+        return;
+    }
+    if (mode == "compact" && args.size() > 1) {
+        const u32 interval = args.size() > 2 ? static_cast<u32>(std::strtoul(args[2], nullptr, 0))
+                                             : DEFAULT_KEYFRAME_INTERVAL;
+        if (!SnapshotStore::Compact(path, args[1], interval)) {
+            std::cerr << "Failed to compact snapshot log." << std::endl;
+        }
+        return;
+    }
+
+    SnapshotStore store;
+    if (!store.Open(path)) {
+        std::cerr << "Failed to open snapshot log." << std::endl;
+        return;
+    }
+    if (mode == "get" && args.size() > 2) {
+        const std::optional<FRDMyData> snapshot =
+            store.Get(std::strtoull(args[1], nullptr, 0),
+                      static_cast<u32>(std::strtoul(args[2], nullptr, 0)));
+        if (!snapshot) {
+            std::cerr << "No snapshot " << args[1] << " version " << args[2] << "." << std::endl;
+            return;
+        }
+        std::cout.write(reinterpret_cast<const char*>(&*snapshot), sizeof(*snapshot));
+    } else {
+        std::cout << "consoles: " << store.Consoles().size() << '\n'
+                  << "snapshots: " << store.EntryCount() << '\n'
+                  << "keyframes: " << store.KeyframeCount() << '\n'
+                  << "bytes: " << store.ValidSize() << '\n'
+                  << "raw bytes: " << store.EntryCount() * sizeof(FRDMyData) << '\n';
+    }
+}
+
+// Writes the FRDMyData records on stdin to path as an Arrow IPC file, in batches of ARROW_BATCH_ROWS
+void ArrowTest(const std::string& path) {
+    ArrowWriter writer(FieldAccessorsOf<FRDMyData>(), sizeof(FRDMyData));
+    if (!writer.Open(path)) {
+        std::cerr << "Failed to create Arrow file." << std::endl;
+        return;
+    }
+    std::vector<FRDMyData> batch;
+    batch.reserve(ARROW_BATCH_ROWS);
+    u64 rows = 0;
+    const auto flush = [&] {
+        rows += batch.size();
+        const bool written = writer.WriteBatch(
+            {reinterpret_cast<const u8*>(batch.data()), batch.size() * sizeof(FRDMyData)});
+        batch.clear();
+        return written;
+    };
+    bool written = true;
+    for (const FRDMyData& obj : StreamMyData(STDIN_FILENO)) {
+        batch.push_back(obj);
+        if (batch.size() == ARROW_BATCH_ROWS && !(written = flush())) {
+            break;
+        }
+    }
+    if (!written || !flush() || !writer.Close()) {
+        std::cerr << "Failed to write Arrow file." << std::endl;
+        return;
+    }
+    std::cerr << "rows: " << rows << '\n';
+}
+
+// Watches directories for FRDMyData files until interrupted, printing one line per file like
+// IncrementalTest plus its latency, then the watcher statistics
+void WatchTest(const std::string& manifest_path, std::span<char*> directories) {
+    // Block the stop signals before the watcher threads start so that only sigwait receives them
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    // Room for the files already there to be rewritten under new names a few times over; the
+    // manifest is rehashed when it is next opened if it fills up anyway
+    std::size_t existing = 0;
+    for (const char* directory : directories) {
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+            existing += entry.is_regular_file(ec);
+        }
+    }
+    Manifest manifest;
+    if (!manifest.Open(manifest_path, std::max(Manifest::DEFAULT_CAPACITY, existing * 4))) {
+        std::cerr << "Failed to open manifest." << std::endl;
+        return;
+    }
+    DirectoryWatcher watcher;
+    for (const char* directory : directories) {
+        if (!watcher.Watch(directory)) {
+            std::cerr << "Failed to watch directory " << directory << "." << std::endl;
+            return;
+        }
+    }
+    std::mutex output_mutex;
+    const bool started = watcher.Start(
+        [&](const WatchResult& result) {
+            std::lock_guard lock(output_mutex);
+            if (!result.opened) {
+                std::cerr << "Failed to open file " << result.path << "." << std::endl;
+                return;
+            }
+            std::cout << result.path << (result.changed ? ": processed" : ": unchanged")
+                      << ", crc16 " << result.crc16 << ", checksum valid " << result.checksum_valid
+                      << ", latency " << result.latency_us << "us" << std::endl;
+        },
+        &manifest);
+    if (!started) {
+        std::cerr << "Failed to start watcher." << std::endl;
+        return;
+    }
+
+    int signal;
+    sigwait(&signals, &signal);
+    watcher.Stop();
+    manifest.Sync();
+
+    const WatchStats stats = watcher.Stats();
+    std::cerr << "events: " << stats.events << ", processed: " << stats.processed
+              << ", unchanged: " << stats.unchanged << ", failed: " << stats.failed << '\n'
+              << "coalesced: " << stats.coalesced << ", stalls: " << stats.stalls
+              << ", overflows: " << stats.overflows << ", max queue depth: "
+              << stats.max_queue_depth << ", manifest full: " << stats.manifest_full << '\n'
+              << "latency: p50 < " << stats.latency_p50_us << "us, p99 < " << stats.latency_p99_us
+              << "us, max " << stats.latency_max_us << "us, mean " << stats.latency_mean_us << "us"
+              << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 3 && std::string_view(argv[1]) == "--watch") {
+        WatchTest(argv[2], {argv + 3, argv + argc});
+        return 0;
+    }
+    if (argc > 2 && std::string_view(argv[1]) == "--arrow") {
+        ArrowTest(argv[2]);
+        return 0;
+    }
+    if (argc > 2 && std::string_view(argv[1]) == "--snapshots") {
+        SnapshotTest(argv[2], {argv + 3, argv + argc});
+        return 0;
+    }
+    if (argc > 2 && std::string_view(argv[1]) == "--mii-db") {
+        MiiDatabaseTest({argv + 2, argv + argc});
+        return 0;
+    }
+    if (argc > 3 && std::string_view(argv[1]) == "--import") {
+        ImportTest(argv[2], argv[3], argc > 4 && std::string_view(argv[4]) == "mii");
+        return 0;
+    }
+    if (argc > 2 && std::string_view(argv[1]) == "--get") {
+        GetFieldsTest(argv[2]);
+        return 0;
+    }
+    if (argc > 1 && std::string_view(argv[1]) == "--set") {
+        SetFieldsTest({argv + 2, argv + argc});
+        return 0;
+    }
+    if (argc > 2 && std::string_view(argv[1]) == "--build-friend-graph") {
+        BuildFriendGraphTest(argv[2]);
+        return 0;
+    }
+    if (argc > 2 && std::string_view(argv[1]) == "--friend-graph") {
+        FriendGraphTest(argv[2], {argv + 3, argv + argc});
+        return 0;
+    }
+    if (argc > 5 && std::string_view(argv[1]) == "--join") {
+        JoinTest(argv[2], argv[3], argv[4], argv[5], argc > 6 ? argv[6] : nullptr);
+        return 0;
+    }
+    if (argc > 3 && std::string_view(argv[1]) == "--build-record-index") {
+        BuildRecordIndexTest(argv[2], argv[3]);
+        return 0;
+    }
+    if (argc > 3 && std::string_view(argv[1]) == "--find-record") {
+        FindRecordTest(argv[2], {argv + 3, argv + argc});
+        return 0;
+    }
+    if (argc > 3 && std::string_view(argv[1]) == "--serve") {
+        ServeTest(argv[2], argv[3]);
+        return 0;
+    }
+    if (argc > 2 && std::string_view(argv[1]) == "--group-by") {
+        GroupByTest(argv[2], argc > 3 ? argv[3] : "");
+        return 0;
+    }
+    if (argc > 2 && std::string_view(argv[1]) == "--filter") {
+        FilterTest(argv[2]);
+        return 0;
+    }
+    if (argc > 1 && std::string_view(argv[1]) == "--crc16") {
+        Crc16Test({argv + 2, argv + argc});
+        return 0;
+    }
+    if (argc > 2 && std::string_view(argv[1]) == "--incremental") {
+        const std::vector<std::string> paths(argv + 3, argv + argc);
+        IncrementalTest(argv[2], paths);
+        return 0;
+    }
+    if (argc > 3 && std::string_view(argv[1]) == "--diff") {
+        DiffTest(argv[2], argv[3]);
+        return 0;
+    }
+    if (argc > 1 && std::string_view(argv[1]) == "--friend-code") {
+        FriendCodeTest({argv + 2, argv + argc});
+        return 0;
+    }
+    if (argc > 2 && std::string_view(argv[1]) == "--build-name-index") {
+        BuildNameIndexTest(argv[2]);
+        return 0;
+    }
+    if (argc > 4 && std::string_view(argv[1]) == "--find-name") {
+        FindNameTest(argv[2], argv[3], argv[4]);
+        return 0;
+    }
+    if (argc > 1 && std::string_view(argv[1]) == "--stream-summary") {
+        StreamSummaryTest();
+        return 0;
+    }
+    if (argc > 1 && std::string_view(argv[1]) == "--stream") {
+        StreamStats stats;
+        StreamTest(StreamMyData(STDIN_FILENO, DEFAULT_STREAM_BUFFER_SIZE, &stats), stats);
+        return 0;
+    }
+    if (argc > 1 && std::string_view(argv[1]) == "--stream-mii") {
+        StreamStats stats;
+        StreamTest(StreamMiiData(STDIN_FILENO, DEFAULT_STREAM_BUFFER_SIZE, &stats), stats);
+        return 0;
+    }
+
+    if (argc > 1) {
+        const std::vector<std::string> paths(argv + 1, argv + argc);
+        MyDataFilesTest(paths);
+        return 0;
+    }
 
     MyDataTest();
     return 0;
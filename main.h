@@ -1,9 +1,14 @@
+#pragma once
+
 #include <iostream>
 #include <fstream>
-#include <boost/crc.hpp>
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/binary_iarchive.hpp>
 #include "bit_field.h"
+#include "crc16.h"
+#include <algorithm>
+#include <bit>
+#include <cstddef>
 #include <iomanip>
 #include <sstream>
 #include <string>
@@ -236,31 +241,133 @@ private:
 
 static_assert(sizeof(MiiData) == 0x5C, "MiiData structure has incorrect size");
 
+// Field lists for MiiData, used to generate mirror types and field tables from the layout above.
+// Every member of MiiData must appear in exactly one of the scalar, array or union lists.
+
+/// Plain scalar members: X(name)
+#define MII_DATA_SCALARS(X)                                                                        \
+    X(magic)                                                                                       \
+    X(system_id)                                                                                   \
+    X(mii_id)                                                                                      \
+    X(pad)                                                                                         \
+    X(height)                                                                                      \
+    X(width)                                                                                       \
+    X(hair_style)
+
+/// Array members: X(name)
+#define MII_DATA_ARRAYS(X)                                                                         \
+    X(mac)                                                                                         \
+    X(mii_name)                                                                                    \
+    X(author_name)
+
+/// BitField unions: X(name)
+#define MII_DATA_UNIONS(X)                                                                         \
+    X(mii_options)                                                                                 \
+    X(mii_pos)                                                                                     \
+    X(console_identity)                                                                            \
+    X(mii_details)                                                                                 \
+    X(face_style)                                                                                  \
+    X(face_details)                                                                                \
+    X(hair_details)                                                                                \
+    X(eye_details)                                                                                 \
+    X(eyebrow_details)                                                                             \
+    X(nose_details)                                                                                \
+    X(mouth_details)                                                                               \
+    X(mustache_details)                                                                            \
+    X(beard_details)                                                                               \
+    X(glasses_details)                                                                             \
+    X(mole_details)
+
+/// BitFields within the unions: X(union, field)
+#define MII_DATA_BITFIELDS(X)                                                                      \
+    X(mii_options, allow_copying)                                                                  \
+    X(mii_options, is_private_name)                                                                \
+    X(mii_options, region_lock)                                                                    \
+    X(mii_options, char_set)                                                                       \
+    X(mii_pos, page_index)                                                                         \
+    X(mii_pos, slot_index)                                                                         \
+    X(console_identity, unknown0)                                                                  \
+    X(console_identity, origin_console)                                                            \
+    X(mii_details, sex)                                                                            \
+    X(mii_details, bday_month)                                                                     \
+    X(mii_details, bday_day)                                                                       \
+    X(mii_details, shirt_color)                                                                    \
+    X(mii_details, favorite)                                                                       \
+    X(face_style, disable_sharing)                                                                 \
+    X(face_style, shape)                                                                           \
+    X(face_style, skin_color)                                                                      \
+    X(face_details, wrinkles)                                                                      \
+    X(face_details, makeup)                                                                        \
+    X(hair_details, color)                                                                         \
+    X(hair_details, flip)                                                                          \
+    X(eye_details, style)                                                                          \
+    X(eye_details, color)                                                                          \
+    X(eye_details, scale)                                                                          \
+    X(eye_details, yscale)                                                                         \
+    X(eye_details, rotation)                                                                       \
+    X(eye_details, xspacing)                                                                       \
+    X(eye_details, yposition)                                                                      \
+    X(eyebrow_details, style)                                                                      \
+    X(eyebrow_details, color)                                                                      \
+    X(eyebrow_details, scale)                                                                      \
+    X(eyebrow_details, yscale)                                                                     \
+    X(eyebrow_details, pad)                                                                        \
+    X(eyebrow_details, rotation)                                                                   \
+    X(eyebrow_details, xspacing)                                                                   \
+    X(eyebrow_details, yposition)                                                                  \
+    X(nose_details, style)                                                                         \
+    X(nose_details, scale)                                                                         \
+    X(nose_details, yposition)                                                                     \
+    X(mouth_details, style)                                                                        \
+    X(mouth_details, color)                                                                        \
+    X(mouth_details, scale)                                                                        \
+    X(mouth_details, yscale)                                                                       \
+    X(mustache_details, mouth_yposition)                                                           \
+    X(mustache_details, mustach_style)                                                             \
+    X(mustache_details, pad)                                                                       \
+    X(beard_details, style)                                                                        \
+    X(beard_details, color)                                                                        \
+    X(beard_details, scale)                                                                        \
+    X(beard_details, ypos)                                                                         \
+    X(glasses_details, style)                                                                      \
+    X(glasses_details, color)                                                                      \
+    X(glasses_details, scale)                                                                      \
+    X(glasses_details, ypos)                                                                       \
+    X(mole_details, enable)                                                                        \
+    X(mole_details, scale)                                                                         \
+    X(mole_details, xpos)                                                                          \
+    X(mole_details, ypos)
+
+#define MII_DATA_MEMBER_SIZE(name) +sizeof(MiiData::name)
+static_assert(0 MII_DATA_SCALARS(MII_DATA_MEMBER_SIZE) MII_DATA_ARRAYS(MII_DATA_MEMBER_SIZE)
+                      MII_DATA_UNIONS(MII_DATA_MEMBER_SIZE) == sizeof(MiiData),
+              "MiiData field lists are out of sync with the structure");
+#undef MII_DATA_MEMBER_SIZE
+
 class ChecksummedMiiData {
 public:
-    ChecksummedMiiData() {
-        FixChecksum();
-    }
-    ChecksummedMiiData(const ChecksummedMiiData& data) = default;
-    ChecksummedMiiData(ChecksummedMiiData&& data) = default;
-    ChecksummedMiiData& operator=(const ChecksummedMiiData&) = default;
-    ChecksummedMiiData& operator=(ChecksummedMiiData&&) = default;
-
-    ChecksummedMiiData(const MiiData& data) : mii_data(data) {
+    // All-zero data checksums to zero, so the default record needs no CRC pass
+    constexpr ChecksummedMiiData() = default;
+    constexpr ChecksummedMiiData(const ChecksummedMiiData& data) = default;
+    constexpr ChecksummedMiiData(ChecksummedMiiData&& data) = default;
+    constexpr ChecksummedMiiData& operator=(const ChecksummedMiiData&) = default;
+    constexpr ChecksummedMiiData& operator=(ChecksummedMiiData&&) = default;
+
+    constexpr ChecksummedMiiData(const MiiData& data) : mii_data(data) {
         FixChecksum();
     }
 
-    ChecksummedMiiData(MiiData&& data) : mii_data(data) {
+    constexpr ChecksummedMiiData(MiiData&& data) : mii_data(data) {
         FixChecksum();
     }
 
-    ChecksummedMiiData& operator=(const MiiData& data) {
+    constexpr ChecksummedMiiData& operator=(const MiiData& data) {
         mii_data = data;
         FixChecksum();
         return *this;
     }
 
-    ChecksummedMiiData& operator=(MiiData&& data) {
+    constexpr ChecksummedMiiData& operator=(MiiData&& data) {
         mii_data = std::move(data);
         FixChecksum();
         return *this;
@@ -270,21 +377,51 @@ public:
         return mii_data;
     }
 
-    bool IsChecksumValid() {
+    [[nodiscard]] constexpr bool IsChecksumValid() const {
         return crc16 == CalcChecksum();
     }
 
-    u16 CalcChecksum();
+    /**
+     * Calculates the checksum of the Mii, see https://www.3dbrew.org/wiki/Mii#Checksum. Usable in
+     * constant expressions, provided that every BitField union was last written through its raw
+     * member, with BitField::AssignRaw (e.g. eye_details.style.AssignRaw(eye_details.raw, x)):
+     * BitField::Assign writes a different union member, which constant evaluation cannot read back
+     * through raw.
+     */
+    [[nodiscard]] constexpr u16 CalcChecksum() const {
+        if (std::is_constant_evaluated()) {
+            return ConstexprCrc16(ChecksummedBytes());
+        }
+        return Crc16(std::as_bytes(std::span(this, 1)).first(offsetof(ChecksummedMiiData, crc16)));
+    }
 
     MiiData mii_data{};
     u16_be unknown{0};
-    u16_be crc16;
+    u16_be crc16{0};
     
 private:
-    void FixChecksum() {
+    constexpr void FixChecksum() {
         crc16 = CalcChecksum();
     }
 
+    /// The bytes covered by the checksum, assembled member by member for constant evaluation
+    constexpr std::array<std::byte, 0x5E> ChecksummedBytes() const {
+        std::array<std::byte, 0x5E> bytes{};
+        const auto store = [&bytes](std::size_t offset, const auto& member) {
+            const auto member_bytes = std::bit_cast<std::array<std::byte, sizeof(member)>>(member);
+            std::copy(member_bytes.begin(), member_bytes.end(), bytes.begin() + offset);
+        };
+#define STORE_MEMBER(name) store(offsetof(MiiData, name), mii_data.name);
+#define STORE_UNION(name) store(offsetof(MiiData, name), mii_data.name.raw);
+        MII_DATA_SCALARS(STORE_MEMBER)
+        MII_DATA_ARRAYS(STORE_MEMBER)
+        MII_DATA_UNIONS(STORE_UNION)
+#undef STORE_UNION
+#undef STORE_MEMBER
+        store(sizeof(MiiData), unknown);
+        return bytes;
+    }
+
     template <class Archive>
     void serialize(Archive& ar, const unsigned int) {
         ar& mii_data;
@@ -300,6 +437,74 @@ private:
 #pragma pack(pop)
 static_assert(sizeof(ChecksummedMiiData) == 0x60,
               "ChecksummedMiiData structure has incorrect size");
+static_assert(offsetof(ChecksummedMiiData, crc16) == 0x5E,
+              "ChecksummedMiiData checksum must cover everything before it");
+static_assert(ChecksummedMiiData().IsChecksumValid(),
+              "The default ChecksummedMiiData must have a valid checksum");
+
+/**
+ * A Mii with nonzero scalars, arrays and BitFields, built in a constant expression so that the
+ * constexpr checksum path is checked against the value the runtime Crc16 gives for the same bytes.
+ */
+constexpr ChecksummedMiiData SampleMii() {
+    MiiData mii{};
+    mii.magic = 0x03;
+    mii.system_id = 0x0123456789ABCDEF;
+    mii.mii_id = 0x89ABCDEF;
+    mii.mac = {0x00, 0x1F, 0x32, 0xA4, 0xB5, 0xC6};
+    mii.mii_name = {u'S', u'a', u'm', u'p', u'l', u'e'};
+    mii.height = 64;
+    mii.width = 48;
+    mii.hair_style = 33;
+    mii.author_name = {u'F', u'R', u'D'};
+    mii.mii_options.allow_copying.AssignRaw(mii.mii_options.raw, 1);
+    mii.mii_options.char_set.AssignRaw(mii.mii_options.raw, 2);
+    mii.mii_details.sex.AssignRaw(mii.mii_details.raw, 1);
+    mii.mii_details.bday_month.AssignRaw(mii.mii_details.raw, 12);
+    mii.mii_details.bday_day.AssignRaw(mii.mii_details.raw, 25);
+    mii.mii_details.favorite.AssignRaw(mii.mii_details.raw, 1);
+    mii.eye_details.style.AssignRaw(mii.eye_details.raw, 42);
+    mii.eye_details.color.AssignRaw(mii.eye_details.raw, 5);
+    mii.eye_details.rotation.AssignRaw(mii.eye_details.raw, 19);
+    mii.eye_details.yposition.AssignRaw(mii.eye_details.raw, 12);
+    mii.mole_details.enable.AssignRaw(mii.mole_details.raw, 1);
+    mii.mole_details.xpos.AssignRaw(mii.mole_details.raw, 17);
+    mii.mole_details.ypos.AssignRaw(mii.mole_details.raw, 20);
+    return ChecksummedMiiData(mii);
+}
+static_assert(SampleMii().crc16 == 0xB233,
+              "The constexpr checksum of SampleMii must match the runtime Crc16");
+// Every field reads back what SampleMii assigned, so the checksum above covers the intended bytes
+static_assert(SampleMii().mii_data.mii_options.allow_copying.ExtractRaw(
+                  SampleMii().mii_data.mii_options.raw) == 1 &&
+              SampleMii().mii_data.mii_options.char_set.ExtractRaw(
+                  SampleMii().mii_data.mii_options.raw) == 2);
+static_assert(SampleMii().mii_data.mii_details.sex.ExtractRaw(
+                  SampleMii().mii_data.mii_details.raw) == 1 &&
+              SampleMii().mii_data.mii_details.bday_month.ExtractRaw(
+                  SampleMii().mii_data.mii_details.raw) == 12 &&
+              SampleMii().mii_data.mii_details.bday_day.ExtractRaw(
+                  SampleMii().mii_data.mii_details.raw) == 25 &&
+              SampleMii().mii_data.mii_details.shirt_color.ExtractRaw(
+                  SampleMii().mii_data.mii_details.raw) == 0 &&
+              SampleMii().mii_data.mii_details.favorite.ExtractRaw(
+                  SampleMii().mii_data.mii_details.raw) == 1);
+static_assert(SampleMii().mii_data.eye_details.style.ExtractRaw(
+                  SampleMii().mii_data.eye_details.raw) == 42 &&
+              SampleMii().mii_data.eye_details.color.ExtractRaw(
+                  SampleMii().mii_data.eye_details.raw) == 5 &&
+              SampleMii().mii_data.eye_details.scale.ExtractRaw(
+                  SampleMii().mii_data.eye_details.raw) == 0 &&
+              SampleMii().mii_data.eye_details.rotation.ExtractRaw(
+                  SampleMii().mii_data.eye_details.raw) == 19 &&
+              SampleMii().mii_data.eye_details.yposition.ExtractRaw(
+                  SampleMii().mii_data.eye_details.raw) == 12);
+static_assert(SampleMii().mii_data.mole_details.enable.ExtractRaw(
+                  SampleMii().mii_data.mole_details.raw) == 1 &&
+              SampleMii().mii_data.mole_details.xpos.ExtractRaw(
+                  SampleMii().mii_data.mole_details.raw) == 17 &&
+              SampleMii().mii_data.mole_details.ypos.ExtractRaw(
+                  SampleMii().mii_data.mole_details.raw) == 20);
 
 struct FriendProfile {
     u8 region{};
@@ -322,6 +527,23 @@ private:
     friend class boost::serialization::access;
 };
 
+/// Identifies an account in a friend list
+struct FriendKey {
+    u32_le principal_id{};
+    u32_le padding{};
+    u64_le local_friend_code{};
+
+private:
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int) {
+        ar& principal_id;
+        ar& padding;
+        ar& local_friend_code;
+    }
+    friend class boost::serialization::access;
+};
+static_assert(sizeof(FriendKey) == 0x10, "FriendKey structure has incorrect size");
+
 struct FRDMyData {
     static constexpr u32 MAGIC_MY_DATA = 0x46504D44;
 
@@ -359,4 +581,41 @@ private:
         ar& padding3;
     }
     friend class boost::serialization::access;
-};
\ No newline at end of file
+};
+
+// Field lists for FriendProfile and FRDMyData, in the same style as the MiiData lists
+
+/// Scalar members of FriendProfile: X(name)
+#define FRIEND_PROFILE_SCALARS(X)                                                                  \
+    X(region)                                                                                      \
+    X(country)                                                                                     \
+    X(area)                                                                                        \
+    X(language)                                                                                    \
+    X(platform)
+
+/// Array members of FriendProfile: X(name)
+#define FRIEND_PROFILE_ARRAYS(X) X(padding)
+
+/// Scalar members of FRDMyData: X(name)
+#define FRD_MY_DATA_SCALARS(X)                                                                     \
+    X(magic)                                                                                       \
+    X(magic_number)                                                                                \
+    X(padding1)                                                                                    \
+    X(unk50)                                                                                       \
+    X(local_friend_code_seed)
+
+/// Array members of FRDMyData: X(name)
+#define FRD_MY_DATA_ARRAYS(X)                                                                      \
+    X(unk10)                                                                                       \
+    X(comment)                                                                                     \
+    X(unk68)                                                                                       \
+    X(serial_number)                                                                               \
+    X(display_name)                                                                                \
+    X(padding2)                                                                                    \
+    X(padding3)
+
+#define FRD_MY_DATA_MEMBER_SIZE(name) +sizeof(FRDMyData::name)
+static_assert(0 FRD_MY_DATA_SCALARS(FRD_MY_DATA_MEMBER_SIZE) FRD_MY_DATA_ARRAYS(FRD_MY_DATA_MEMBER_SIZE) +
+                      sizeof(FRDMyData::profile) + sizeof(FRDMyData::mii_data) == sizeof(FRDMyData),
+              "FRDMyData field lists are out of sync with the structure");
+#undef FRD_MY_DATA_MEMBER_SIZE
@@ -0,0 +1,381 @@
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "manifest.h"
+
+struct Manifest::Header {
+    std::array<char, 8> magic;
+    u64 capacity;
+    u64 used; ///< Slots with a path hash or a tombstone, recounted by Open
+    std::array<u8, 40> reserved;
+};
+
+/// One table slot. Fields are only accessed through std::atomic_ref.
+struct Manifest::Slot {
+    u64 path_hash; ///< 0 while the slot is unused, TOMBSTONE once its path is invalidated
+    u32 sequence;  ///< Seqlock counter, odd while the slot is being written
+    u16 crc16;
+    u16 valid;
+    u64 device;
+    u64 inode;
+    u64 size;
+    s64 mtime_ns;
+    s64 ctime_ns;
+    u64 content_hash;
+    u64 result;
+};
+
+namespace {
+
+constexpr std::array<char, 8> MANIFEST_MAGIC{'F', 'R', 'D', 'M', 'A', 'N', 'I', '1'};
+static_assert(sizeof(Manifest::Header) == 64);
+
+/// Path hash of a slot that can be reused, but that probes for other paths must pass over
+constexpr u64 TOMBSTONE = ~u64{0};
+
+template <typename T>
+T Load(const T& value, std::memory_order order = std::memory_order_relaxed) {
+    return std::atomic_ref<T>(const_cast<T&>(value)).load(order);
+}
+
+template <typename T>
+void Store(T& value, T desired, std::memory_order order = std::memory_order_relaxed) {
+    std::atomic_ref<T>(value).store(desired, order);
+}
+
+u64 PathHash(std::string_view path) {
+    const u64 hash = ContentHash({reinterpret_cast<const u8*>(path.data()), path.size()});
+    return hash == 0 || hash == TOMBSTONE ? 1 : hash;
+}
+
+/// Spins until the slot's seqlock is taken by this thread; returns the odd sequence value
+u32 LockSlot(Manifest::Slot& slot) {
+    std::atomic_ref<u32> sequence(slot.sequence);
+    while (true) {
+        u32 current = sequence.load(std::memory_order_relaxed);
+        if ((current & 1) == 0 &&
+            sequence.compare_exchange_weak(current, current + 1, std::memory_order_acquire)) {
+            return current + 1;
+        }
+        std::this_thread::yield();
+    }
+}
+
+void UnlockSlot(Manifest::Slot& slot, u32 locked_sequence) {
+    Store(slot.sequence, locked_sequence + 1, std::memory_order_release);
+}
+
+void WriteEntry(Manifest::Slot& slot, const ManifestEntry& entry, bool valid) {
+    Store(slot.device, entry.identity.device);
+    Store(slot.inode, entry.identity.inode);
+    Store(slot.size, entry.identity.size);
+    Store(slot.mtime_ns, entry.identity.mtime_ns);
+    Store(slot.ctime_ns, entry.identity.ctime_ns);
+    Store(slot.content_hash, entry.content_hash);
+    Store(slot.crc16, entry.crc16);
+    Store(slot.result, entry.result);
+    Store(slot.valid, static_cast<u16>(valid));
+}
+
+/// Reads a consistent copy of the slot; returns false if it holds no valid entry
+bool ReadEntry(const Manifest::Slot& slot, ManifestEntry& entry) {
+    while (true) {
+        const u32 before = Load(slot.sequence, std::memory_order_acquire);
+        if (before & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        const bool valid = Load(slot.valid) != 0;
+        entry.identity.device = Load(slot.device);
+        entry.identity.inode = Load(slot.inode);
+        entry.identity.size = Load(slot.size);
+        entry.identity.mtime_ns = Load(slot.mtime_ns);
+        entry.identity.ctime_ns = Load(slot.ctime_ns);
+        entry.content_hash = Load(slot.content_hash);
+        entry.crc16 = Load(slot.crc16);
+        entry.result = Load(slot.result);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (Load(slot.sequence) == before) {
+            return valid;
+        }
+    }
+}
+
+} // namespace
+
+std::optional<FileIdentity> FileIdentity::Of(const std::string& path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return std::nullopt;
+    }
+    FileIdentity identity;
+    identity.device = st.st_dev;
+    identity.inode = st.st_ino;
+    identity.size = static_cast<u64>(st.st_size);
+    identity.mtime_ns = s64{st.st_mtim.tv_sec} * 1000000000 + st.st_mtim.tv_nsec;
+    identity.ctime_ns = s64{st.st_ctim.tv_sec} * 1000000000 + st.st_ctim.tv_nsec;
+    return identity;
+}
+
+u64 ContentHash(std::span<const u8> bytes) {
+    u64 hash = 0xCBF29CE484222325;
+    for (const u8 byte : bytes) {
+        hash = (hash ^ byte) * 0x100000001B3;
+    }
+    return hash;
+}
+
+Manifest::~Manifest() {
+    Close();
+}
+
+void Manifest::Close() {
+    if (mapping) {
+        munmap(mapping, mapping_size);
+        mapping = nullptr;
+        slots = nullptr;
+        mapping_size = capacity = 0;
+    }
+    if (fd >= 0) {
+        close(fd); // Releases the flock
+        fd = -1;
+    }
+}
+
+bool Manifest::Map(const std::string& path, std::size_t capacity_, bool create) {
+    int file = -1;
+    while (true) {
+        file = open(path.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT | O_TRUNC : 0), 0644);
+        if (file < 0) {
+            return false;
+        }
+        // Every process holds a shared lock while it has the table mapped, which Open upgrades to
+        // migrate it. The lock may only be granted once a migration has replaced the file, so
+        // retry until it is held on the file that is at path.
+        struct stat locked;
+        struct stat current;
+        if (flock(file, LOCK_SH) != 0 || fstat(file, &locked) != 0) {
+            close(file);
+            return false;
+        }
+        if (create || (stat(path.c_str(), &current) == 0 && current.st_dev == locked.st_dev &&
+                       current.st_ino == locked.st_ino)) {
+            break;
+        }
+        close(file);
+    }
+
+    Header header{};
+    if (create) {
+        header.magic = MANIFEST_MAGIC;
+        header.capacity = capacity_;
+        if (ftruncate(file, sizeof(Header) + capacity_ * sizeof(Slot)) != 0 ||
+            pwrite(file, &header, sizeof(header), 0) != sizeof(header)) {
+            close(file);
+            return false;
+        }
+    } else {
+        struct stat st;
+        if (pread(file, &header, sizeof(header), 0) != sizeof(header) || fstat(file, &st) != 0 ||
+            header.magic != MANIFEST_MAGIC || !std::has_single_bit(header.capacity) ||
+            static_cast<u64>(st.st_size) != sizeof(Header) + header.capacity * sizeof(Slot)) {
+            close(file);
+            return false;
+        }
+    }
+
+    const std::size_t size = sizeof(Header) + header.capacity * sizeof(Slot);
+    void* result = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    if (result == MAP_FAILED) {
+        close(file);
+        return false;
+    }
+
+    fd = file;
+    mapping = static_cast<u8*>(result);
+    mapping_size = size;
+    slots = reinterpret_cast<Slot*>(mapping + sizeof(Header));
+    capacity = header.capacity;
+    return true;
+}
+
+bool Manifest::Open(const std::string& path, std::size_t min_capacity) {
+    Close();
+    min_capacity = std::bit_ceil(std::max<std::size_t>(min_capacity, 16));
+
+    if (access(path.c_str(), F_OK) != 0) {
+        return Map(path, min_capacity, true);
+    }
+    if (!Map(path, 0, false)) {
+        return false;
+    }
+
+    u64 used = 0;
+    u64 live = 0;
+    for (std::size_t i = 0; i < capacity; i++) {
+        const u64 path_hash = Load(slots[i].path_hash);
+        used += path_hash != 0;
+        live += path_hash != 0 && path_hash != TOMBSTONE && Load(slots[i].valid) != 0;
+    }
+    Store(reinterpret_cast<Header*>(mapping)->used, used);
+    if (capacity >= min_capacity && used <= capacity / 2) {
+        return true;
+    }
+    // Other processes mapping the table would go on writing to the replaced file, so it is only
+    // migrated while no other process has it open; otherwise it stays as it is for now
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        return flock(fd, LOCK_SH) == 0;
+    }
+
+    // Too small or too full: migrate the valid entries into a table at most a quarter full, which
+    // drops the tombstones, and replace the file with it
+    const std::string temp_path = path + ".tmp";
+    Manifest rehashed;
+    const std::size_t new_capacity = std::max<std::size_t>(min_capacity, std::bit_ceil(live * 4));
+    if (!rehashed.Map(temp_path, new_capacity, true)) {
+        unlink(temp_path.c_str());
+        Close();
+        return false;
+    }
+    for (std::size_t i = 0; i < capacity; i++) {
+        ManifestEntry entry;
+        const u64 path_hash = Load(slots[i].path_hash);
+        if (path_hash != 0 && path_hash != TOMBSTONE && ReadEntry(slots[i], entry)) {
+            Slot* slot = rehashed.FindSlot(path_hash, true);
+            WriteEntry(*slot, entry, true);
+        }
+    }
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        unlink(temp_path.c_str());
+        Close();
+        return false;
+    }
+
+    Close();
+    fd = std::exchange(rehashed.fd, -1);
+    mapping = std::exchange(rehashed.mapping, nullptr);
+    mapping_size = rehashed.mapping_size;
+    slots = rehashed.slots;
+    capacity = rehashed.capacity;
+    return true;
+}
+
+Manifest::Slot* Manifest::FindSlot(u64 path_hash, bool claim) const {
+    const std::size_t mask = capacity - 1;
+    std::atomic_ref<u64> used(reinterpret_cast<Header*>(mapping)->used);
+    Slot* tombstone = nullptr; ///< First one passed over, reused if path_hash is not found
+    std::size_t index = path_hash & mask;
+    for (std::size_t probes = 0; probes < capacity; probes++, index = (index + 1) & mask) {
+        std::atomic_ref<u64> slot_hash(slots[index].path_hash);
+        u64 current = slot_hash.load(std::memory_order_acquire);
+        if (current == TOMBSTONE) {
+            tombstone = tombstone ? tombstone : &slots[index];
+            continue;
+        }
+        if (current == 0) {
+            if (!claim) {
+                return nullptr;
+            }
+            if (tombstone) {
+                u64 expected = TOMBSTONE;
+                if (std::atomic_ref<u64>(tombstone->path_hash)
+                        .compare_exchange_strong(expected, path_hash, std::memory_order_acq_rel) ||
+                    expected == path_hash) {
+                    return tombstone;
+                }
+                // Another path took the tombstone first; probe again
+                return FindSlot(path_hash, claim);
+            }
+            // Unused slots are only claimed up to the load limit, so probes stay short and every
+            // miss ends at an unused slot
+            if (used.fetch_add(1, std::memory_order_relaxed) >= capacity * MAX_LOAD_PERCENT / 100) {
+                used.fetch_sub(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            if (slot_hash.compare_exchange_strong(current, path_hash, std::memory_order_acq_rel)) {
+                return &slots[index];
+            }
+            // Lost the race; current now holds the winner's hash
+            used.fetch_sub(1, std::memory_order_relaxed);
+        }
+        if (current == path_hash) {
+            return &slots[index];
+        }
+    }
+    return nullptr;
+}
+
+std::optional<ManifestEntry> Manifest::Lookup(std::string_view path,
+                                              const FileIdentity& identity) const {
+    if (!mapping) {
+        return std::nullopt;
+    }
+    const Slot* slot = FindSlot(PathHash(path), false);
+    ManifestEntry entry;
+    if (!slot || !ReadEntry(*slot, entry) || entry.identity != identity) {
+        return std::nullopt;
+    }
+    return entry;
+}
+
+bool Manifest::Update(std::string_view path, const ManifestEntry& entry) {
+    if (!mapping) {
+        return false;
+    }
+    const u64 path_hash = PathHash(path);
+    while (true) {
+        Slot* slot = FindSlot(path_hash, true);
+        if (!slot) {
+            return false;
+        }
+        const u32 sequence = LockSlot(*slot);
+        // The slot may have been invalidated, and even reused, since it was found
+        const bool owned = Load(slot->path_hash) == path_hash;
+        if (owned) {
+            WriteEntry(*slot, entry, true);
+        }
+        UnlockSlot(*slot, sequence);
+        if (owned) {
+            return true;
+        }
+    }
+}
+
+void Manifest::Invalidate(std::string_view path) {
+    if (!mapping) {
+        return;
+    }
+    // An Update that reused a tombstone while another was claiming a slot further along for the
+    // same path can leave two copies of it, so every copy up to the end of the probe is freed
+    const u64 path_hash = PathHash(path);
+    const std::size_t mask = capacity - 1;
+    std::size_t index = path_hash & mask;
+    for (std::size_t probes = 0; probes < capacity; probes++, index = (index + 1) & mask) {
+        Slot& slot = slots[index];
+        const u64 current = Load(slot.path_hash, std::memory_order_acquire);
+        if (current == 0) {
+            break;
+        }
+        if (current == path_hash) {
+            const u32 sequence = LockSlot(slot);
+            Store(slot.valid, u16{0});
+            Store(slot.path_hash, TOMBSTONE, std::memory_order_release);
+            UnlockSlot(slot, sequence);
+        }
+    }
+}
+
+void Manifest::Sync() {
+    if (mapping) {
+        msync(mapping, mapping_size, MS_SYNC);
+    }
+}
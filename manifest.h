@@ -0,0 +1,92 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include "swap.h"
+
+/// What identifies a file's contents without reading it
+struct FileIdentity {
+    u64 device = 0;
+    u64 inode = 0;
+    u64 size = 0;
+    s64 mtime_ns = 0;
+    s64 ctime_ns = 0;
+
+    /// Identity of path as reported by stat(), or nullopt if it cannot be stat'ed
+    static std::optional<FileIdentity> Of(const std::string& path);
+
+    bool operator==(const FileIdentity&) const = default;
+};
+
+struct ManifestEntry {
+    FileIdentity identity;
+    u64 content_hash = 0; ///< ContentHash() of the bytes that were processed
+    u16 crc16 = 0;        ///< ChecksummedMiiData::crc16 of the record
+    u64 result = 0;       ///< Derived result, opaque to the manifest
+};
+
+/// 64-bit FNV-1a hash of a file's contents
+[[nodiscard]] u64 ContentHash(std::span<const u8> bytes);
+
+/**
+ * Persistent, memory-mapped table of path -> ManifestEntry, used to skip files that have not
+ * changed since the previous run. Entries are keyed by a 64-bit hash of the path and stay valid
+ * only while the file's identity (device, inode, size, mtime and ctime) is unchanged.
+ *
+ * Lookup and Update may be called concurrently from any number of threads, or processes sharing
+ * the file: slots are claimed with a compare-and-swap and each slot is guarded by its own seqlock,
+ * so there is no global lock.
+ *
+ * Invalidated slots are left as tombstones that Update reuses. Unused slots are only claimed while
+ * the table is under MAX_LOAD_PERCENT full, and Open rehashes a table that is over half full,
+ * tombstones included, into one with room for the live entries to double. Each process holds a
+ * shared flock on the file while it is open, and Open only migrates the table when it can take
+ * the lock exclusively, as other processes would keep using the replaced file.
+ */
+class Manifest {
+public:
+    static constexpr std::size_t DEFAULT_CAPACITY = 0x10000;
+    static constexpr std::size_t MAX_LOAD_PERCENT = 75;
+
+    Manifest() = default;
+    ~Manifest();
+    Manifest(const Manifest&) = delete;
+    Manifest& operator=(const Manifest&) = delete;
+
+    /**
+     * Opens or creates the manifest at path. If an existing manifest has fewer than
+     * min_capacity slots, or is over half full, its entries are migrated to a new table first,
+     * unless another process has it open.
+     * Must not be called while other threads are using this object.
+     */
+    bool Open(const std::string& path, std::size_t min_capacity = DEFAULT_CAPACITY);
+    void Close();
+
+    /// Stored entry for path if it was recorded for the same file identity
+    [[nodiscard]] std::optional<ManifestEntry> Lookup(std::string_view path,
+                                                      const FileIdentity& identity) const;
+
+    /// Records entry for path; returns false if the table is at its load limit until the next Open
+    bool Update(std::string_view path, const ManifestEntry& entry);
+
+    /// Forgets path so the next Lookup misses, and frees its slot for reuse
+    void Invalidate(std::string_view path);
+
+    /// Flushes the mapping to disk
+    void Sync();
+
+    struct Header;
+    struct Slot;
+
+private:
+    [[nodiscard]] Slot* FindSlot(u64 path_hash, bool claim) const;
+    bool Map(const std::string& path, std::size_t capacity, bool create);
+
+    int fd = -1; ///< Holds the flock on the mapped file
+    u8* mapping = nullptr;
+    std::size_t mapping_size = 0;
+    Slot* slots = nullptr;
+    std::size_t capacity = 0;
+};
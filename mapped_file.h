@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdio>
+#include <span>
+#include <string>
+#include "swap.h"
+
+/// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /// Maps path, replacing any previous mapping. Returns false if it cannot be opened or mapped.
+    bool Open(const std::string& path);
+    void Close();
+
+    [[nodiscard]] bool IsOpen() const {
+        return data != nullptr;
+    }
+
+    [[nodiscard]] std::span<const u8> Bytes() const {
+        return {data, size};
+    }
+
+private:
+    const u8* data = nullptr;
+    std::size_t size = 0;
+};
+
+/// Writes size bytes of data at offset in file, for building the files MappedFile opens section by
+/// section. Returns false on a seek or short write.
+bool WriteSection(std::FILE* file, u64 offset, const void* data, std::size_t size);
@@ -0,0 +1,78 @@
+#include <bit>
+#include "crc16.h"
+#include "mii_database.h"
+#include "parallel.h"
+
+namespace {
+
+constexpr std::size_t CHECKSUM_SIZE = sizeof(u16);
+
+/// Bytes of an entry covered by its CRC
+constexpr std::size_t ENTRY_CHECKSUMMED_SIZE = offsetof(ChecksummedMiiData, crc16);
+
+} // namespace
+
+bool MiiDatabase::Open(const std::string& path) {
+    entries = {};
+    if (!file.Open(path)) {
+        return false;
+    }
+
+    const std::span<const u8> bytes = file.Bytes();
+    if (bytes.size() < sizeof(Header) + CHECKSUM_SIZE ||
+        (bytes.size() - sizeof(Header) - CHECKSUM_SIZE) % sizeof(ChecksummedMiiData) != 0 ||
+        GetHeader().magic != MAGIC) {
+        file.Close();
+        return false;
+    }
+
+    entries = {reinterpret_cast<const ChecksummedMiiData*>(bytes.data() + sizeof(Header)),
+               (bytes.size() - sizeof(Header) - CHECKSUM_SIZE) / sizeof(ChecksummedMiiData)};
+    return true;
+}
+
+std::vector<u64> MiiDatabase::ValidEntries() const {
+    std::vector<u16> crcs(entries.size());
+    Crc16Batch(std::as_bytes(entries).data(), sizeof(ChecksummedMiiData), ENTRY_CHECKSUMMED_SIZE,
+               crcs);
+
+    std::vector<u64> valid((entries.size() + 63) / 64);
+    for (std::size_t i = 0; i < entries.size(); i++) {
+        valid[i / 64] |= u64{entries[i].crc16 == crcs[i]} << (i % 64);
+    }
+    return valid;
+}
+
+u16 MiiDatabase::StoredChecksum() const {
+    const std::span<const u8> bytes = file.Bytes();
+    return static_cast<u16>(bytes[bytes.size() - 2] << 8 | bytes[bytes.size() - 1]);
+}
+
+u16 MiiDatabase::CalcChecksum() const {
+    return Crc16(std::as_bytes(file.Bytes().first(file.Bytes().size() - CHECKSUM_SIZE)));
+}
+
+std::vector<MiiDatabaseReport> ValidateMiiDatabases(std::span<const std::string> paths) {
+    std::vector<MiiDatabaseReport> reports(paths.size());
+    ParallelFor(
+        paths.size(),
+        [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; i++) {
+                MiiDatabase database;
+                if (!database.Open(paths[i])) {
+                    continue;
+                }
+                MiiDatabaseReport& report = reports[i];
+                report.opened = true;
+                report.entries = database.Entries().size();
+                u64 valid = 0;
+                for (const u64 word : database.ValidEntries()) {
+                    valid += std::popcount(word);
+                }
+                report.invalid_entries = report.entries - valid;
+                report.checksum_valid = database.IsChecksumValid();
+            }
+        },
+        0x10);
+    return reports;
+}
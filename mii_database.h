@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>
+#include <span>
+#include <string>
+#include <vector>
+#include "main.h"
+#include "mapped_file.h"
+
+/**
+ * Mii Maker database (CFL_DB.dat): a header, then ChecksummedMiiData entries back to back, then the
+ * CRC16 of everything before it, big endian like the CRC of a Mii. Empty slots are all zero, which
+ * is a valid Mii CRC.
+ *
+ * Open maps the file and checks its framing without reading the entries, which are exposed in
+ * place. Validation runs every entry through Crc16Batch.
+ */
+class MiiDatabase {
+public:
+    static constexpr std::array<char, 4> MAGIC = {'C', 'F', 'O', 'G'};
+
+#pragma pack(push, 1)
+    struct Header {
+        std::array<char, 4> magic;
+        u32_be version;
+    };
+#pragma pack(pop)
+    static_assert(sizeof(Header) == 8, "MiiDatabase::Header structure has incorrect size");
+
+    /// Returns false if path cannot be mapped or is not framed as a database
+    bool Open(const std::string& path);
+
+    [[nodiscard]] const Header& GetHeader() const {
+        return *reinterpret_cast<const Header*>(file.Bytes().data());
+    }
+
+    [[nodiscard]] std::span<const ChecksummedMiiData> Entries() const {
+        return entries;
+    }
+
+    /// Bitmap of the entries whose CRC matches, in the format of RecordFilter::Select
+    [[nodiscard]] std::vector<u64> ValidEntries() const;
+
+    [[nodiscard]] u16 StoredChecksum() const;
+    [[nodiscard]] u16 CalcChecksum() const;
+
+    [[nodiscard]] bool IsChecksumValid() const {
+        return StoredChecksum() == CalcChecksum();
+    }
+
+private:
+    MappedFile file;
+    std::span<const ChecksummedMiiData> entries;
+};
+
+struct MiiDatabaseReport {
+    bool opened = false;        ///< False if the file could not be mapped or is not a database
+    u64 entries = 0;
+    u64 invalid_entries = 0;    ///< Entries whose CRC does not match
+    bool checksum_valid = false; ///< Whether the file CRC matches
+};
+
+/// Validates many databases, spread across the worker threads; reports are in the order of paths
+[[nodiscard]] std::vector<MiiDatabaseReport> ValidateMiiDatabases(std::span<const std::string> paths);
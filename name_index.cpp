@@ -0,0 +1,329 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "name_index.h"
+#include "parallel.h"
+
+struct NameIndex::Header {
+    std::array<char, 8> magic;
+    u64 name_count;
+    u64 hit_count;
+    u64 pool_size; ///< In UTF-16 code units
+    u64 gram_count;
+    u64 posting_count;
+    u64 names_offset;
+    u64 hits_offset;
+    u64 pool_offset;
+    u64 grams_offset;
+    u64 postings_offset;
+};
+
+struct NameIndex::NameEntry {
+    u32 pool_offset;
+    u32 length;
+    u32 first_hit;
+    u32 hit_count;
+};
+
+struct NameIndex::GramEntry {
+    u64 key; ///< GramKey of a sequence of one to three code units
+    u32 first_posting;
+    u32 posting_count;
+};
+
+namespace {
+
+constexpr std::array<char, 8> NAME_INDEX_MAGIC{'F', 'R', 'D', 'N', 'A', 'M', 'E', '2'};
+constexpr std::size_t MAX_NAME_LENGTH = FRIEND_SCREEN_NAME_SIZE;
+constexpr std::size_t MAX_GRAM_LENGTH = 3;
+/// Positions of the one, two and three code unit grams of a name of MAX_NAME_LENGTH
+constexpr std::size_t MAX_GRAMS_PER_NAME = MAX_GRAM_LENGTH * MAX_NAME_LENGTH - 3;
+
+struct BuildEntry {
+    std::array<char16_t, MAX_NAME_LENGTH> name;
+    u8 length;
+    u32 hit; ///< record << 2 | field
+
+    std::u16string_view View() const {
+        return {name.data(), length};
+    }
+};
+
+template <size_t size>
+void ExtractName(const std::array<u16, size>& src, NameField field, u32 record, BuildEntry& entry) {
+    static_assert(size <= MAX_NAME_LENGTH);
+    std::size_t length = 0;
+    while (length < size && src[length] != 0) {
+        entry.name[length] = static_cast<char16_t>(src[length]);
+        length++;
+    }
+    entry.length = static_cast<u8>(length);
+    entry.hit = record << 2 | static_cast<u32>(field);
+}
+
+/// Key of the length code units of str at pos; the length is part of the key, above the units
+constexpr u64 GramKey(std::u16string_view str, std::size_t pos, std::size_t length) {
+    u64 key = u64{length} << 48;
+    for (std::size_t i = 0; i < length; i++) {
+        key |= u64{str[pos + i]} << (16 * (length - 1 - i));
+    }
+    return key;
+}
+
+constexpr u64 AlignSection(u64 offset) {
+    return (offset + 7) & ~u64{7};
+}
+
+/// Sorts the extracted names, groups them and writes the index file
+bool WriteIndex(std::vector<BuildEntry>& entries, const std::string& path) {
+    std::erase_if(entries, [](const BuildEntry& entry) { return entry.length == 0; });
+    ParallelSort(entries, [](const BuildEntry& a, const BuildEntry& b) {
+        const int order = a.View().compare(b.View());
+        return order != 0 ? order < 0 : a.hit < b.hit;
+    });
+
+    std::vector<NameIndex::NameEntry> names;
+    std::vector<u32> hits(entries.size());
+    std::vector<char16_t> pool;
+    for (std::size_t i = 0; i < entries.size(); i++) {
+        hits[i] = entries[i].hit;
+        if (i == 0 || entries[i].View() != entries[i - 1].View()) {
+            const std::u16string_view name = entries[i].View();
+            names.push_back({static_cast<u32>(pool.size()), static_cast<u32>(name.size()),
+                             static_cast<u32>(i), 0});
+            pool.insert(pool.end(), name.begin(), name.end());
+        }
+        names.back().hit_count++;
+    }
+
+    // (gram, name id) pairs; names have at most MAX_GRAMS_PER_NAME of them
+    constexpr u64 NO_GRAM = ~u64{0};
+    std::vector<std::pair<u64, u32>> pairs(names.size() * MAX_GRAMS_PER_NAME, {NO_GRAM, 0});
+    ParallelFor(names.size(), [&](std::size_t begin, std::size_t end) {
+        for (std::size_t id = begin; id < end; id++) {
+            const std::u16string_view name(pool.data() + names[id].pool_offset, names[id].length);
+            std::size_t slot = id * MAX_GRAMS_PER_NAME;
+            for (std::size_t length = 1; length <= MAX_GRAM_LENGTH; length++) {
+                for (std::size_t pos = 0; pos + length <= name.size(); pos++) {
+                    pairs[slot++] = {GramKey(name, pos, length), static_cast<u32>(id)};
+                }
+            }
+        }
+    });
+    std::erase_if(pairs, [](const auto& pair) { return pair.first == NO_GRAM; });
+    ParallelSort(pairs);
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+    std::vector<NameIndex::GramEntry> grams;
+    std::vector<u32> postings(pairs.size());
+    for (std::size_t i = 0; i < pairs.size(); i++) {
+        postings[i] = pairs[i].second;
+        if (i == 0 || pairs[i].first != pairs[i - 1].first) {
+            grams.push_back({pairs[i].first, static_cast<u32>(i), 0});
+        }
+        grams.back().posting_count++;
+    }
+
+    NameIndex::Header header{};
+    header.magic = NAME_INDEX_MAGIC;
+    header.name_count = names.size();
+    header.hit_count = hits.size();
+    header.pool_size = pool.size();
+    header.gram_count = grams.size();
+    header.posting_count = postings.size();
+    header.names_offset = AlignSection(sizeof(header));
+    header.hits_offset = AlignSection(header.names_offset + names.size() * sizeof(names[0]));
+    header.pool_offset = AlignSection(header.hits_offset + hits.size() * sizeof(u32));
+    header.grams_offset = AlignSection(header.pool_offset + pool.size() * sizeof(char16_t));
+    header.postings_offset = AlignSection(header.grams_offset + grams.size() * sizeof(grams[0]));
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    const bool written =
+        WriteSection(file, 0, &header, sizeof(header)) &&
+        WriteSection(file, header.names_offset, names.data(), names.size() * sizeof(names[0])) &&
+        WriteSection(file, header.hits_offset, hits.data(), hits.size() * sizeof(u32)) &&
+        WriteSection(file, header.pool_offset, pool.data(), pool.size() * sizeof(char16_t)) &&
+        WriteSection(file, header.grams_offset, grams.data(), grams.size() * sizeof(grams[0])) &&
+        WriteSection(file, header.postings_offset, postings.data(), postings.size() * sizeof(u32));
+    return std::fclose(file) == 0 && written;
+}
+
+} // namespace
+
+bool NameIndex::Build(std::span<const FRDMyData> records, const std::string& path) {
+    if (records.size() > MAX_RECORDS) {
+        return false;
+    }
+    std::vector<BuildEntry> entries(records.size() * 3);
+    ParallelFor(records.size(), [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            const auto record = static_cast<u32>(i);
+            const MiiData& mii = records[i].mii_data.mii_data;
+            ExtractName(records[i].display_name, NameField::DisplayName, record, entries[i * 3]);
+            ExtractName(mii.mii_name, NameField::MiiName, record, entries[i * 3 + 1]);
+            ExtractName(mii.author_name, NameField::AuthorName, record, entries[i * 3 + 2]);
+        }
+    });
+    return WriteIndex(entries, path);
+}
+
+bool NameIndex::Build(std::span<const ChecksummedMiiData> records, const std::string& path) {
+    if (records.size() > MAX_RECORDS) {
+        return false;
+    }
+    std::vector<BuildEntry> entries(records.size() * 2);
+    ParallelFor(records.size(), [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            const auto record = static_cast<u32>(i);
+            const MiiData& mii = records[i].mii_data;
+            ExtractName(mii.mii_name, NameField::MiiName, record, entries[i * 2]);
+            ExtractName(mii.author_name, NameField::AuthorName, record, entries[i * 2 + 1]);
+        }
+    });
+    return WriteIndex(entries, path);
+}
+
+bool NameIndex::Open(const std::string& path) {
+    names = nullptr;
+    name_count = hit_count = pool_size = gram_count = posting_count = 0;
+    if (!file.Open(path)) {
+        return false;
+    }
+
+    const std::span<const u8> bytes = file.Bytes();
+    Header header;
+    if (bytes.size() < sizeof(header)) {
+        file.Close();
+        return false;
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+
+    // Only the sections are checked here, so opening stays constant time; the entries in them are
+    // checked against the sections they point into as queries reach them
+    const auto fits = [&](u64 offset, u64 count, u64 size) {
+        return offset % 8 == 0 && offset <= bytes.size() && count <= (bytes.size() - offset) / size;
+    };
+    if (header.magic != NAME_INDEX_MAGIC ||
+        !fits(header.names_offset, header.name_count, sizeof(NameEntry)) ||
+        !fits(header.hits_offset, header.hit_count, sizeof(u32)) ||
+        !fits(header.pool_offset, header.pool_size, sizeof(char16_t)) ||
+        !fits(header.grams_offset, header.gram_count, sizeof(GramEntry)) ||
+        !fits(header.postings_offset, header.posting_count, sizeof(u32))) {
+        file.Close();
+        return false;
+    }
+
+    names = reinterpret_cast<const NameEntry*>(bytes.data() + header.names_offset);
+    hits = reinterpret_cast<const u32*>(bytes.data() + header.hits_offset);
+    pool = reinterpret_cast<const char16_t*>(bytes.data() + header.pool_offset);
+    grams = reinterpret_cast<const GramEntry*>(bytes.data() + header.grams_offset);
+    postings = reinterpret_cast<const u32*>(bytes.data() + header.postings_offset);
+    name_count = header.name_count;
+    hit_count = header.hit_count;
+    pool_size = header.pool_size;
+    gram_count = header.gram_count;
+    posting_count = header.posting_count;
+    return true;
+}
+
+std::u16string_view NameIndex::Name(std::size_t id) const {
+    // Names are never empty, so a corrupt entry matches no query
+    const NameEntry& entry = names[id];
+    if (u64{entry.pool_offset} + entry.length > pool_size) {
+        return {};
+    }
+    return {pool + entry.pool_offset, entry.length};
+}
+
+void NameIndex::AppendHits(std::size_t id, std::vector<NameHit>& out, std::size_t limit) const {
+    const NameEntry& entry = names[id];
+    if (u64{entry.first_hit} + entry.hit_count > hit_count) {
+        return;
+    }
+    for (u32 i = 0; i < entry.hit_count && out.size() < limit; i++) {
+        const u32 hit = hits[entry.first_hit + i];
+        if ((hit & 3) <= static_cast<u32>(NameField::AuthorName)) {
+            out.push_back({hit >> 2, static_cast<NameField>(hit & 3)});
+        }
+    }
+}
+
+std::span<const u32> NameIndex::Postings(u64 key) const {
+    const GramEntry* entry = std::partition_point(
+        grams, grams + gram_count, [&](const GramEntry& e) { return e.key < key; });
+    if (entry == grams + gram_count || entry->key != key ||
+        u64{entry->first_posting} + entry->posting_count > posting_count) {
+        return {};
+    }
+    return {postings + entry->first_posting, entry->posting_count};
+}
+
+std::vector<NameHit> NameIndex::FindExact(std::u16string_view name, std::size_t limit) const {
+    std::vector<NameHit> result;
+    const auto id = std::partition_point(names, names + name_count, [&](const NameEntry& entry) {
+                        return Name(&entry - names) < name;
+                    }) - names;
+    if (static_cast<std::size_t>(id) < name_count && Name(id) == name) {
+        AppendHits(id, result, limit);
+    }
+    return result;
+}
+
+std::vector<NameHit> NameIndex::FindPrefix(std::u16string_view prefix, std::size_t limit) const {
+    std::vector<NameHit> result;
+    auto id = std::partition_point(names, names + name_count, [&](const NameEntry& entry) {
+                  return Name(&entry - names) < prefix;
+              }) - names;
+    for (; static_cast<std::size_t>(id) < name_count && result.size() < limit; id++) {
+        if (!Name(id).starts_with(prefix)) {
+            break;
+        }
+        AppendHits(id, result, limit);
+    }
+    return result;
+}
+
+std::vector<NameHit> NameIndex::FindSubstring(std::u16string_view needle, std::size_t limit) const {
+    std::vector<NameHit> result;
+    if (needle.empty()) {
+        // Every name contains the empty string
+        for (std::size_t id = 0; id < name_count && result.size() < limit; id++) {
+            AppendHits(id, result, limit);
+        }
+        return result;
+    }
+
+    // A needle of up to MAX_GRAM_LENGTH code units is a gram itself, whose list holds exactly the
+    // names containing it. Longer needles verify the names on the shortest list of their trigrams.
+    const std::size_t length = std::min(needle.size(), MAX_GRAM_LENGTH);
+    std::span<const u32> shortest;
+    for (std::size_t pos = 0; pos + length <= needle.size(); pos++) {
+        const std::span<const u32> list = Postings(GramKey(needle, pos, length));
+        if (list.empty()) {
+            return result;
+        }
+        if (shortest.empty() || list.size() < shortest.size()) {
+            shortest = list;
+        }
+    }
+
+    for (std::size_t i = 0; i < shortest.size() && result.size() < limit; i++) {
+        const u32 id = shortest[i];
+        const bool verified = needle.size() <= MAX_GRAM_LENGTH ||
+                              Name(id).find(needle) != std::u16string_view::npos;
+        if (id < name_count && verified) {
+            AppendHits(id, result, limit);
+        }
+    }
+    return result;
+}
+
+std::u16string WidenName(std::string_view name) {
+    std::u16string result(name.size(), u'\0');
+    std::transform(name.begin(), name.end(), result.begin(),
+                   [](char c) { return static_cast<char16_t>(static_cast<u8>(c)); });
+    return result;
+}
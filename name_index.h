@@ -0,0 +1,77 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "main.h"
+#include "mapped_file.h"
+
+enum class NameField : u8 {
+    DisplayName, ///< FRDMyData::display_name
+    MiiName,     ///< MiiData::mii_name
+    AuthorName,  ///< MiiData::author_name
+};
+
+struct NameHit {
+    u32 record;      ///< Index of the record in the corpus the index was built from
+    NameField field; ///< Field of that record holding the name
+};
+
+/**
+ * Exact, prefix and substring lookups over the UTF-16 names of a corpus, without converting any
+ * name at query time. The index is a file holding the distinct names in sorted order (exact and
+ * prefix queries binary search it, like walking a compressed trie) and a posting list per one, two
+ * and three code unit sequence. A substring query of up to three code units reads its list
+ * directly; a longer one looks up every trigram of the needle and verifies the names on the
+ * shortest list.
+ * Built in parallel, and opened with mmap so no deserialization happens at startup: Open only
+ * checks that the sections fit in the file, and queries check the entries they read.
+ */
+class NameIndex {
+public:
+    /// Largest record index that can be stored in a NameHit
+    static constexpr u32 MAX_RECORDS = 1u << 30;
+
+    static bool Build(std::span<const FRDMyData> records, const std::string& path);
+    static bool Build(std::span<const ChecksummedMiiData> records, const std::string& path);
+
+    bool Open(const std::string& path);
+
+    /// Every query returns at most limit hits, ordered by name and then by record
+    [[nodiscard]] std::vector<NameHit> FindExact(std::u16string_view name,
+                                                 std::size_t limit = SIZE_MAX) const;
+    [[nodiscard]] std::vector<NameHit> FindPrefix(std::u16string_view prefix,
+                                                  std::size_t limit = SIZE_MAX) const;
+    [[nodiscard]] std::vector<NameHit> FindSubstring(std::u16string_view needle,
+                                                     std::size_t limit = SIZE_MAX) const;
+
+    [[nodiscard]] std::size_t NameCount() const {
+        return name_count;
+    }
+
+    struct Header;
+    struct NameEntry;
+    struct GramEntry;
+
+private:
+    [[nodiscard]] std::u16string_view Name(std::size_t id) const;
+    void AppendHits(std::size_t id, std::vector<NameHit>& hits, std::size_t limit) const;
+    /// Names containing the gram with this key; empty if there is none or its entry is corrupt
+    [[nodiscard]] std::span<const u32> Postings(u64 key) const;
+
+    MappedFile file;
+    const NameEntry* names = nullptr;
+    const u32* hits = nullptr;
+    const char16_t* pool = nullptr;
+    const GramEntry* grams = nullptr;
+    const u32* postings = nullptr;
+    std::size_t name_count = 0;
+    std::size_t hit_count = 0;
+    std::size_t pool_size = 0;
+    std::size_t gram_count = 0;
+    std::size_t posting_count = 0;
+};
+
+/// Widens an ASCII/Latin-1 string, the inverse of ConvertU16ArrayToString
+[[nodiscard]] std::u16string WidenName(std::string_view name);
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <vector>
+
+/// Number of worker threads used by the parallel helpers
+inline std::size_t ThreadCount() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/**
+ * Splits [0, count) into one contiguous range per worker and calls func(begin, end) for each range
+ * concurrently. Ranges are at least min_grain long, so small inputs run on the calling thread.
+ */
+template <typename Func>
+void ParallelFor(std::size_t count, Func&& func, std::size_t min_grain = 0x1000) {
+    const std::size_t workers =
+        std::clamp<std::size_t>(count / std::max<std::size_t>(min_grain, 1), 1, ThreadCount());
+    const std::size_t chunk = (count + workers - 1) / workers;
+
+    std::vector<std::jthread> threads;
+    for (std::size_t begin = chunk; begin < count; begin += chunk) {
+        threads.emplace_back([&func, begin, end = std::min(count, begin + chunk)] { func(begin, end); });
+    }
+    func(std::size_t{0}, std::min(count, chunk));
+}
+
+/// Sorts one chunk per worker, then merges neighbouring chunks pairwise in parallel
+template <typename T, typename Compare = std::less<>>
+void ParallelSort(std::vector<T>& values, Compare comp = {}) {
+    constexpr std::size_t min_grain = 0x4000;
+    const std::size_t workers =
+        std::clamp<std::size_t>(values.size() / min_grain, 1, ThreadCount());
+    if (workers == 1) {
+        std::sort(values.begin(), values.end(), comp);
+        return;
+    }
+
+    std::vector<std::size_t> bounds;
+    for (std::size_t i = 0; i <= workers; i++) {
+        bounds.push_back(values.size() * i / workers);
+    }
+    ParallelFor(
+        workers,
+        [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; i++) {
+                std::sort(values.begin() + bounds[i], values.begin() + bounds[i + 1], comp);
+            }
+        },
+        1);
+
+    for (std::size_t width = 1; width < workers; width *= 2) {
+        const std::size_t merges = (workers + 2 * width - 1) / (2 * width);
+        ParallelFor(
+            merges,
+            [&](std::size_t begin, std::size_t end) {
+                for (std::size_t i = begin; i < end; i++) {
+                    const std::size_t first = i * 2 * width;
+                    const std::size_t middle = std::min(first + width, workers);
+                    const std::size_t last = std::min(first + 2 * width, workers);
+                    std::inplace_merge(values.begin() + bounds[first], values.begin() + bounds[middle],
+                                       values.begin() + bounds[last], comp);
+                }
+            },
+            1);
+    }
+}
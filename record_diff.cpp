@@ -0,0 +1,107 @@
+#include <bit>
+#include <cstring>
+#include <mutex>
+#include <utility>
+#include "parallel.h"
+#include "record_diff.h"
+
+namespace {
+
+/// Field table index owning each bit of a record, numbered byte * 8 + bit
+template <typename Record>
+using BitOwners = std::array<u16, sizeof(Record) * 8>;
+
+template <typename Record>
+BitOwners<Record> BuildBitOwners() {
+    BitOwners<Record> owners;
+    owners.fill(DiffResult::UNNAMED_FIELD);
+
+    const std::span<const FieldInfo> fields = FieldsOf<Record>();
+    for (std::size_t i = 0; i < fields.size(); i++) {
+        const FieldInfo& field = fields[i];
+        if (field.type == FieldType::Bytes || field.type == FieldType::Utf16) {
+            std::fill_n(owners.begin() + field.offset * 8, field.size * 8, static_cast<u16>(i));
+            continue;
+        }
+        for (std::size_t bit = field.position; bit < field.position + field.bits; bit++) {
+            const std::size_t byte = field.big_endian ? field.offset + field.size - 1 - bit / 8
+                                                      : field.offset + bit / 8;
+            owners[byte * 8 + bit % 8] = static_cast<u16>(i);
+        }
+    }
+    return owners;
+}
+
+template <typename Record>
+DiffResult Diff(std::span<const Record> before, std::span<const Record> after) {
+    static_assert(sizeof(Record) % sizeof(u64) == 0, "Records are compared in 8 byte words");
+    constexpr std::size_t field_count = FieldsOf<Record>().size();
+    constexpr std::size_t words = sizeof(Record) / sizeof(u64);
+    static const BitOwners<Record> owners = BuildBitOwners<Record>();
+
+    std::mutex mutex;
+    std::vector<std::pair<std::size_t, DiffResult>> parts;
+
+    ParallelFor(std::min(before.size(), after.size()), [&](std::size_t begin, std::size_t end) {
+        DiffResult part;
+        part.histogram.assign(field_count + 1, 0);
+
+        for (std::size_t i = begin; i < end; i++) {
+            const auto* a = reinterpret_cast<const u8*>(&before[i]);
+            const auto* b = reinterpret_cast<const u8*>(&after[i]);
+            if (std::memcmp(a, b, sizeof(Record)) == 0) {
+                continue;
+            }
+
+            // One bit per table entry, plus one for UNNAMED_FIELD
+            std::array<u64, (field_count + 1 + 63) / 64> changed{};
+            for (std::size_t word = 0; word < words; word++) {
+                u64 diff = LoadUnsigned(a + word * 8, 8, false) ^ LoadUnsigned(b + word * 8, 8, false);
+                while (diff != 0) {
+                    const u16 owner = owners[word * 64 + std::countr_zero(diff)];
+                    const std::size_t index = owner == DiffResult::UNNAMED_FIELD ? field_count : owner;
+                    changed[index / 64] |= u64{1} << (index % 64);
+                    diff &= diff - 1;
+                }
+            }
+
+            part.changed_records++;
+            for (std::size_t chunk = 0; chunk < changed.size(); chunk++) {
+                for (u64 bits = changed[chunk]; bits != 0; bits &= bits - 1) {
+                    const std::size_t index = chunk * 64 + std::countr_zero(bits);
+                    part.histogram[index]++;
+                    part.changes.push_back(
+                        {static_cast<u32>(i), index == field_count ? DiffResult::UNNAMED_FIELD
+                                                                   : static_cast<u16>(index)});
+                }
+            }
+        }
+
+        std::scoped_lock lock{mutex};
+        parts.emplace_back(begin, std::move(part));
+    });
+
+    std::sort(parts.begin(), parts.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+    DiffResult result;
+    result.histogram.assign(field_count + 1, 0);
+    for (auto& [begin, part] : parts) {
+        result.changes.insert(result.changes.end(), part.changes.begin(), part.changes.end());
+        for (std::size_t i = 0; i <= field_count; i++) {
+            result.histogram[i] += part.histogram[i];
+        }
+        result.changed_records += part.changed_records;
+    }
+    return result;
+}
+
+} // namespace
+
+DiffResult DiffRecords(std::span<const FRDMyData> before, std::span<const FRDMyData> after) {
+    return Diff(before, after);
+}
+
+DiffResult DiffRecords(std::span<const ChecksummedMiiData> before,
+                       std::span<const ChecksummedMiiData> after) {
+    return Diff(before, after);
+}
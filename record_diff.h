@@ -0,0 +1,29 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include "field_table.h"
+
+struct FieldChange {
+    u32 record; ///< Index of the record pair
+    u16 field;  ///< Index into the record type's field table, or UNNAMED_FIELD
+};
+
+struct DiffResult {
+    /// Bits that changed outside of every named field, such as unused BitField union bits
+    static constexpr u16 UNNAMED_FIELD = 0xFFFF;
+
+    std::vector<FieldChange> changes; ///< Ordered by record, then by field layout order
+    std::vector<u64> histogram;       ///< Changed records per field; the last entry is UNNAMED_FIELD
+    u64 changed_records = 0;
+};
+
+/**
+ * Compares before[i] with after[i] field by field. Records are XORed eight bytes at a time, so
+ * unchanged records and words are skipped cheaply; only differing bits are mapped back to the
+ * fields of FieldsOf<Record>(). Extra records in the longer span are ignored.
+ */
+[[nodiscard]] DiffResult DiffRecords(std::span<const FRDMyData> before,
+                                     std::span<const FRDMyData> after);
+[[nodiscard]] DiffResult DiffRecords(std::span<const ChecksummedMiiData> before,
+                                     std::span<const ChecksummedMiiData> after);
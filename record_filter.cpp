@@ -0,0 +1,446 @@
+#include <cctype>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include "parallel.h"
+#include "record_filter.h"
+
+namespace {
+
+constexpr std::size_t BLOCK_SIZE = 64;
+constexpr std::size_t LANES = 8;
+
+/// Eight u64 lanes; GCC lowers this to AVX2 or to SSE2 register groups depending on the target
+typedef u64 WordVector __attribute__((vector_size(LANES * sizeof(u64))));
+
+u64 LoadWindow(const u8* record, const RecordFilter::Test& test) {
+    u64 window;
+    std::memcpy(&window, record + test.window, sizeof(window));
+#if COMMON_BIG_ENDIAN
+    window = Common::swap64(window);
+#endif
+    return test.byte_swap ? Common::swap64(window) : window;
+}
+
+bool Matches(const u8* record, const RecordFilter::Test& test) {
+    const u64 masked = LoadWindow(record, test) & test.mask;
+    switch (test.op) {
+    case RecordFilter::CompareOp::Equal:
+        return masked == test.value;
+    case RecordFilter::CompareOp::NotEqual:
+        return masked != test.value;
+    case RecordFilter::CompareOp::Less:
+        return masked < test.value;
+    case RecordFilter::CompareOp::LessEqual:
+        return masked <= test.value;
+    case RecordFilter::CompareOp::Greater:
+        return masked > test.value;
+    default:
+        return masked >= test.value;
+    }
+}
+
+template <RecordFilter::CompareOp Op>
+[[gnu::always_inline]] inline u64 MatchBlock(const u8* records, std::size_t stride, const RecordFilter::Test& test) {
+    using enum RecordFilter::CompareOp;
+    u64 bits = 0;
+    for (std::size_t i = 0; i < BLOCK_SIZE; i += LANES) {
+        WordVector masked;
+        for (std::size_t lane = 0; lane < LANES; lane++) {
+            masked[lane] = LoadWindow(records + (i + lane) * stride, test) & test.mask;
+        }
+        const WordVector value = WordVector{} + test.value;
+        WordVector result;
+        if constexpr (Op == Equal) {
+            result = masked == value;
+        } else if constexpr (Op == NotEqual) {
+            result = masked != value;
+        } else if constexpr (Op == Less) {
+            result = masked < value;
+        } else if constexpr (Op == LessEqual) {
+            result = masked <= value;
+        } else if constexpr (Op == Greater) {
+            result = masked > value;
+        } else {
+            result = masked >= value;
+        }
+        for (std::size_t lane = 0; lane < LANES; lane++) {
+            bits |= (result[lane] & 1) << (i + lane);
+        }
+    }
+    return bits;
+}
+
+/// Bitmap of the records in a full block of BLOCK_SIZE records that pass test
+__attribute__((target_clones("avx2", "default"))) u64
+MatchFullBlock(const u8* records, std::size_t stride, const RecordFilter::Test& test) {
+    using enum RecordFilter::CompareOp;
+    switch (test.op) {
+    case Equal:
+        return MatchBlock<Equal>(records, stride, test);
+    case NotEqual:
+        return MatchBlock<NotEqual>(records, stride, test);
+    case Less:
+        return MatchBlock<Less>(records, stride, test);
+    case LessEqual:
+        return MatchBlock<LessEqual>(records, stride, test);
+    case Greater:
+        return MatchBlock<Greater>(records, stride, test);
+    default:
+        return MatchBlock<GreaterEqual>(records, stride, test);
+    }
+}
+
+bool IsIdentifierChar(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.';
+}
+
+} // namespace
+
+/// Recursive descent parser producing a tree, which is then merged and flattened to postfix
+class RecordFilterCompiler {
+public:
+    RecordFilterCompiler(std::string_view text_, std::span<const FieldInfo> fields_,
+                         std::size_t record_size_)
+        : text(text_), fields(fields_), record_size(record_size_) {}
+
+    std::optional<RecordFilter> Compile(std::string* error) {
+        std::optional<Node> root = ParseOr();
+        SkipSpace();
+        if (root && position != text.size()) {
+            Fail("unexpected '" + std::string(text.substr(position, 1)) + "'");
+        }
+        if (!root || !message.empty()) {
+            if (error) {
+                *error = message + " at offset " + std::to_string(position);
+            }
+            return std::nullopt;
+        }
+
+        RecordFilter filter;
+        filter.record_size = record_size;
+        std::size_t depth = 0;
+        Emit(*root, filter, depth);
+        return filter;
+    }
+
+private:
+    enum class Kind : u8 { Compare, And, Or, Not };
+
+    struct Node {
+        Kind kind;
+        RecordFilter::Test test{};
+        std::vector<Node> children;
+    };
+
+    void SkipSpace() {
+        while (position < text.size() && std::isspace(static_cast<unsigned char>(text[position]))) {
+            position++;
+        }
+    }
+
+    bool Accept(std::string_view token) {
+        SkipSpace();
+        if (text.substr(position, token.size()) == token) {
+            position += token.size();
+            return true;
+        }
+        return false;
+    }
+
+    std::nullopt_t Fail(std::string text_) {
+        if (message.empty()) {
+            message = std::move(text_);
+        }
+        return std::nullopt;
+    }
+
+    std::optional<Node> ParseBinary(Kind kind, std::string_view token,
+                                    std::optional<Node> (RecordFilterCompiler::*operand)()) {
+        std::optional<Node> first = (this->*operand)();
+        if (!first) {
+            return std::nullopt;
+        }
+        Node node{kind};
+        node.children.push_back(std::move(*first));
+        while (Accept(token)) {
+            std::optional<Node> next = (this->*operand)();
+            if (!next) {
+                return std::nullopt;
+            }
+            // Flatten a || (b || c) and parenthesised chains into one n-ary node
+            if (next->kind == kind) {
+                for (Node& child : next->children) {
+                    node.children.push_back(std::move(child));
+                }
+            } else {
+                node.children.push_back(std::move(*next));
+            }
+        }
+        if (node.children.size() == 1) {
+            return std::move(node.children[0]);
+        }
+        return node;
+    }
+
+    std::optional<Node> ParseOr() {
+        return ParseBinary(Kind::Or, "||", &RecordFilterCompiler::ParseAnd);
+    }
+
+    std::optional<Node> ParseAnd() {
+        return ParseBinary(Kind::And, "&&", &RecordFilterCompiler::ParseUnary);
+    }
+
+    std::optional<Node> ParseUnary() {
+        if (Accept("!")) {
+            if (text.substr(position, 1) == "=") {
+                return Fail("expected a field name");
+            }
+            std::optional<Node> child = ParseUnary();
+            if (!child) {
+                return std::nullopt;
+            }
+            Node node{Kind::Not};
+            node.children.push_back(std::move(*child));
+            return node;
+        }
+        if (Accept("(")) {
+            std::optional<Node> node = ParseOr();
+            if (!node) {
+                return std::nullopt;
+            }
+            if (!Accept(")")) {
+                return Fail("expected ')'");
+            }
+            return node;
+        }
+        return ParseComparison();
+    }
+
+    std::optional<Node> ParseComparison() {
+        SkipSpace();
+        const std::size_t start = position;
+        while (position < text.size() && IsIdentifierChar(text[position])) {
+            position++;
+        }
+        const std::string_view name = text.substr(start, position - start);
+        if (name.empty()) {
+            return Fail("expected a field name");
+        }
+        const std::optional<std::size_t> index = ResolveComparable(name);
+        if (!index) {
+            position = start;
+            return std::nullopt;
+        }
+        const FieldInfo& field = fields[*index];
+
+        RecordFilter::CompareOp op;
+        if (Accept("==")) {
+            op = RecordFilter::CompareOp::Equal;
+        } else if (Accept("!=")) {
+            op = RecordFilter::CompareOp::NotEqual;
+        } else if (Accept("<=")) {
+            op = RecordFilter::CompareOp::LessEqual;
+        } else if (Accept(">=")) {
+            op = RecordFilter::CompareOp::GreaterEqual;
+        } else if (Accept("<")) {
+            op = RecordFilter::CompareOp::Less;
+        } else if (Accept(">")) {
+            op = RecordFilter::CompareOp::Greater;
+        } else {
+            return Fail("expected a comparison operator");
+        }
+
+        SkipSpace();
+        int base = 10;
+        if (text.substr(position, 2) == "0x" || text.substr(position, 2) == "0X") {
+            position += 2;
+            base = 16;
+        }
+        u64 value = 0;
+        const auto [end, result] =
+            std::from_chars(text.data() + position, text.data() + text.size(), value, base);
+        if (result != std::errc{}) {
+            return Fail("expected a number");
+        }
+        position = end - text.data();
+        if (value > FieldValueMask(field)) {
+            return Fail("value out of range for " + std::string(field.name));
+        }
+
+        Node node{Kind::Compare};
+        node.test = MakeTest(field, op, value);
+        return node;
+    }
+
+    std::optional<std::size_t> ResolveComparable(std::string_view name) {
+        const std::optional<std::size_t> index = ResolveField(fields, name);
+        if (!index) {
+            return Fail("unknown or ambiguous field " + std::string(name));
+        }
+        return CheckComparable(*index);
+    }
+
+    std::optional<std::size_t> CheckComparable(std::size_t index) {
+        if (fields[index].type != FieldType::Unsigned && fields[index].type != FieldType::BitField) {
+            return Fail(std::string(fields[index].name) + " is an array and cannot be compared");
+        }
+        return index;
+    }
+
+    /// Places field in an 8 byte window of the record and pre-shifts mask and value into it
+    RecordFilter::Test MakeTest(const FieldInfo& field, RecordFilter::CompareOp op, u64 value) {
+        RecordFilter::Test test{};
+        test.window = static_cast<u16>(std::min<std::size_t>(field.offset, record_size - 8));
+        test.op = op;
+        const std::size_t byte = field.offset - test.window;
+
+        // A big endian storage word becomes a contiguous little endian integer once the whole
+        // window is byte swapped
+        test.byte_swap = field.big_endian;
+        const std::size_t shift = 8 * (field.big_endian ? 8 - byte - field.size : byte);
+        test.mask = (FieldValueMask(field) << field.position) << shift;
+        test.value = (value << field.position) << shift;
+
+        // Equality does not depend on bit order, so leave the window unswapped where it can be merged
+        if ((op == RecordFilter::CompareOp::Equal || op == RecordFilter::CompareOp::NotEqual) &&
+            test.byte_swap) {
+            test.byte_swap = false;
+            test.mask = Common::swap64(test.mask);
+            test.value = Common::swap64(test.value);
+        }
+        return test;
+    }
+
+    /**
+     * Merges equality tests of an AND (or inequality tests of an OR) that fit one window and do
+     * not disagree on shared bits: (w & m1) == v1 && (w & m2) == v2 is (w & (m1 | m2)) == (v1 | v2).
+     */
+    void MergeTests(std::vector<Node>& children, RecordFilter::CompareOp op) {
+        const auto mergeable = [op](const Node& node) {
+            return node.kind == Kind::Compare && node.test.op == op && !node.test.byte_swap;
+        };
+        const auto merge = [](RecordFilter::Test& into, const RecordFilter::Test& test) {
+            // Move test into the other window; none of its bits may fall outside of it
+            const int delta = test.window - into.window;
+            if (delta <= -8 || delta >= 8) {
+                return false;
+            }
+            const int shift = 8 * std::abs(delta);
+            const u64 mask = delta >= 0 ? test.mask << shift : test.mask >> shift;
+            const u64 value = delta >= 0 ? test.value << shift : test.value >> shift;
+            const u64 back = delta >= 0 ? mask >> shift : mask << shift;
+            if (back != test.mask || ((into.value ^ value) & into.mask & mask) != 0) {
+                return false;
+            }
+            into.mask |= mask;
+            into.value |= value;
+            return true;
+        };
+
+        std::vector<Node> merged;
+        for (Node& child : children) {
+            if (mergeable(child) && std::any_of(merged.begin(), merged.end(), [&](Node& other) {
+                    return mergeable(other) && merge(other.test, child.test);
+                })) {
+                continue;
+            }
+            merged.push_back(std::move(child));
+        }
+        children = std::move(merged);
+    }
+
+    void Emit(Node& node, RecordFilter& filter, std::size_t& depth) {
+        switch (node.kind) {
+        case Kind::Compare:
+            filter.program.push_back({RecordFilter::Opcode::Test, static_cast<u16>(filter.tests.size())});
+            filter.tests.push_back(node.test);
+            filter.stack_depth = std::max(filter.stack_depth, ++depth);
+            return;
+        case Kind::Not:
+            Emit(node.children[0], filter, depth);
+            filter.program.push_back({RecordFilter::Opcode::Not, 0});
+            return;
+        default: {
+            const bool is_and = node.kind == Kind::And;
+            MergeTests(node.children,
+                       is_and ? RecordFilter::CompareOp::Equal : RecordFilter::CompareOp::NotEqual);
+            const RecordFilter::Opcode opcode = is_and ? RecordFilter::Opcode::And
+                                                       : RecordFilter::Opcode::Or;
+            for (std::size_t i = 0; i < node.children.size(); i++) {
+                Emit(node.children[i], filter, depth);
+                if (i != 0) {
+                    filter.program.push_back({opcode, 0});
+                    depth--;
+                }
+            }
+            return;
+        }
+        }
+    }
+
+    std::string_view text;
+    std::span<const FieldInfo> fields;
+    std::size_t record_size;
+    std::size_t position = 0;
+    std::string message;
+};
+
+std::optional<RecordFilter> RecordFilter::Compile(std::string_view expression,
+                                                  std::span<const FieldInfo> fields,
+                                                  std::size_t record_size, std::string* error) {
+    assert(record_size >= 8);
+    return RecordFilterCompiler(expression, fields, record_size).Compile(error);
+}
+
+std::vector<u64> RecordFilter::Select(std::span<const u8> records) const {
+    const std::size_t count = records.size() / record_size;
+    const std::size_t blocks = (count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    std::vector<u64> bitmap(blocks);
+
+    ParallelFor(
+        blocks,
+        [&](std::size_t begin, std::size_t end) {
+            std::vector<u64> test_bits(tests.size());
+            std::vector<u64> stack(stack_depth);
+
+            for (std::size_t block = begin; block < end; block++) {
+                const u8* first = records.data() + block * BLOCK_SIZE * record_size;
+                const std::size_t size = std::min(BLOCK_SIZE, count - block * BLOCK_SIZE);
+                for (std::size_t t = 0; t < tests.size(); t++) {
+                    if (size == BLOCK_SIZE) {
+                        test_bits[t] = MatchFullBlock(first, record_size, tests[t]);
+                        continue;
+                    }
+                    test_bits[t] = 0;
+                    for (std::size_t i = 0; i < size; i++) {
+                        test_bits[t] |= u64{Matches(first + i * record_size, tests[t])} << i;
+                    }
+                }
+
+                std::size_t top = 0;
+                for (const Instruction& instruction : program) {
+                    switch (instruction.opcode) {
+                    case Opcode::Test:
+                        stack[top++] = test_bits[instruction.test];
+                        break;
+                    case Opcode::And:
+                        top--;
+                        stack[top - 1] &= stack[top];
+                        break;
+                    case Opcode::Or:
+                        top--;
+                        stack[top - 1] |= stack[top];
+                        break;
+                    case Opcode::Not:
+                        stack[top - 1] = ~stack[top - 1];
+                        break;
+                    }
+                }
+                const u64 valid = size == BLOCK_SIZE ? ~u64{0} : (u64{1} << size) - 1;
+                bitmap[block] = stack[0] & valid;
+            }
+        },
+        0x40);
+    return bitmap;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <bit>
+#include <cassert>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "field_table.h"
+
+/**
+ * Filter expression compiled to tests on the packed bytes of a record, so records are never decoded.
+ *
+ * Grammar: comparisons "field op value" joined with &&, || and !, grouped with parentheses.
+ * op is one of == != < <= > >=, value is decimal or 0x-prefixed hex and field is a name from the
+ * record's field table, or any unambiguous dotted suffix of one ("region_lock" for
+ * "mii_data.mii_options.region_lock"). Only Unsigned and BitField fields can be compared.
+ *
+ * Each comparison becomes "load 8 bytes, optionally byte swap, AND mask, compare with a pre-shifted
+ * constant". Equality tests ANDed together (and inequality tests ORed together) that fall in the same
+ * 8 byte window are merged into a single test.
+ */
+class RecordFilter {
+public:
+    enum class CompareOp : u8 { Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual };
+
+    /// One compiled comparison: (window & mask) op value
+    struct Test {
+        u16 window;     ///< Byte offset of the 8 byte little endian window in the record
+        bool byte_swap; ///< Byte swap the window first, for ordered tests on big endian fields
+        CompareOp op;
+        u64 mask;
+        u64 value;
+    };
+
+    /**
+     * Compiles expression against the field table of a record of record_size bytes. On failure,
+     * returns nullopt and stores a description of the problem in error, if given.
+     */
+    [[nodiscard]] static std::optional<RecordFilter> Compile(std::string_view expression,
+                                                             std::span<const FieldInfo> fields,
+                                                             std::size_t record_size,
+                                                             std::string* error = nullptr);
+
+    template <typename Record>
+    [[nodiscard]] static std::optional<RecordFilter> Compile(std::string_view expression,
+                                                             std::string* error = nullptr) {
+        return Compile(expression, FieldsOf<Record>(), sizeof(Record), error);
+    }
+
+    /**
+     * Selection bitmap over records of record_size bytes each: bit i % 64 of word i / 64 is set if
+     * record i matches. Blocks of 64 records are evaluated in SIMD lanes on all worker threads.
+     */
+    [[nodiscard]] std::vector<u64> Select(std::span<const u8> records) const;
+
+    template <typename Record>
+    [[nodiscard]] std::vector<u64> Select(std::span<const Record> records) const {
+        assert(sizeof(Record) == record_size);
+        return Select(std::span(reinterpret_cast<const u8*>(records.data()), records.size_bytes()));
+    }
+
+    [[nodiscard]] std::span<const Test> Tests() const {
+        return tests;
+    }
+
+private:
+    enum class Opcode : u8 { Test, And, Or, Not };
+
+    /// Postfix program over per-test bitmaps
+    struct Instruction {
+        Opcode opcode;
+        u16 test; ///< Index into tests for Opcode::Test
+    };
+
+    friend class RecordFilterCompiler;
+
+    std::vector<Test> tests;
+    std::vector<Instruction> program;
+    std::size_t record_size = 0;
+    std::size_t stack_depth = 0;
+};
+
+/// Number of records selected by a bitmap from RecordFilter::Select
+[[nodiscard]] inline u64 CountSelected(std::span<const u64> bitmap) {
+    return std::accumulate(bitmap.begin(), bitmap.end(), u64{0},
+                           [](u64 count, u64 word) { return count + std::popcount(word); });
+}
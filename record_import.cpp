@@ -0,0 +1,722 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <immintrin.h>
+#include "crc16.h"
+#include "parallel.h"
+#include "record_import.h"
+
+namespace {
+
+constexpr std::size_t BLOCK_SIZE = 64;
+
+/// For each byte of a 64 byte block, whether it is one of the characters the scanner looks for
+struct BlockMasks {
+    u64 quote = 0;
+    u64 backslash = 0; ///< NDJSON only
+    u64 newline = 0;
+    u64 delimiter = 0; ///< ',' for CSV, and ':', '{' and '}' too for NDJSON
+};
+
+// Classification compares a whole block with each character at once. The AVX2 kernels take the
+// block by pointer: loads of the same address are merged once EqualMask is inlined.
+
+__attribute__((target("avx2"), always_inline)) inline u64 EqualMask(const char* block, char c) {
+    const __m256i value = _mm256_set1_epi8(c);
+    const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+    return static_cast<u32>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, value))) |
+           u64{static_cast<u32>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, value)))} << 32;
+}
+
+__attribute__((target("avx2"))) void ClassifyJsonAvx2(const char* block, BlockMasks& masks) {
+    masks.quote = EqualMask(block, '"');
+    masks.backslash = EqualMask(block, '\\');
+    masks.newline = EqualMask(block, '\n');
+    masks.delimiter = EqualMask(block, ',') | EqualMask(block, ':') | EqualMask(block, '{') |
+                      EqualMask(block, '}');
+}
+
+__attribute__((target("avx2"))) void ClassifyCsvAvx2(const char* block, BlockMasks& masks) {
+    masks.quote = EqualMask(block, '"');
+    masks.newline = EqualMask(block, '\n');
+    masks.delimiter = EqualMask(block, ',');
+}
+
+template <bool Json>
+void ClassifyPortable(const char* block, BlockMasks& masks) {
+    for (std::size_t i = 0; i < BLOCK_SIZE; i++) {
+        const u64 bit = u64{1} << i;
+        switch (block[i]) {
+        case '"':
+            masks.quote |= bit;
+            break;
+        case '\n':
+            masks.newline |= bit;
+            break;
+        case ',':
+            masks.delimiter |= bit;
+            break;
+        case '\\':
+            masks.backslash |= Json ? bit : 0;
+            break;
+        case ':':
+        case '{':
+        case '}':
+            masks.delimiter |= Json ? bit : 0;
+            break;
+        }
+    }
+}
+
+/// Bit i of the result is the XOR of bits 0 to i, so quoted bytes are set from an opening quote on
+__attribute__((target("pclmul"))) u64 PrefixXorClmul(u64 bits) {
+    const __m128i product =
+        _mm_clmulepi64_si128(_mm_set_epi64x(0, static_cast<s64>(bits)), _mm_set1_epi8(-1), 0);
+    return static_cast<u64>(_mm_cvtsi128_si64(product));
+}
+
+u64 PrefixXorPortable(u64 bits) {
+    for (int shift = 1; shift < 64; shift *= 2) {
+        bits ^= bits << shift;
+    }
+    return bits;
+}
+
+bool HasAvx2() {
+    static const bool supported =
+        __builtin_cpu_supports("avx2") && __builtin_cpu_supports("pclmul");
+    return supported;
+}
+
+/**
+ * Bytes escaped by a backslash: those after an odd length run of backslashes, found for a whole
+ * block with the carry of an addition as in simdjson. carry is set if the first byte of the next
+ * block is escaped.
+ */
+u64 FindEscaped(u64 backslash, u64& carry) {
+    constexpr u64 EVEN_BITS = 0x5555555555555555;
+    backslash &= ~carry;
+    const u64 follows_escape = backslash << 1 | carry;
+    const u64 odd_starts = backslash & ~EVEN_BITS & ~follows_escape;
+    u64 sequences_on_even_bits;
+    carry = __builtin_add_overflow(odd_starts, backslash, &sequences_on_even_bits);
+    const u64 invert_mask = sequences_on_even_bits << 1;
+    return (EVEN_BITS ^ invert_mask) & follows_escape;
+}
+
+/// Finds the structural characters of consecutive blocks, carrying quote and escape state
+class BlockScanner {
+public:
+    explicit BlockScanner(ImportFormat format) : json(format == ImportFormat::Ndjson) {
+        if (HasAvx2()) {
+            classify = json ? ClassifyJsonAvx2 : ClassifyCsvAvx2;
+            prefix_xor = PrefixXorClmul;
+        } else {
+            classify = json ? ClassifyPortable<true> : ClassifyPortable<false>;
+            prefix_xor = PrefixXorPortable;
+        }
+    }
+
+    /**
+     * Delimiters and newlines outside quotes; for NDJSON also the unescaped quotes themselves, so
+     * that the parser sees where strings start and end.
+     */
+    u64 Scan(const char* block) {
+        BlockMasks masks;
+        classify(block, masks);
+        u64 quotes = masks.quote;
+        if (json) {
+            quotes &= ~FindEscaped(masks.backslash, escape_carry);
+        }
+        u64 in_quotes = prefix_xor(quotes) ^ quote_carry;
+        if (json) {
+            // JSON strings cannot contain raw newlines, so a string still open at one is malformed;
+            // ending it there keeps the damage to its own line
+            for (u64 newlines = masks.newline & in_quotes; newlines != 0;
+                 newlines = masks.newline & in_quotes) {
+                const u64 newline = newlines & -newlines;
+                in_quotes ^= ~(newline - 1);
+            }
+        }
+        quote_carry = static_cast<u64>(static_cast<s64>(in_quotes) >> 63);
+        const u64 structural = (masks.delimiter | masks.newline) & ~in_quotes;
+        return json ? structural | quotes : structural;
+    }
+
+    /// Quotes in a block, for placing CSV chunk boundaries
+    u64 Quotes(const char* block) const {
+        BlockMasks masks;
+        classify(block, masks);
+        return masks.quote;
+    }
+
+private:
+    bool json;
+    void (*classify)(const char* block, BlockMasks& masks);
+    u64 (*prefix_xor)(u64 bits);
+    u64 escape_carry = 0;
+    u64 quote_carry = 0;
+};
+
+/// Calls func(position) for every structural character of text[begin, end)
+template <typename Func>
+void ForEachStructural(std::span<const char> text, std::size_t begin, std::size_t end,
+                       BlockScanner& scanner, Func&& func) {
+    for (std::size_t block = begin; block < end; block += BLOCK_SIZE) {
+        u64 structural;
+        if (end - block >= BLOCK_SIZE) {
+            structural = scanner.Scan(text.data() + block);
+        } else {
+            char padded[BLOCK_SIZE];
+            std::memset(padded, ' ', sizeof(padded));
+            std::memcpy(padded, text.data() + block, end - block);
+            structural = scanner.Scan(padded);
+        }
+        for (; structural != 0; structural &= structural - 1) {
+            func(block + std::countr_zero(structural));
+        }
+    }
+}
+
+std::string_view Trim(std::string_view text) {
+    const std::size_t first = text.find_first_not_of(" \t\r");
+    if (first == std::string_view::npos) {
+        return {};
+    }
+    return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+}
+
+std::optional<u32> ParseHex4(std::string_view text) {
+    u32 value = 0;
+    if (text.size() < 4) {
+        return std::nullopt;
+    }
+    for (std::size_t i = 0; i < 4; i++) {
+        const char c = text[i];
+        const u32 digit = c >= '0' && c <= '9'   ? c - '0'
+                          : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                          : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                                                 : 16;
+        if (digit == 16) {
+            return std::nullopt;
+        }
+        value = value << 4 | digit;
+    }
+    return value;
+}
+
+/// Decodes the escapes of the contents of a JSON string into UTF-8
+bool UnescapeJson(std::string_view text, std::string& out) {
+    out.clear();
+    for (std::size_t i = 0; i < text.size(); i++) {
+        if (text[i] != '\\') {
+            out += text[i];
+            continue;
+        }
+        if (++i == text.size()) {
+            return false;
+        }
+        switch (text[i]) {
+        case '"':
+        case '\\':
+        case '/':
+            out += text[i];
+            break;
+        case 'b':
+            out += '\b';
+            break;
+        case 'f':
+            out += '\f';
+            break;
+        case 'n':
+            out += '\n';
+            break;
+        case 'r':
+            out += '\r';
+            break;
+        case 't':
+            out += '\t';
+            break;
+        case 'u': {
+            std::optional<u32> code_point = ParseHex4(text.substr(i + 1));
+            if (!code_point) {
+                return false;
+            }
+            i += 4;
+            if (*code_point >= 0xD800 && *code_point < 0xDC00) {
+                const std::optional<u32> low = text.substr(i + 1, 2) == "\\u"
+                                                   ? ParseHex4(text.substr(i + 3))
+                                                   : std::nullopt;
+                if (!low || *low < 0xDC00 || *low >= 0xE000) {
+                    return false;
+                }
+                code_point = 0x10000 + ((*code_point - 0xD800) << 10 | (*low - 0xDC00));
+                i += 6;
+            } else if (*code_point >= 0xDC00 && *code_point < 0xE000) {
+                return false;
+            }
+            char bytes[4];
+            out.append(bytes, EncodeUtf8(bytes, *code_point));
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Splits the CSV row text into fields, removing quotes; false if a quoted field is unterminated
+bool SplitCsvRow(std::string_view text, std::vector<std::string>& fields) {
+    fields.clear();
+    std::string field;
+    bool quoted = false;
+    for (std::size_t i = 0; i <= text.size(); i++) {
+        const char c = i < text.size() ? text[i] : ',';
+        if (quoted) {
+            if (c == '"' && i + 1 < text.size() && text[i + 1] == '"') {
+                field += '"';
+                i++;
+            } else if (c == '"') {
+                quoted = false;
+            } else if (i == text.size()) {
+                return false;
+            } else {
+                field += c;
+            }
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            fields.push_back(std::string(Trim(field)));
+            field.clear();
+        } else {
+            field += c;
+        }
+    }
+    return true;
+}
+
+/// Records and bookkeeping of one chunk, merged in order at the end
+struct ChunkOutput {
+    std::vector<u8> records;
+    u64 record_count = 0;
+    u64 rejected = 0;
+    u64 rows = 0;              ///< Rows seen, including blank and rejected ones
+    u64 first_error_row = 0;   ///< Chunk relative, counting from 1
+    std::string first_error;
+};
+
+/// Parses the rows of one chunk into packed records
+class ChunkParser {
+public:
+    ChunkParser(std::span<const char> text, ImportFormat format, const ImportTarget& target,
+                std::span<const std::optional<FieldAccessor>> columns, ChunkOutput& output)
+        : text(text), format(format), target(target), columns(columns), output(output),
+          scanner(format) {}
+
+    void Parse(std::size_t begin, std::size_t end) {
+        field_start = token_end = begin;
+        BeginRow();
+        ForEachStructural(text, begin, end, scanner, [&](std::size_t position) {
+            if (format == ImportFormat::Ndjson) {
+                OnJson(position);
+            } else {
+                OnCsv(position);
+            }
+        });
+        // A last row without a trailing newline, which for CSV may end with an empty field
+        const bool pending =
+            end > field_start && !Trim({text.data() + field_start, end - field_start}).empty();
+        if (format == ImportFormat::Ndjson && pending) {
+            OnJson(end, '\n');
+        } else if (format == ImportFormat::Csv && (pending || column != 0)) {
+            OnCsv(end, '\n');
+        } else if (state != State::RowStart || column != 0) {
+            Fail("unexpected end of input");
+            EndRow();
+        }
+        output.records.resize(record_offset);
+    }
+
+private:
+    enum class State : u8 {
+        RowStart,     ///< NDJSON: expecting '{'
+        Key,          ///< Expecting the opening quote of a key, or '}'
+        InKey,        ///< Expecting the closing quote of a key
+        Colon,        ///< Expecting ':'
+        Value,        ///< Expecting a string, or a scalar up to ',' or '}'
+        InString,     ///< Expecting the closing quote of a string value
+        AfterValue,   ///< Expecting ',' or '}'
+        RowEnd,       ///< Expecting the end of the line
+        Skip,         ///< Row rejected, skipping to the end of the line
+    };
+
+    u8* Record() {
+        return output.records.data() + record_offset;
+    }
+
+    void BeginRow() {
+        if (output.records.size() < record_offset + target.record_size) {
+            output.records.resize(std::max(output.records.size() * 2,
+                                           record_offset + target.record_size));
+        }
+        std::memcpy(Record(), target.defaults.data(), target.record_size);
+        state = State::RowStart;
+        column = 0;
+        row_has_fields = false;
+    }
+
+    void EndRow() {
+        output.rows++;
+        if (state == State::Skip) {
+            output.rejected++;
+        } else {
+            u8* mii = Record() + target.mii_offset;
+            const u16 crc = Crc16(std::as_bytes(std::span(mii, offsetof(ChecksummedMiiData, crc16))));
+            StoreUnsigned(mii + offsetof(ChecksummedMiiData, crc16), sizeof(u16), true, crc);
+            record_offset += target.record_size;
+            output.record_count++;
+        }
+        BeginRow();
+    }
+
+    void Fail(std::string message) {
+        if (state == State::Skip) {
+            return;
+        }
+        if (output.first_error.empty()) {
+            output.first_error_row = output.rows + 1;
+            output.first_error = std::move(message);
+        }
+        state = State::Skip;
+    }
+
+    void Store(const FieldAccessor& accessor, std::string_view value) {
+        std::string error;
+        if (!ParseField(Record(), accessor, value, &error)) {
+            Fail(std::move(error));
+        }
+    }
+
+    void OnJson(std::size_t position) {
+        OnJson(position, text[position]);
+    }
+
+    void OnJson(std::size_t position, char c) {
+        // Outside strings and scalars, only whitespace may separate structural characters
+        const bool blank_gap = Trim({text.data() + token_end, position - token_end}).empty();
+        token_end = position + 1;
+        if (c == '\n') {
+            if (state == State::RowEnd && blank_gap) {
+                EndRow();
+            } else if (state == State::RowEnd) {
+                Fail("expected the end of the line");
+                EndRow();
+            } else if (state == State::RowStart &&
+                       Trim({text.data() + field_start, position - field_start}).empty()) {
+                output.rows++; // Blank line
+            } else {
+                Fail("incomplete object");
+                EndRow();
+            }
+            field_start = position + 1;
+            return;
+        }
+        switch (state) {
+        case State::RowStart:
+            if (c != '{' || !blank_gap) {
+                return Fail("expected an object");
+            }
+            state = State::Key;
+            break;
+        case State::Key:
+            if (!blank_gap) {
+                return Fail("expected a key");
+            }
+            if (c == '"') {
+                field_start = position + 1;
+                state = State::InKey;
+            } else if (c == '}' && !row_has_fields) {
+                state = State::RowEnd;
+            } else {
+                return Fail("expected a key");
+            }
+            break;
+        case State::InKey: {
+            const std::string_view key(text.data() + field_start, position - field_start);
+            if (key.find('\\') != std::string_view::npos) {
+                if (!UnescapeJson(key, scratch)) {
+                    return Fail("invalid escape in key");
+                }
+                accessor = target.find_field(scratch);
+            } else {
+                accessor = target.find_field(key);
+            }
+            if (!accessor) {
+                return Fail("unknown or ambiguous field " + std::string(key));
+            }
+            state = State::Colon;
+            break;
+        }
+        case State::Colon:
+            if (c != ':' || !blank_gap) {
+                return Fail("expected ':'");
+            }
+            field_start = position + 1;
+            state = State::Value;
+            break;
+        case State::Value:
+            if (c == '"' && Trim({text.data() + field_start, position - field_start}).empty()) {
+                field_start = position + 1;
+                state = State::InString;
+                break;
+            }
+            if (c != ',' && c != '}') {
+                return Fail("expected a value");
+            }
+            StoreScalar(Trim({text.data() + field_start, position - field_start}));
+            if (state != State::Skip) {
+                state = c == ',' ? State::Key : State::RowEnd;
+            }
+            break;
+        case State::InString: {
+            const std::string_view value(text.data() + field_start, position - field_start);
+            if (value.find('\\') != std::string_view::npos) {
+                if (!UnescapeJson(value, scratch)) {
+                    return Fail("invalid escape in string");
+                }
+                Store(*accessor, scratch);
+            } else {
+                Store(*accessor, value);
+            }
+            if (state != State::Skip) {
+                row_has_fields = true;
+                state = State::AfterValue;
+            }
+            break;
+        }
+        case State::AfterValue:
+            if (!blank_gap) {
+                return Fail("expected ',' or '}'");
+            }
+            if (c == ',') {
+                state = State::Key;
+            } else if (c == '}') {
+                state = State::RowEnd;
+            } else {
+                return Fail("expected ',' or '}'");
+            }
+            break;
+        case State::RowEnd:
+            return Fail("expected the end of the line");
+        case State::Skip:
+            break;
+        }
+    }
+
+    void StoreScalar(std::string_view value) {
+        if (value.empty()) {
+            return Fail("expected a value");
+        }
+        row_has_fields = true;
+        if (value == "null") {
+            return;
+        }
+        Store(*accessor, value == "true" ? "1" : value == "false" ? "0" : value);
+    }
+
+    void OnCsv(std::size_t position) {
+        OnCsv(position, text[position]);
+    }
+
+    void OnCsv(std::size_t position, char c) {
+        if (state != State::Skip) {
+            StoreCsvField(std::string_view(text.data() + field_start, position - field_start),
+                          c == '\n');
+        }
+        field_start = position + 1;
+        if (c == '\n') {
+            if (state != State::Skip && column != 0 && column != columns.size()) {
+                Fail("expected " + std::to_string(columns.size()) + " fields");
+            }
+            if (column == 0 && state != State::Skip) {
+                output.rows++; // Blank line
+                BeginRow();
+            } else {
+                EndRow();
+            }
+        }
+    }
+
+    void StoreCsvField(std::string_view field, bool last) {
+        field = Trim(field);
+        if (last && column == 0 && field.empty()) {
+            return;
+        }
+        if (column == columns.size()) {
+            return Fail("expected " + std::to_string(columns.size()) + " fields");
+        }
+        const std::optional<FieldAccessor>& column_accessor = columns[column++];
+        if (field.size() >= 2 && field.front() == '"' && field.back() == '"') {
+            field = field.substr(1, field.size() - 2);
+            if (field.find('"') != std::string_view::npos) {
+                scratch.clear();
+                for (std::size_t i = 0; i < field.size(); i++) {
+                    scratch += field[i];
+                    i += field[i] == '"' && i + 1 < field.size() && field[i + 1] == '"';
+                }
+                field = scratch;
+            }
+        } else if (field.find('"') != std::string_view::npos) {
+            return Fail("unbalanced quotes");
+        }
+        row_has_fields = true;
+        if (column_accessor && !field.empty()) {
+            Store(*column_accessor, field);
+        }
+    }
+
+    std::span<const char> text;
+    ImportFormat format;
+    const ImportTarget& target;
+    std::span<const std::optional<FieldAccessor>> columns;
+    ChunkOutput& output;
+    BlockScanner scanner;
+
+    State state = State::RowStart;
+    std::size_t record_offset = 0;
+    std::size_t field_start = 0; ///< Start of the current key, value or CSV field
+    std::size_t token_end = 0;   ///< Just past the last structural character seen in NDJSON
+    std::size_t column = 0;
+    bool row_has_fields = false; ///< Whether a '}' would end the object rather than follow a ','
+    std::optional<FieldAccessor> accessor;
+    std::string scratch; ///< Unescaped text, reused across rows
+};
+
+/// Chunk boundaries at row starts near every multiple of IMPORT_CHUNK_SIZE past begin
+std::vector<std::size_t> ChunkBounds(std::span<const char> text, std::size_t begin,
+                                     ImportFormat format) {
+    const std::size_t chunks = std::max<std::size_t>((text.size() - begin) / IMPORT_CHUNK_SIZE, 1);
+    std::vector<std::size_t> bounds(chunks + 1, text.size());
+    bounds[0] = begin;
+    for (std::size_t i = 1; i < chunks; i++) {
+        bounds[i] = begin + (text.size() - begin) * i / chunks;
+    }
+
+    if (format == ImportFormat::Ndjson) {
+        // Raw newlines cannot appear inside JSON strings, so every newline ends a row
+        for (std::size_t i = 1; i < chunks; i++) {
+            const void* newline = std::memchr(text.data() + bounds[i], '\n', text.size() - bounds[i]);
+            bounds[i] = newline ? static_cast<const char*>(newline) - text.data() + 1 : text.size();
+        }
+    } else {
+        // Quoted CSV fields may contain newlines: find whether each nominal boundary is inside
+        // quotes from the parity of the quotes before it, then skip to a newline outside quotes
+        std::vector<u8> parity(chunks);
+        ParallelFor(
+            chunks,
+            [&](std::size_t first, std::size_t last) {
+                const BlockScanner scanner(format);
+                for (std::size_t i = first; i < last; i++) {
+                    u64 quotes = 0;
+                    std::size_t block = bounds[i];
+                    for (; block + BLOCK_SIZE <= bounds[i + 1]; block += BLOCK_SIZE) {
+                        quotes += std::popcount(scanner.Quotes(text.data() + block));
+                    }
+                    quotes += std::count(text.data() + block, text.data() + bounds[i + 1], '"');
+                    parity[i] = quotes & 1;
+                }
+            },
+            1);
+        bool in_quotes = false;
+        for (std::size_t i = 1; i < chunks; i++) {
+            in_quotes ^= parity[i - 1];
+            std::size_t position = bounds[i];
+            for (bool quoted = in_quotes; position < text.size(); position++) {
+                if (text[position] == '"') {
+                    quoted = !quoted;
+                } else if (text[position] == '\n' && !quoted) {
+                    break;
+                }
+            }
+            bounds[i] = std::min(position + 1, text.size());
+        }
+    }
+    for (std::size_t i = 1; i <= chunks; i++) {
+        bounds[i] = std::max(bounds[i], bounds[i - 1]);
+    }
+    return bounds;
+}
+
+} // namespace
+
+std::optional<ImportResult> ImportRecords(std::span<const char> text, ImportFormat format,
+                                          const ImportTarget& target, std::string* error) {
+    std::size_t begin = 0;
+    u64 header_rows = 0;
+    std::vector<std::optional<FieldAccessor>> columns;
+    if (format == ImportFormat::Csv) {
+        bool quoted = false;
+        std::size_t end = 0;
+        for (; end < text.size() && (quoted || text[end] != '\n'); end++) {
+            quoted ^= text[end] == '"';
+        }
+        std::vector<std::string> names;
+        if (!SplitCsvRow(Trim({text.data(), end}), names)) {
+            if (error) {
+                *error = "unterminated quotes in the header";
+            }
+            return std::nullopt;
+        }
+        for (const std::string& name : names) {
+            std::optional<FieldAccessor>& column = columns.emplace_back();
+            if (!name.empty() && !(column = target.find_field(name))) {
+                if (error) {
+                    *error = "unknown or ambiguous field " + name;
+                }
+                return std::nullopt;
+            }
+        }
+        begin = std::min(end + 1, text.size());
+        header_rows = 1;
+    }
+
+    const std::vector<std::size_t> bounds = ChunkBounds(text, begin, format);
+    const std::size_t chunks = bounds.size() - 1;
+    std::vector<ChunkOutput> outputs(chunks);
+    ParallelFor(
+        chunks,
+        [&](std::size_t first, std::size_t last) {
+            for (std::size_t i = first; i < last; i++) {
+                ChunkParser(text, format, target, columns, outputs[i]).Parse(bounds[i], bounds[i + 1]);
+            }
+        },
+        1);
+
+    ImportResult result;
+    std::vector<std::size_t> offsets(chunks + 1);
+    u64 rows = header_rows;
+    for (std::size_t i = 0; i < chunks; i++) {
+        offsets[i + 1] = offsets[i] + outputs[i].records.size();
+        result.record_count += outputs[i].record_count;
+        result.rejected += outputs[i].rejected;
+        if (result.first_error.empty() && !outputs[i].first_error.empty()) {
+            result.first_error = "row " + std::to_string(rows + outputs[i].first_error_row) + ": " +
+                                 outputs[i].first_error;
+        }
+        rows += outputs[i].rows;
+    }
+    result.records.resize(offsets[chunks]);
+    ParallelFor(
+        chunks,
+        [&](std::size_t first, std::size_t last) {
+            for (std::size_t i = first; i < last; i++) {
+                std::memcpy(result.records.data() + offsets[i], outputs[i].records.data(),
+                            outputs[i].records.size());
+                std::vector<u8>().swap(outputs[i].records);
+            }
+        },
+        1);
+    return result;
+}
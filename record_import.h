@@ -0,0 +1,68 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+#include "field_access.h"
+
+enum class ImportFormat : u8 {
+    Ndjson, ///< One flat JSON object per line, keyed by field path
+    Csv,    ///< A header row of field paths, then one record per row
+};
+
+/// Input is split into chunks of at least this many bytes, one or more per worker thread
+inline constexpr std::size_t IMPORT_CHUNK_SIZE = 0x100000;
+
+struct ImportResult {
+    std::vector<u8> records; ///< Packed records, in input order
+    u64 record_count = 0;
+    u64 rejected = 0;     ///< Rows that failed to parse and were skipped
+    std::string first_error; ///< Row number and problem of the first rejected row
+};
+
+/// Where and how a record type is built by ImportRecords
+struct ImportTarget {
+    std::size_t record_size;
+    std::span<const u8> defaults; ///< Bytes of a default constructed record, for unset fields
+    std::size_t mii_offset;       ///< Offset of the ChecksummedMiiData whose CRC is recomputed
+    std::optional<FieldAccessor> (*find_field)(std::string_view path);
+};
+
+/**
+ * Builds packed records from NDJSON or CSV text. Fields are named as in ResolveField and their
+ * values are parsed by ParseField: integers in decimal or 0x prefixed hex, names as UTF-8 that is
+ * transcoded to UTF-16, byte arrays as hex. JSON values may be numbers, strings, true, false or
+ * null, which leaves the default. Fields missing from a row keep their default value, and the Mii
+ * CRC of every record is recomputed after its fields are written.
+ *
+ * The input is split into chunks at row boundaries that are scanned in parallel. Each chunk runs
+ * a SIMD structural scanner over 64 byte blocks, in the style of simdjson: byte classes are
+ * compared for a whole block at once into bitmasks, quoted text is masked out with a prefix XOR of
+ * the quote bits, and the parser visits only the remaining delimiters. CSV chunk boundaries are
+ * placed outside quoted fields by first counting the quotes of every chunk in parallel.
+ *
+ * Malformed rows are counted and skipped. Returns nullopt and describes the problem in error, if
+ * given, only when the CSV header names an unknown field.
+ */
+[[nodiscard]] std::optional<ImportResult> ImportRecords(std::span<const char> text,
+                                                        ImportFormat format,
+                                                        const ImportTarget& target,
+                                                        std::string* error = nullptr);
+
+template <typename Record>
+[[nodiscard]] std::optional<ImportResult> ImportRecords(std::span<const char> text,
+                                                        ImportFormat format,
+                                                        std::string* error = nullptr) {
+    static constexpr Record defaults{};
+    std::size_t mii_offset = 0;
+    if constexpr (std::is_same_v<Record, FRDMyData>) {
+        mii_offset = offsetof(FRDMyData, mii_data);
+    } else {
+        static_assert(std::is_same_v<Record, ChecksummedMiiData>, "No Mii CRC in this record type");
+    }
+    const ImportTarget target{sizeof(Record),
+                              {reinterpret_cast<const u8*>(&defaults), sizeof(Record)},
+                              mii_offset, FindFieldAccessor<Record>};
+    return ImportRecords(text, format, target, error);
+}
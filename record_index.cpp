@@ -0,0 +1,306 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include "arena.h"
+#include "format.h"
+#include "parallel.h"
+#include "record_index.h"
+
+struct RecordIndex::Header {
+    std::array<char, 8> magic;
+    RecordKey key;
+    u32 block_size;
+    u64 entry_count;
+    u64 block_count;
+    u64 top_offset;
+    u64 blocks_offset; ///< Aligned to BLOCK_SIZE so each block is exactly one page
+    u64 filter_offset; ///< BloomFilter blocks over every key
+    u64 filter_size;
+};
+
+/// First key of a block, zero padded
+struct RecordIndex::TopEntry {
+    KeyBytes key;
+    u32 size;
+};
+
+namespace {
+
+constexpr std::array<char, 8> RECORD_INDEX_MAGIC{'F', 'R', 'D', 'S', 'S', 'T', '2', 0};
+
+int CompareKeys(const u8* a, std::size_t a_size, const u8* b, std::size_t b_size) {
+    const int order = std::memcmp(a, b, std::min(a_size, b_size));
+    return order != 0 ? order : (a_size < b_size ? -1 : a_size > b_size ? 1 : 0);
+}
+
+struct BuildEntry {
+    RecordIndex::KeyBytes key;
+    u8 size;
+    u32 record;
+
+    bool operator<(const BuildEntry& other) const {
+        const int order = CompareKeys(key.data(), size, other.key.data(), other.size);
+        return order != 0 ? order < 0 : record < other.record;
+    }
+};
+
+void StoreBigEndian(u8* out, u64 value, std::size_t size) {
+    for (std::size_t i = 0; i < size; i++) {
+        out[i] = static_cast<u8>(value >> (8 * (size - 1 - i)));
+    }
+}
+
+/// Keys are compared bytewise, so integers are stored big endian
+std::size_t MakeMiiIdentityKey(u64 system_id, u32 mii_id, RecordIndex::KeyBytes& key) {
+    StoreBigEndian(key.data(), system_id, 8);
+    StoreBigEndian(key.data() + 8, mii_id, 4);
+    return 12;
+}
+
+std::size_t MakeFriendCodeSeedKey(u64 seed, RecordIndex::KeyBytes& key) {
+    StoreBigEndian(key.data(), seed, 8);
+    return 8;
+}
+
+void PutVarint(std::vector<u8>& out, u64 value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<u8>(value) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(static_cast<u8>(value));
+}
+
+/// Decodes a varint ending before end, or nothing if it runs past end or 64 bits
+std::optional<u64> GetVarint(const u8*& in, const u8* end) {
+    u64 value = 0;
+    for (int shift = 0; shift < 64 && in != end; shift += 7) {
+        const u8 byte = *in++;
+        value |= u64{byte & 0x7Fu} << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    return std::nullopt;
+}
+
+} // namespace
+
+std::size_t ExtractRecordKey(const FRDMyData& record, RecordKey key, RecordIndex::KeyBytes& out,
+                             Arena& arena) {
+    out.fill(0);
+    switch (key) {
+    case RecordKey::MiiIdentity: {
+        const MiiData& mii = record.mii_data.mii_data;
+        return MakeMiiIdentityKey(mii.system_id, mii.mii_id, out);
+    }
+    case RecordKey::SerialNumber: {
+        const std::string_view serial = FormatSerialNumber(record, arena);
+        const std::size_t size = std::min(serial.size(), RecordIndex::MAX_KEY_SIZE);
+        std::copy_n(serial.begin(), size, out.begin());
+        arena.Reset();
+        return size;
+    }
+    default:
+        return MakeFriendCodeSeedKey(record.local_friend_code_seed, out);
+    }
+}
+
+std::size_t ExtractRecordKey(const ChecksummedMiiData& record, RecordIndex::KeyBytes& out) {
+    out.fill(0);
+    return MakeMiiIdentityKey(record.mii_data.system_id, record.mii_data.mii_id, out);
+}
+
+bool RecordIndex::Build(std::span<const FRDMyData> records, RecordKey key, const std::string& path) {
+    std::vector<BuildEntry> entries(records.size());
+    ParallelFor(records.size(), [&](std::size_t begin, std::size_t end) {
+        Arena arena;
+        for (std::size_t i = begin; i < end; i++) {
+            BuildEntry& entry = entries[i];
+            entry.record = static_cast<u32>(i);
+            entry.size = static_cast<u8>(ExtractRecordKey(records[i], key, entry.key, arena));
+        }
+    });
+    ParallelSort(entries);
+
+    BloomFilter filter(entries.size());
+    for (const BuildEntry& entry : entries) {
+        filter.Insert(BloomHash(std::span(entry.key.data(), entry.size)));
+    }
+
+    // Each block restarts front coding, so it decodes on its own:
+    // u16 count, then per entry varint shared prefix size, varint suffix size, suffix, varint record
+    std::vector<u8> data;
+    std::vector<TopEntry> top;
+    std::vector<u8> block;
+    std::size_t block_entries = 0;
+    const auto finish_block = [&] {
+        block[0] = static_cast<u8>(block_entries);
+        block[1] = static_cast<u8>(block_entries >> 8);
+        block.resize(BLOCK_SIZE);
+        data.insert(data.end(), block.begin(), block.end());
+        block.clear();
+        block_entries = 0;
+    };
+
+    std::vector<u8> encoded;
+    for (std::size_t i = 0; i < entries.size(); i++) {
+        const BuildEntry& entry = entries[i];
+        const BuildEntry* previous = block_entries != 0 ? &entries[i - 1] : nullptr;
+        std::size_t shared = 0;
+        while (previous && shared < std::min(entry.size, previous->size) &&
+               entry.key[shared] == previous->key[shared]) {
+            shared++;
+        }
+
+        encoded.clear();
+        PutVarint(encoded, shared);
+        PutVarint(encoded, entry.size - shared);
+        encoded.insert(encoded.end(), entry.key.begin() + shared, entry.key.begin() + entry.size);
+        PutVarint(encoded, entry.record);
+
+        if (block_entries != 0 && block.size() + encoded.size() > BLOCK_SIZE) {
+            finish_block();
+            // Restart the prefix chain
+            i--;
+            continue;
+        }
+        if (block_entries == 0) {
+            block.assign(2, 0);
+            top.push_back({entry.key, entry.size});
+        }
+        block.insert(block.end(), encoded.begin(), encoded.end());
+        block_entries++;
+    }
+    if (block_entries != 0) {
+        finish_block();
+    }
+
+    Header header{};
+    header.magic = RECORD_INDEX_MAGIC;
+    header.key = key;
+    header.block_size = BLOCK_SIZE;
+    header.entry_count = entries.size();
+    header.block_count = top.size();
+    header.top_offset = sizeof(Header);
+    header.blocks_offset = (header.top_offset + top.size() * sizeof(TopEntry) + BLOCK_SIZE - 1) &
+                           ~u64{BLOCK_SIZE - 1};
+    header.filter_offset = header.blocks_offset + data.size();
+    header.filter_size = filter.Bytes().size();
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    const bool written =
+        WriteSection(file, 0, &header, sizeof(header)) &&
+        WriteSection(file, header.top_offset, top.data(), top.size() * sizeof(TopEntry)) &&
+        WriteSection(file, header.blocks_offset, data.data(), data.size()) &&
+        WriteSection(file, header.filter_offset, filter.Bytes().data(), filter.Bytes().size());
+    return std::fclose(file) == 0 && written;
+}
+
+bool RecordIndex::Open(const std::string& path) {
+    top = nullptr;
+    blocks = nullptr;
+    block_count = entry_count = 0;
+    if (!file.Open(path)) {
+        return false;
+    }
+
+    const std::span<const u8> bytes = file.Bytes();
+    Header header;
+    if (bytes.size() < sizeof(header)) {
+        file.Close();
+        return false;
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (header.magic != RECORD_INDEX_MAGIC || header.block_size != BLOCK_SIZE ||
+        header.key > RecordKey::FriendCodeSeed || header.top_offset != sizeof(Header) ||
+        header.block_count > (bytes.size() - header.top_offset) / sizeof(TopEntry) ||
+        (header.block_count != 0 &&
+         (header.blocks_offset > bytes.size() ||
+          header.block_count > (bytes.size() - header.blocks_offset) / BLOCK_SIZE)) ||
+        header.filter_offset % alignof(BloomFilter::Block) != 0 ||
+        header.filter_offset > bytes.size() ||
+        header.filter_size > bytes.size() - header.filter_offset) {
+        file.Close();
+        return false;
+    }
+
+    key = header.key;
+    filter = BloomFilter::View(bytes.subspan(header.filter_offset, header.filter_size));
+    top = reinterpret_cast<const TopEntry*>(bytes.data() + header.top_offset);
+    blocks = bytes.data() + header.blocks_offset;
+    block_count = header.block_count;
+    entry_count = header.entry_count;
+    return true;
+}
+
+std::vector<u32> RecordIndex::Find(RecordKey kind, std::span<const u8> target) const {
+    std::vector<u32> records;
+    if (kind != key || block_count == 0 || !filter.MayContain(BloomHash(target))) {
+        return records;
+    }
+
+    // Equal keys may continue from the last block starting before target
+    const TopEntry* const first = std::lower_bound(
+        top, top + block_count, target, [](const TopEntry& entry, std::span<const u8> target_) {
+            return CompareKeys(entry.key.data(), entry.size, target_.data(), target_.size()) < 0;
+        });
+    std::size_t block = first == top ? 0 : first - top - 1;
+
+    // Blocks are decoded without trusting their contents: an entry that would overrun its block
+    // ends the query with no results
+    KeyBytes current{};
+    for (; block < block_count; block++) {
+        const u8* in = blocks + block * BLOCK_SIZE;
+        const u8* const end = in + BLOCK_SIZE;
+        const std::size_t count = in[0] | std::size_t{in[1]} << 8;
+        in += 2;
+        for (std::size_t i = 0; i < count; i++) {
+            const std::optional<u64> shared = GetVarint(in, end);
+            const std::optional<u64> suffix = GetVarint(in, end);
+            if (!shared || !suffix || *shared > MAX_KEY_SIZE || *suffix > MAX_KEY_SIZE - *shared ||
+                *suffix > static_cast<u64>(end - in)) {
+                return {};
+            }
+            std::copy_n(in, *suffix, current.begin() + *shared);
+            in += *suffix;
+            const std::optional<u64> record = GetVarint(in, end);
+            if (!record) {
+                return {};
+            }
+
+            const std::size_t size = *shared + *suffix;
+            const int order = CompareKeys(current.data(), size, target.data(), target.size());
+            if (order > 0) {
+                return records;
+            }
+            if (order == 0) {
+                records.push_back(static_cast<u32>(*record));
+            }
+        }
+    }
+    return records;
+}
+
+std::vector<u32> RecordIndex::FindMiiIdentity(u64 system_id, u32 mii_id) const {
+    KeyBytes bytes;
+    return Find(RecordKey::MiiIdentity,
+                std::span(bytes.data(), MakeMiiIdentityKey(system_id, mii_id, bytes)));
+}
+
+std::vector<u32> RecordIndex::FindSerialNumber(std::string_view serial) const {
+    if (serial.size() > MAX_KEY_SIZE) {
+        return {};
+    }
+    return Find(RecordKey::SerialNumber,
+                std::span(reinterpret_cast<const u8*>(serial.data()), serial.size()));
+}
+
+std::vector<u32> RecordIndex::FindFriendCodeSeed(u64 seed) const {
+    KeyBytes bytes;
+    return Find(RecordKey::FriendCodeSeed,
+                std::span(bytes.data(), MakeFriendCodeSeedKey(seed, bytes)));
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "arena.h"
+#include "bloom_filter.h"
+#include "main.h"
+#include "mapped_file.h"
+
+enum class RecordKey : u32 {
+    MiiIdentity,    ///< MiiData::system_id and mii_id
+    SerialNumber,   ///< FRDMyData::serial_number with its check digit, as printed by WriteMyData
+    FriendCodeSeed, ///< FRDMyData::local_friend_code_seed
+};
+
+/**
+ * Sorted on-disk index from one key of a corpus to record numbers, for corpora too large to load.
+ * Like an SSTable, (key, record) entries are front coded into page sized blocks, and a sparse top
+ * level table holds the first key of every block. A lookup binary searches the top level table,
+ * which is about 1/170th of the file and stays resident, then decodes one block: a single page
+ * fault when cold. A Bloom filter over the keys is stored with the index and answers most lookups
+ * of absent keys without touching any block. Built in parallel, and opened with mmap so opening
+ * does no work beyond validating the header.
+ */
+class RecordIndex {
+public:
+    static constexpr std::size_t BLOCK_SIZE = 0x1000;
+    static constexpr std::size_t MAX_KEY_SIZE = 20;
+
+    using KeyBytes = std::array<u8, MAX_KEY_SIZE>;
+
+    static bool Build(std::span<const FRDMyData> records, RecordKey key, const std::string& path);
+
+    bool Open(const std::string& path);
+
+    /// Records whose key equals key, in ascending order. Keys of another kind match nothing.
+    [[nodiscard]] std::vector<u32> FindMiiIdentity(u64 system_id, u32 mii_id) const;
+    [[nodiscard]] std::vector<u32> FindSerialNumber(std::string_view serial) const;
+    [[nodiscard]] std::vector<u32> FindFriendCodeSeed(u64 seed) const;
+
+    [[nodiscard]] RecordKey Key() const {
+        return key;
+    }
+
+    [[nodiscard]] u64 EntryCount() const {
+        return entry_count;
+    }
+
+    struct Header;
+    struct TopEntry;
+
+private:
+    [[nodiscard]] std::vector<u32> Find(RecordKey kind, std::span<const u8> key) const;
+
+    MappedFile file;
+    BloomFilter filter;
+    RecordKey key = RecordKey::MiiIdentity;
+    const TopEntry* top = nullptr;
+    const u8* blocks = nullptr;
+    u64 block_count = 0;
+    u64 entry_count = 0;
+};
+
+/**
+ * Key of a record as stored in a RecordIndex, zero padded; returns its size. The arena is only used
+ * for serial numbers, and is reset before returning.
+ */
+std::size_t ExtractRecordKey(const FRDMyData& record, RecordKey key, RecordIndex::KeyBytes& out,
+                             Arena& arena);
+
+/// MiiIdentity key of a Mii outside of an FRDMyData
+std::size_t ExtractRecordKey(const ChecksummedMiiData& record, RecordIndex::KeyBytes& out);
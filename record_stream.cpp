@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <unistd.h>
+#include "record_stream.h"
+
+namespace {
+
+constexpr std::size_t BUFFER_ALIGNMENT = 4096;
+
+struct FreeDeleter {
+    void operator()(void* ptr) const {
+        std::free(ptr);
+    }
+};
+
+/**
+ * Scans a byte stream for records of type Record. is_valid decides whether the bytes at the
+ * current position form a record; resync returns how many bytes to skip when they do not.
+ */
+template <typename Record, typename IsValid, typename Resync>
+Generator<Record> StreamRecords(int fd, std::size_t buffer_size, StreamStats* stats,
+                                IsValid is_valid, Resync resync) {
+    // At least two records, so that compacting a partial record always leaves room for a whole one
+    buffer_size = std::max(buffer_size, 2 * sizeof(Record));
+    buffer_size = (buffer_size + BUFFER_ALIGNMENT - 1) & ~(BUFFER_ALIGNMENT - 1);
+    std::unique_ptr<u8, FreeDeleter> buffer(
+        static_cast<u8*>(std::aligned_alloc(BUFFER_ALIGNMENT, buffer_size)));
+    if (!buffer) {
+        co_return;
+    }
+
+    u8* const data = buffer.get();
+    std::size_t begin = 0;
+    std::size_t end = 0;
+    bool eof = false;
+    Record record;
+
+    while (true) {
+        if (end - begin < sizeof(Record)) {
+            if (eof) {
+                break;
+            }
+            std::memmove(data, data + begin, end - begin);
+            end -= begin;
+            begin = 0;
+            while (end < sizeof(Record)) {
+                const ssize_t length = read(fd, data + end, buffer_size - end);
+                if (length < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (length <= 0) {
+                    eof = true;
+                    break;
+                }
+                end += static_cast<std::size_t>(length);
+            }
+            continue;
+        }
+
+        std::memcpy(&record, data + begin, sizeof(Record));
+        if (is_valid(record)) {
+            begin += sizeof(Record);
+            if (stats) {
+                stats->records++;
+            }
+            co_yield record;
+            continue;
+        }
+
+        const std::size_t skip = resync(data + begin, end - begin);
+        begin += skip;
+        if (stats) {
+            stats->skipped_bytes += skip;
+        }
+    }
+
+    if (stats) {
+        stats->skipped_bytes += end - begin;
+    }
+}
+
+} // namespace
+
+Generator<FRDMyData> StreamMyData(int fd, std::size_t buffer_size, StreamStats* stats) {
+    const auto is_valid = [](const FRDMyData& record) {
+        return record.magic == FRDMyData::MAGIC_MY_DATA && record.magic_number == MAGIC_NUMBER;
+    };
+    const auto resync = [](const u8* window, std::size_t size) -> std::size_t {
+        const u32_le magic{FRDMyData::MAGIC_MY_DATA};
+        const void* found = memmem(window + 1, size - 1, &magic, sizeof(magic));
+        if (found) {
+            return static_cast<const u8*>(found) - window;
+        }
+        // Keep a possible partial magic at the end of the window for the next refill
+        return size - (sizeof(magic) - 1);
+    };
+    return StreamRecords<FRDMyData>(fd, buffer_size, stats, is_valid, resync);
+}
+
+Generator<ChecksummedMiiData> StreamMiiData(int fd, std::size_t buffer_size, StreamStats* stats) {
+    // An all zero region has a matching CRC as well, so a zero magic is rejected explicitly
+    const auto is_valid = [](ChecksummedMiiData& record) {
+        return record.mii_data.magic != 0 && record.IsChecksumValid();
+    };
+    const auto resync = [](const u8*, std::size_t) -> std::size_t { return 1; };
+    return StreamRecords<ChecksummedMiiData>(fd, buffer_size, stats, is_valid, resync);
+}
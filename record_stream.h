@@ -0,0 +1,27 @@
+#pragma once
+
+#include "generator.h"
+#include "main.h"
+
+constexpr std::size_t DEFAULT_STREAM_BUFFER_SIZE = 0x10000;
+
+struct StreamStats {
+    u64 records = 0;       ///< Records yielded
+    u64 skipped_bytes = 0; ///< Bytes discarded while resynchronizing, including a truncated tail
+};
+
+/**
+ * Lazily reads concatenated FRDMyData records from a file descriptor (e.g. a pipe on stdin).
+ * A record is accepted when both magic fields match; otherwise the reader skips ahead to the next
+ * occurrence of MAGIC_MY_DATA. Memory use is bounded by buffer_size whatever the input length.
+ */
+[[nodiscard]] Generator<FRDMyData> StreamMyData(int fd,
+                                               std::size_t buffer_size = DEFAULT_STREAM_BUFFER_SIZE,
+                                               StreamStats* stats = nullptr);
+
+/**
+ * Lazily reads concatenated ChecksummedMiiData records from a file descriptor. These have no magic,
+ * so a record is accepted when its CRC matches and the reader advances byte by byte otherwise.
+ */
+[[nodiscard]] Generator<ChecksummedMiiData> StreamMiiData(
+    int fd, std::size_t buffer_size = DEFAULT_STREAM_BUFFER_SIZE, StreamStats* stats = nullptr);
@@ -0,0 +1,452 @@
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "decoded_mii_data.h"
+#include "format.h"
+#include "parallel.h"
+#include "server.h"
+
+struct RecordServer::Connection {
+    int fd;
+    std::string input;        ///< Received bytes not yet handled, starting at a request boundary
+    std::string output;       ///< Replies not yet fully sent
+    std::size_t written = 0;  ///< Bytes of output already sent
+    bool read_pending = false; ///< Reading stopped for backpressure with data possibly left unread
+    bool closing = false;      ///< Close once output is sent
+};
+
+namespace {
+
+/// Stop reading requests from a connection while this many reply bytes are unsent
+constexpr std::size_t MAX_PENDING_OUTPUT = 0x100000;
+constexpr std::size_t MAX_REQUEST_SIZE = 0x1000;
+constexpr std::size_t READ_SIZE = 0x10000;
+constexpr std::size_t MAX_EVENTS = 64;
+
+std::optional<u64> ParseNumber(std::string_view text) {
+    int base = 10;
+    if (text.starts_with("0x") || text.starts_with("0X")) {
+        text.remove_prefix(2);
+        base = 16;
+    }
+    u64 value;
+    const auto [end, result] = std::from_chars(text.data(), text.data() + text.size(), value, base);
+    if (result != std::errc{} || end != text.data() + text.size() || text.empty()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+/// Splits off the first space separated token of text
+std::string_view NextToken(std::string_view& text) {
+    const std::size_t start = std::min(text.find_first_not_of(' '), text.size());
+    const std::size_t end = std::min(text.find(' ', start), text.size());
+    const std::string_view token = text.substr(start, end - start);
+    text.remove_prefix(end);
+    return token;
+}
+
+template <typename T>
+void AppendNumber(std::string& out, T value, int base = 10) {
+    char buffer[24];
+    const auto [end, result] = std::to_chars(buffer, buffer + sizeof(buffer), value, base);
+    out.append(buffer, end);
+}
+
+/// Appends c to a text column. Control characters, tabs and newlines among them, would break the
+/// line protocol and are replaced by '?'.
+void AppendTextChar(std::string& out, char c) {
+    out += static_cast<unsigned char>(c) < 0x20 ? '?' : c;
+}
+
+/// Appends the low byte of every code unit up to the first NUL, like ConvertU16ArrayToString
+template <std::size_t size>
+void AppendName(std::string& out, const std::array<u16, size>& name) {
+    for (std::size_t i = 0; i < size && name[i] != 0; i++) {
+        AppendTextChar(out, static_cast<char>(name[i] & 0xFF));
+    }
+}
+
+/// Sends as much pending output as the socket accepts; false if the connection failed
+bool Flush(RecordServer::Connection& connection) {
+    while (connection.written < connection.output.size()) {
+        const ssize_t sent = send(connection.fd, connection.output.data() + connection.written,
+                                  connection.output.size() - connection.written, MSG_NOSIGNAL);
+        if (sent < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        connection.written += sent;
+    }
+    connection.output.clear();
+    connection.written = 0;
+    return true;
+}
+
+/// Answers every complete request line in the connection's input
+void HandleRequests(const RecordServer& server, RecordServer::Connection& connection) {
+    std::size_t start = 0;
+    for (std::size_t end; (end = connection.input.find('\n', start)) != std::string::npos;
+         start = end + 1) {
+        std::string_view request(connection.input.data() + start, end - start);
+        if (request.ends_with('\r')) {
+            request.remove_suffix(1);
+        }
+        server.HandleRequest(request, connection.output);
+        connection.output += '\n';
+    }
+    connection.input.erase(0, start);
+
+    if (connection.input.size() > MAX_REQUEST_SIZE) {
+        connection.output += "ERR request too long\n";
+        connection.input.clear();
+        connection.closing = true;
+    }
+}
+
+/// Reacts to the epoll events of a connection; returns false once it should be closed
+bool Service(const RecordServer& server, RecordServer::Connection& connection, u32 events) {
+    if (events & EPOLLERR) {
+        return false;
+    }
+    if (!Flush(connection)) {
+        return false;
+    }
+
+    if ((events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) || connection.read_pending) {
+        connection.read_pending = false;
+        char buffer[READ_SIZE];
+        while (!connection.closing) {
+            if (connection.output.size() - connection.written >= MAX_PENDING_OUTPUT) {
+                connection.read_pending = true;
+                break;
+            }
+            const ssize_t size = read(connection.fd, buffer, sizeof(buffer));
+            if (size > 0) {
+                connection.input.append(buffer, size);
+                HandleRequests(server, connection);
+            } else if (size == 0) {
+                connection.closing = true;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            } else if (errno != EINTR) {
+                return false;
+            }
+        }
+        if (!Flush(connection)) {
+            return false;
+        }
+    }
+    return !(connection.closing && connection.output.empty());
+}
+
+int MakeListener(int domain, const sockaddr* address, socklen_t address_size) {
+    const int fd = socket(domain, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    const int enable = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    if (bind(fd, address, address_size) != 0 || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+} // namespace
+
+RecordServer::~RecordServer() {
+    Stop();
+    if (listen_fd >= 0) {
+        close(listen_fd);
+    }
+    if (stop_fd >= 0) {
+        close(stop_fd);
+    }
+    if (!unix_path.empty()) {
+        unlink(unix_path.c_str());
+    }
+}
+
+bool RecordServer::Load(std::span<const FRDMyData> records_) {
+    records = records_;
+
+    identities.resize(records.size());
+    serials.resize(records.size());
+    ParallelFor(records.size(), [&](std::size_t begin, std::size_t end) {
+        Arena arena;
+        for (std::size_t i = begin; i < end; i++) {
+            const MiiData& mii = records[i].mii_data.mii_data;
+            identities[i] = {mii.system_id, mii.mii_id, static_cast<u32>(i)};
+            serials[i] = {std::string(FormatSerialNumber(records[i], arena)), static_cast<u32>(i)};
+            arena.Reset();
+        }
+    });
+    ParallelSort(identities);
+    ParallelSort(serials);
+
+    identity_filter = BloomFilter(records.size());
+    serial_filter = BloomFilter(records.size());
+    for (std::size_t i = 0; i < records.size(); i++) {
+        identity_filter.Insert(IdentityHash(identities[i].system_id, identities[i].mii_id));
+        serial_filter.Insert(BloomHash(std::span(
+            reinterpret_cast<const u8*>(serials[i].first.data()), serials[i].first.size())));
+    }
+
+    std::string path = (std::filesystem::temp_directory_path() / "frd_names_XXXXXX").string();
+    const int fd = mkstemp(path.data());
+    if (fd < 0) {
+        return false;
+    }
+    close(fd);
+    // The mapping outlives the file, so it can be removed as soon as it is opened
+    const bool opened = NameIndex::Build(records, path) && names.Open(path);
+    unlink(path.c_str());
+    return opened;
+}
+
+bool RecordServer::ListenUnix(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path) || listen_fd >= 0) {
+        return false;
+    }
+    std::copy(path.begin(), path.end(), address.sun_path);
+    unlink(path.c_str());
+
+    listen_fd = MakeListener(AF_UNIX, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+    if (listen_fd >= 0) {
+        unix_path = path;
+    }
+    return listen_fd >= 0;
+}
+
+bool RecordServer::ListenTcp(u16 port) {
+    if (listen_fd >= 0) {
+        return false;
+    }
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    listen_fd = MakeListener(AF_INET, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+    return listen_fd >= 0;
+}
+
+bool RecordServer::Start(std::size_t shard_count) {
+    if (listen_fd < 0 || !shards.empty()) {
+        return false;
+    }
+    if (stop_fd < 0) {
+        stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (stop_fd < 0) {
+            return false;
+        }
+    }
+    if (shard_count == 0) {
+        shard_count = ThreadCount();
+    }
+    for (std::size_t i = 0; i < shard_count; i++) {
+        shards.emplace_back([this] { RunShard(); });
+    }
+    return true;
+}
+
+void RecordServer::Stop() {
+    if (shards.empty()) {
+        return;
+    }
+    // The eventfd stays readable, so every shard sees it
+    const u64 one = 1;
+    [[maybe_unused]] const ssize_t written = write(stop_fd, &one, sizeof(one));
+    shards.clear();
+
+    u64 value;
+    [[maybe_unused]] const ssize_t read_size = read(stop_fd, &value, sizeof(value));
+}
+
+void RecordServer::RunShard() {
+    const int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        return;
+    }
+
+    // The listener and stop events are told apart from connections by their data pointers
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLEXCLUSIVE;
+    event.data.ptr = &listen_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+    event.events = EPOLLIN;
+    event.data.ptr = &stop_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stop_fd, &event);
+
+    std::unordered_map<Connection*, std::unique_ptr<Connection>> connections;
+    std::array<epoll_event, MAX_EVENTS> events;
+    bool running = true;
+
+    while (running) {
+        const int count = epoll_wait(epoll_fd, events.data(), events.size(), -1);
+        if (count < 0 && errno != EINTR) {
+            break;
+        }
+        for (int i = 0; i < count; i++) {
+            void* const target = events[i].data.ptr;
+            if (target == &stop_fd) {
+                running = false;
+            } else if (target == &listen_fd) {
+                int fd;
+                while ((fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                    // Fails harmlessly on Unix sockets
+                    const int enable = 1;
+                    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+                    auto connection = std::make_unique<Connection>();
+                    connection->fd = fd;
+                    epoll_event connection_event{};
+                    connection_event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+                    connection_event.data.ptr = connection.get();
+                    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &connection_event) != 0) {
+                        close(fd);
+                        continue;
+                    }
+                    connections.emplace(connection.get(), std::move(connection));
+                }
+            } else {
+                auto* connection = static_cast<Connection*>(target);
+                if (!Service(*this, *connection, events[i].events)) {
+                    close(connection->fd);
+                    connections.erase(connection);
+                }
+            }
+        }
+    }
+
+    for (const auto& [connection, owner] : connections) {
+        close(connection->fd);
+    }
+    close(epoll_fd);
+}
+
+void RecordServer::AppendRecord(u32 record, std::string& out) const {
+    const FRDMyData& obj = records[record];
+    const MiiData& mii = obj.mii_data.mii_data;
+
+    AppendNumber(out, record);
+    out += "\t0x";
+    AppendNumber(out, u64{mii.system_id}, 16);
+    out += '\t';
+    AppendNumber(out, u32{mii.mii_id});
+    out += '\t';
+    thread_local Arena arena;
+    for (const char c : FormatSerialNumber(obj, arena)) {
+        AppendTextChar(out, c);
+    }
+    arena.Reset();
+    out += '\t';
+    AppendName(out, obj.display_name);
+    out += '\t';
+    cache.Append(mii.system_id, mii.mii_id, obj.mii_data.crc16, out, [&mii](std::string& text) {
+        const DecodedMiiData decoded = Decode(mii);
+        AppendName(text, mii.mii_name);
+        text += '\t';
+        AppendName(text, mii.author_name);
+        for (const u64 value :
+             {u64{decoded.mii_details_sex}, u64{decoded.mii_details_bday_month},
+              u64{decoded.mii_details_bday_day}, u64{decoded.mii_details_shirt_color},
+              u64{decoded.face_style_skin_color}}) {
+            text += '\t';
+            AppendNumber(text, value);
+        }
+    });
+    for (const u64 value :
+         {u64{obj.profile.region}, u64{obj.profile.country}, u64{obj.profile.language}}) {
+        out += '\t';
+        AppendNumber(out, value);
+    }
+}
+
+void RecordServer::HandleRequest(std::string_view request, std::string& out) const {
+    std::string_view arguments = request;
+    const std::string_view command = NextToken(arguments);
+
+    std::vector<u32> matches;
+    if (command == "GET") {
+        const std::optional<u64> system_id = ParseNumber(NextToken(arguments));
+        const std::optional<u64> mii_id = ParseNumber(NextToken(arguments));
+        if (!system_id || !mii_id || *mii_id > UINT32_MAX) {
+            out += "ERR usage: GET <system_id> <mii_id>";
+            return;
+        }
+        const auto first =
+            identity_filter.MayContain(IdentityHash(*system_id, static_cast<u32>(*mii_id)))
+                ? std::lower_bound(identities.begin(), identities.end(),
+                                   IdentityEntry{*system_id, static_cast<u32>(*mii_id), 0})
+                : identities.end();
+        for (auto it = first; it != identities.end() && it->system_id == *system_id &&
+                              it->mii_id == *mii_id;
+             it++) {
+            matches.push_back(it->record);
+        }
+    } else if (command == "SERIAL") {
+        const std::string_view serial = NextToken(arguments);
+        const bool may_contain = serial_filter.MayContain(
+            BloomHash(std::span(reinterpret_cast<const u8*>(serial.data()), serial.size())));
+        auto it = !may_contain ? serials.end()
+                               : std::lower_bound(serials.begin(), serials.end(), serial,
+                                                  [](const auto& entry, std::string_view key) {
+                                                      return entry.first < key;
+                                                  });
+        for (; it != serials.end() && it->first == serial; it++) {
+            matches.push_back(it->second);
+        }
+    } else if (command == "PREFIX") {
+        const std::size_t start = arguments.find_first_not_of(' ');
+        if (start == std::string_view::npos) {
+            out += "ERR usage: PREFIX <name>";
+            return;
+        }
+        // A record matches through at most three names
+        const std::u16string prefix = WidenName(arguments.substr(start));
+        for (const NameHit& hit : names.FindPrefix(prefix, PREFIX_LIMIT * 3)) {
+            if (std::find(matches.begin(), matches.end(), hit.record) == matches.end()) {
+                matches.push_back(hit.record);
+                if (matches.size() == PREFIX_LIMIT) {
+                    break;
+                }
+            }
+        }
+    } else if (command == "STATS") {
+        const DecodeCacheStats stats = cache.Stats();
+        out += "OK 1\nhits ";
+        AppendNumber(out, stats.hits);
+        out += " misses ";
+        AppendNumber(out, stats.misses);
+        out += " evictions ";
+        AppendNumber(out, stats.evictions);
+        return;
+    } else {
+        out += "ERR unknown command";
+        return;
+    }
+
+    out += "OK ";
+    AppendNumber(out, matches.size());
+    for (const u32 record : matches) {
+        out += '\n';
+        AppendRecord(record, out);
+    }
+}
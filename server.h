@@ -0,0 +1,85 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "bloom_filter.h"
+#include "decode_cache.h"
+#include "name_index.h"
+
+/**
+ * Long-running lookup service over an in-memory corpus of FRDMyData records, answering a line
+ * protocol on a Unix socket or a TCP port bound to localhost. One request per line:
+ *
+ *   GET <system_id> <mii_id>    records with that Mii identity (numbers in decimal or 0x hex)
+ *   SERIAL <serial>             records with that serial number, check digit included
+ *   STATS                       one line of decode cache hit, miss and eviction counts
+ *   PREFIX <name>               records with a display, Mii or author name starting with name; the
+ *                               name is the rest of the line and at most PREFIX_LIMIT are returned
+ *
+ * Each reply is "OK <n>" followed by n tab separated record lines, or a single "ERR <reason>" line.
+ * Replies are written in request order, so clients may pipeline any number of requests.
+ *
+ * Every shard thread runs its own epoll loop; the listening socket is shared with EPOLLEXCLUSIVE so
+ * each connection is accepted and then served by a single shard without any locking. The corpus
+ * and its indexes are read only once loaded. The Mii part of each record line is formatted once per
+ * Mii identity and kept in a shared DecodeCache. GET and SERIAL consult a Bloom filter before
+ * searching, so lookups of unknown keys mostly end there.
+ */
+class RecordServer {
+public:
+    static constexpr std::size_t PREFIX_LIMIT = 100;
+
+    RecordServer() = default;
+    ~RecordServer();
+    RecordServer(const RecordServer&) = delete;
+    RecordServer& operator=(const RecordServer&) = delete;
+
+    /// Indexes records, which must outlive the server. The name index is built in a temporary file.
+    bool Load(std::span<const FRDMyData> records);
+
+    bool ListenUnix(const std::string& path);
+    bool ListenTcp(u16 port);
+
+    /// Starts one shard thread per worker; returns false if not loaded and listening
+    bool Start(std::size_t shards = 0);
+
+    /// Stops and joins every shard and closes all connections
+    void Stop();
+
+    /// Appends the reply to one request line, without its line terminator, to out
+    void HandleRequest(std::string_view request, std::string& out) const;
+
+    struct Connection;
+
+private:
+    struct IdentityEntry {
+        u64 system_id;
+        u32 mii_id;
+        u32 record;
+
+        auto operator<=>(const IdentityEntry&) const = default;
+    };
+
+    [[nodiscard]] static u64 IdentityHash(u64 system_id, u32 mii_id) {
+        return BloomHash(system_id ^ BloomHash(mii_id));
+    }
+
+    void RunShard();
+    void AppendRecord(u32 record, std::string& out) const;
+
+    std::span<const FRDMyData> records;
+    std::vector<IdentityEntry> identities;                ///< Sorted
+    std::vector<std::pair<std::string, u32>> serials;     ///< Sorted
+    BloomFilter identity_filter;
+    BloomFilter serial_filter;
+    NameIndex names;
+    mutable DecodeCache cache;
+
+    int listen_fd = -1;
+    int stop_fd = -1;
+    std::string unix_path;
+    std::vector<std::jthread> shards;
+};
@@ -0,0 +1,356 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include "parallel.h"
+#include "snapshot_store.h"
+
+struct SnapshotStore::FileHeader {
+    std::array<char, 8> magic;
+    u32 record_size; ///< sizeof(FRDMyData) when written
+    u32 reserved;
+};
+
+struct SnapshotStore::EntryHeader {
+    u64 console;
+    u32 version;
+    u16 payload_size; ///< Bytes after this header
+    u8 kind;          ///< EntryKind
+    u8 reserved;
+};
+
+namespace {
+
+constexpr std::array<char, 8> SNAPSHOT_MAGIC{'F', 'R', 'D', 'S', 'N', 'A', 'P', '1'};
+static_assert(sizeof(SnapshotStore::FileHeader) == 16);
+static_assert(sizeof(SnapshotStore::EntryHeader) == 16);
+
+enum class EntryKind : u8 {
+    Keyframe, ///< Payload is the whole record
+    Delta,    ///< Payload is runs of u16 offset, u16 length, then length bytes XORed into the keyframe
+};
+
+constexpr std::size_t RECORD_SIZE = sizeof(FRDMyData);
+constexpr std::size_t RUN_HEADER_SIZE = 2 * sizeof(u16);
+
+/// Deltas past this size are stored as keyframes instead
+constexpr std::size_t MAX_DELTA_SIZE = RECORD_SIZE / 2;
+
+static_assert(RECORD_SIZE <= std::numeric_limits<u16>::max());
+
+template <typename T>
+void AppendBytes(std::vector<u8>& out, const T& value) {
+    const auto* bytes = reinterpret_cast<const u8*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+/// Appends the runs of bytes that differ between keyframe and snapshot. Runs separated by fewer
+/// equal bytes than a run header are merged, since the gap is cheaper than another header.
+void EncodeDelta(const u8* keyframe, const u8* snapshot, std::vector<u8>& out) {
+    std::size_t i = 0;
+    while (i < RECORD_SIZE) {
+        if (keyframe[i] == snapshot[i]) {
+            i++;
+            continue;
+        }
+        std::size_t last = i;
+        for (std::size_t j = i + 1; j < RECORD_SIZE && j - last <= RUN_HEADER_SIZE; j++) {
+            if (keyframe[j] != snapshot[j]) {
+                last = j;
+            }
+        }
+        AppendBytes(out, static_cast<u16>(i));
+        AppendBytes(out, static_cast<u16>(last + 1 - i));
+        for (; i <= last; i++) {
+            out.push_back(keyframe[i] ^ snapshot[i]);
+        }
+    }
+}
+
+/// XORs the runs of a delta payload into record; false if a run is out of bounds
+bool ApplyDelta(std::span<const u8> payload, u8* record) {
+    while (!payload.empty()) {
+        if (payload.size() < RUN_HEADER_SIZE) {
+            return false;
+        }
+        u16 offset, length;
+        std::memcpy(&offset, payload.data(), sizeof(u16));
+        std::memcpy(&length, payload.data() + sizeof(u16), sizeof(u16));
+        payload = payload.subspan(RUN_HEADER_SIZE);
+        if (length > payload.size() || offset + length > RECORD_SIZE) {
+            return false;
+        }
+        for (std::size_t i = 0; i < length; i++) {
+            record[offset + i] ^= payload[i];
+        }
+        payload = payload.subspan(length);
+    }
+    return true;
+}
+
+/// Appends the entry for the next version of console to out and advances state
+void EncodeSnapshot(u64 console, const FRDMyData& snapshot, u32 keyframe_interval,
+                    SnapshotWriter::ConsoleState& state, std::vector<u8>& out) {
+    const std::size_t start = out.size();
+    SnapshotStore::EntryHeader header{console, state.versions, 0, 0, 0};
+    AppendBytes(out, header);
+
+    bool keyframe = state.versions == 0 ||
+                    state.versions - state.keyframe_version >= std::max<u32>(keyframe_interval, 1);
+    if (!keyframe) {
+        EncodeDelta(reinterpret_cast<const u8*>(&state.keyframe),
+                    reinterpret_cast<const u8*>(&snapshot), out);
+        keyframe = out.size() - start - sizeof(header) > MAX_DELTA_SIZE;
+        header.kind = static_cast<u8>(EntryKind::Delta);
+    }
+    if (keyframe) {
+        out.resize(start + sizeof(header));
+        AppendBytes(out, snapshot);
+        header.kind = static_cast<u8>(EntryKind::Keyframe);
+        state.keyframe = snapshot;
+        state.keyframe_version = state.versions;
+    }
+    header.payload_size = static_cast<u16>(out.size() - start - sizeof(header));
+    std::memcpy(out.data() + start, &header, sizeof(header));
+    state.versions++;
+}
+
+} // namespace
+
+bool SnapshotStore::Open(const std::string& path) {
+    entries.clear();
+    consoles.clear();
+    console_starts.clear();
+    keyframe_count = 0;
+    valid_size = 0;
+    if (!file.Open(path)) {
+        return false;
+    }
+
+    const std::span<const u8> bytes = file.Bytes();
+    FileHeader file_header;
+    if (bytes.size() < sizeof(file_header)) {
+        file.Close();
+        return false;
+    }
+    std::memcpy(&file_header, bytes.data(), sizeof(file_header));
+    if (file_header.magic != SNAPSHOT_MAGIC || file_header.record_size != RECORD_SIZE) {
+        file.Close();
+        return false;
+    }
+
+    // Scanning stops at an entry cut short by the end of the file, which an interrupted append
+    // leaves behind. Any other entry that is inconsistent with the ones before it means the log is
+    // corrupt, and resuming after it would drop every entry that follows.
+    const auto corrupt = [&] {
+        entries.clear();
+        keyframe_count = 0;
+        file.Close();
+        return false;
+    };
+    std::unordered_map<u64, std::pair<u32, u32>> progress; ///< Versions and latest keyframe
+    u64 offset = sizeof(file_header);
+    while (bytes.size() - offset >= sizeof(EntryHeader)) {
+        EntryHeader header;
+        std::memcpy(&header, bytes.data() + offset, sizeof(header));
+        if (header.payload_size > bytes.size() - offset - sizeof(header)) {
+            break;
+        }
+        auto [it, inserted] = progress.try_emplace(header.console, 0, 0);
+        auto& [versions, keyframe_version] = it->second;
+        if (header.version != versions) {
+            return corrupt();
+        }
+        if (header.kind == static_cast<u8>(EntryKind::Keyframe) &&
+            header.payload_size == RECORD_SIZE) {
+            keyframe_version = versions;
+            keyframe_count++;
+        } else if (header.kind != static_cast<u8>(EntryKind::Delta) || inserted) {
+            return corrupt();
+        }
+        entries.push_back({header.console, header.version, keyframe_version, offset});
+        versions++;
+        offset += sizeof(header) + header.payload_size;
+    }
+    valid_size = offset;
+
+    ParallelSort(entries, [](const Entry& a, const Entry& b) {
+        return a.console != b.console ? a.console < b.console : a.version < b.version;
+    });
+    for (std::size_t i = 0; i < entries.size(); i++) {
+        if (i == 0 || entries[i].console != entries[i - 1].console) {
+            consoles.push_back(entries[i].console);
+            console_starts.push_back(i);
+        }
+    }
+    console_starts.push_back(entries.size());
+    return true;
+}
+
+std::span<const SnapshotStore::Entry> SnapshotStore::EntriesOf(u64 console) const {
+    const auto it = std::lower_bound(consoles.begin(), consoles.end(), console);
+    if (it == consoles.end() || *it != console) {
+        return {};
+    }
+    const std::size_t i = it - consoles.begin();
+    return std::span(entries).subspan(console_starts[i], console_starts[i + 1] - console_starts[i]);
+}
+
+u32 SnapshotStore::VersionCount(u64 console) const {
+    return static_cast<u32>(EntriesOf(console).size());
+}
+
+u32 SnapshotStore::KeyframeOf(u64 console, u32 version) const {
+    const std::span<const Entry> versions = EntriesOf(console);
+    return version < versions.size() ? versions[version].keyframe_version : version;
+}
+
+std::optional<FRDMyData> SnapshotStore::Get(u64 console, u32 version) const {
+    const std::span<const Entry> versions = EntriesOf(console);
+    if (version >= versions.size()) {
+        return std::nullopt;
+    }
+    const Entry& entry = versions[version];
+    const u8* keyframe = file.Bytes().data() + versions[entry.keyframe_version].offset;
+
+    FRDMyData snapshot;
+    std::memcpy(&snapshot, keyframe + sizeof(EntryHeader), sizeof(snapshot));
+    if (entry.keyframe_version != version) {
+        EntryHeader header;
+        std::memcpy(&header, file.Bytes().data() + entry.offset, sizeof(header));
+        if (!ApplyDelta(file.Bytes().subspan(entry.offset + sizeof(header), header.payload_size),
+                        reinterpret_cast<u8*>(&snapshot))) {
+            return std::nullopt;
+        }
+    }
+    return snapshot;
+}
+
+bool SnapshotStore::Compact(const std::string& path, const std::string& out_path,
+                            u32 keyframe_interval) {
+    std::error_code ec;
+    if (std::filesystem::equivalent(path, out_path, ec)) {
+        return false; // Truncating the output would pull the mapped input out from under us
+    }
+    SnapshotStore store;
+    if (!store.Open(path)) {
+        return false;
+    }
+
+    // A few groups per worker, so that consoles with long histories even out
+    const std::size_t console_count = store.consoles.size();
+    const std::size_t groups = std::min(console_count, ThreadCount() * 4);
+    std::vector<std::vector<u8>> encoded(groups);
+    bool corrupt = false;
+    ParallelFor(
+        groups,
+        [&](std::size_t begin, std::size_t end) {
+            for (std::size_t group = begin; group < end; group++) {
+                std::vector<u8>& out = encoded[group];
+                for (std::size_t i = console_count * group / groups;
+                     i < console_count * (group + 1) / groups; i++) {
+                    const u64 console = store.consoles[i];
+                    SnapshotWriter::ConsoleState state;
+                    for (u32 version = 0; version < store.VersionCount(console); version++) {
+                        const std::optional<FRDMyData> snapshot = store.Get(console, version);
+                        if (!snapshot) {
+                            std::atomic_ref<bool>(corrupt).store(true, std::memory_order_relaxed);
+                            return;
+                        }
+                        EncodeSnapshot(console, *snapshot, keyframe_interval, state, out);
+                    }
+                }
+            }
+        },
+        1);
+    if (corrupt) {
+        return false;
+    }
+
+    FILE* file = std::fopen(out_path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    const FileHeader header{SNAPSHOT_MAGIC, RECORD_SIZE, 0};
+    bool written = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    for (const std::vector<u8>& out : encoded) {
+        written = written && std::fwrite(out.data(), 1, out.size(), file) == out.size();
+    }
+    return std::fclose(file) == 0 && written;
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    Close();
+}
+
+bool SnapshotWriter::Open(const std::string& path) {
+    Close();
+    failed = false;
+    bytes_written = 0;
+    consoles.clear();
+
+    std::error_code ec;
+    if (std::filesystem::file_size(path, ec) == 0 || ec) {
+        file = std::fopen(path.c_str(), "wb");
+        const SnapshotStore::FileHeader header{SNAPSHOT_MAGIC, RECORD_SIZE, 0};
+        if (file && std::fwrite(&header, sizeof(header), 1, file) != 1) {
+            Close();
+        }
+        return file != nullptr;
+    }
+
+    u64 valid_size;
+    {
+        SnapshotStore store;
+        if (!store.Open(path)) {
+            return false;
+        }
+        for (const u64 console : store.Consoles()) {
+            ConsoleState& state = consoles[console];
+            state.versions = store.VersionCount(console);
+            state.keyframe_version = store.KeyframeOf(console, state.versions - 1);
+            const std::optional<FRDMyData> keyframe = store.Get(console, state.keyframe_version);
+            if (!keyframe) {
+                return false;
+            }
+            state.keyframe = *keyframe;
+        }
+        valid_size = store.ValidSize();
+    }
+    // Drops a torn entry left by an interrupted append; Open fails on any other inconsistency
+    std::filesystem::resize_file(path, valid_size, ec);
+    if (ec) {
+        return false;
+    }
+    file = std::fopen(path.c_str(), "ab");
+    return file != nullptr;
+}
+
+bool SnapshotWriter::Append(u64 console, const FRDMyData& snapshot) {
+    // After a failed write the log may end in a partial entry, which later entries must not follow
+    if (!file || failed) {
+        return false;
+    }
+    // The console only moves on to the new version once its entry is written
+    ConsoleState& state = consoles[console];
+    ConsoleState next = state;
+    buffer.clear();
+    EncodeSnapshot(console, snapshot, keyframe_interval, next, buffer);
+    if (std::fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) {
+        failed = true;
+        return false;
+    }
+    state = next;
+    bytes_written += buffer.size();
+    return true;
+}
+
+bool SnapshotWriter::Close() {
+    if (!file) {
+        return !failed;
+    }
+    const bool closed = std::fclose(file) == 0;
+    file = nullptr;
+    return closed && !failed;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdio>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "main.h"
+#include "mapped_file.h"
+
+/// A snapshot is stored whole at least once per this many versions of its console
+constexpr u32 DEFAULT_KEYFRAME_INTERVAL = 32;
+
+/**
+ * Append-only history of FRDMyData snapshots per console. The first snapshot of a console, and
+ * then every keyframe interval, is stored whole as a keyframe; the others are stored as sparse XOR
+ * deltas against the latest keyframe, as runs of changed bytes. Since no delta builds on another,
+ * reading any version applies at most one delta, and successive snapshots that differ in a few
+ * fields cost a few dozen bytes instead of sizeof(FRDMyData). A delta that grows past half a record
+ * is replaced by a new keyframe.
+ *
+ * Open maps the log and indexes its entries by console and version. A torn entry at the end, left
+ * by an interrupted append, is ignored, and SnapshotWriter overwrites it when resuming. Any other
+ * inconsistent entry makes Open fail, so that a corrupt log is never truncated.
+ */
+class SnapshotStore {
+public:
+    bool Open(const std::string& path);
+
+    /// Consoles with at least one snapshot, ascending
+    [[nodiscard]] std::span<const u64> Consoles() const {
+        return consoles;
+    }
+
+    /// Versions of console, numbered from 0 in append order; 0 if it is unknown
+    [[nodiscard]] u32 VersionCount(u64 console) const;
+
+    /// Snapshot of console at version, or nullopt if there is none or its entry is corrupt
+    [[nodiscard]] std::optional<FRDMyData> Get(u64 console, u32 version) const;
+
+    /// Version of the keyframe that version is encoded against; itself if it is a keyframe
+    [[nodiscard]] u32 KeyframeOf(u64 console, u32 version) const;
+
+    [[nodiscard]] u64 EntryCount() const {
+        return entries.size();
+    }
+
+    [[nodiscard]] u64 KeyframeCount() const {
+        return keyframe_count;
+    }
+
+    /// Bytes of the log up to the end of its last complete entry
+    [[nodiscard]] u64 ValidSize() const {
+        return valid_size;
+    }
+
+    /**
+     * Rewrites the log at path into out_path with the entries of each console together, dropping
+     * torn entries and re-encoding every history against keyframe_interval. Consoles are encoded in
+     * parallel.
+     */
+    static bool Compact(const std::string& path, const std::string& out_path,
+                        u32 keyframe_interval = DEFAULT_KEYFRAME_INTERVAL);
+
+    struct FileHeader;
+    struct EntryHeader;
+
+    /// Location of one version in the log
+    struct Entry {
+        u64 console;
+        u32 version;
+        u32 keyframe_version;
+        u64 offset; ///< Of its EntryHeader
+    };
+
+private:
+    /// Entries of console, in version order
+    [[nodiscard]] std::span<const Entry> EntriesOf(u64 console) const;
+
+    MappedFile file;
+    std::vector<Entry> entries;         ///< Sorted by console, then version
+    std::vector<u64> consoles;          ///< Sorted
+    std::vector<u64> console_starts;    ///< Index in entries of the first entry of each console
+    u64 keyframe_count = 0;
+    u64 valid_size = 0;
+};
+
+/// Appends snapshots to a SnapshotStore log, choosing between keyframes and deltas
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(u32 keyframe_interval = DEFAULT_KEYFRAME_INTERVAL)
+        : keyframe_interval(keyframe_interval) {}
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    /// Creates the log at path, or resumes one after its last complete entry
+    bool Open(const std::string& path);
+
+    /// Adds the next version of console; fails once any write has failed
+    bool Append(u64 console, const FRDMyData& snapshot);
+
+    /// Flushes and closes the log; returns false if any write failed
+    bool Close();
+
+    /// Bytes appended since Open, including entry headers
+    [[nodiscard]] u64 BytesWritten() const {
+        return bytes_written;
+    }
+
+    /// Latest keyframe of a console, and how far its history has got
+    struct ConsoleState {
+        FRDMyData keyframe{};
+        u32 keyframe_version = 0;
+        u32 versions = 0;
+    };
+
+private:
+    FILE* file = nullptr;
+    u32 keyframe_interval;
+    bool failed = false;
+    u64 bytes_written = 0;
+    std::unordered_map<u64, ConsoleState> consoles;
+    std::vector<u8> buffer; ///< Encoded entry, reused across appends
+};
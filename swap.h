@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <bit>
 #include <type_traits>
 
 #if defined(_MSC_VER)
@@ -67,71 +68,75 @@ typedef double f64; ///< 64-bit floating point
 
 namespace Common {
 
-#ifdef _MSC_VER
-[[nodiscard]] inline u16 swap16(u16 data) noexcept {
-    return _byteswap_ushort(data);
+// The byte swaps are usable in constant expressions: constant evaluation takes the portable shifts,
+// while at runtime they stay on the compiler intrinsics.
+
+[[nodiscard]] constexpr u16 swap16_generic(u16 data) noexcept {
+    return static_cast<u16>((data >> 8) | (data << 8));
 }
-[[nodiscard]] inline u32 swap32(u32 data) noexcept {
-    return _byteswap_ulong(data);
+[[nodiscard]] constexpr u32 swap32_generic(u32 data) noexcept {
+    return ((data & 0xFF000000U) >> 24) | ((data & 0x00FF0000U) >> 8) |
+           ((data & 0x0000FF00U) << 8) | ((data & 0x000000FFU) << 24);
 }
-[[nodiscard]] inline u64 swap64(u64 data) noexcept {
-    return _byteswap_uint64(data);
+[[nodiscard]] constexpr u64 swap64_generic(u64 data) noexcept {
+    return ((data & 0xFF00000000000000ULL) >> 56) | ((data & 0x00FF000000000000ULL) >> 40) |
+           ((data & 0x0000FF0000000000ULL) >> 24) | ((data & 0x000000FF00000000ULL) >> 8) |
+           ((data & 0x00000000FF000000ULL) << 8) | ((data & 0x0000000000FF0000ULL) << 24) |
+           ((data & 0x000000000000FF00ULL) << 40) | ((data & 0x00000000000000FFULL) << 56);
 }
-#elif defined(__clang__) || defined(__GNUC__)
+
 #if defined(__Bitrig__) || defined(__OpenBSD__)
 // redefine swap16, swap32, swap64 as inline functions
 #undef swap16
 #undef swap32
 #undef swap64
 #endif
-[[nodiscard]] inline u16 swap16(u16 data) noexcept {
+
+[[nodiscard]] constexpr u16 swap16(u16 data) noexcept {
+    if (std::is_constant_evaluated()) {
+        return swap16_generic(data);
+    }
+#ifdef _MSC_VER
+    return _byteswap_ushort(data);
+#elif defined(__clang__) || defined(__GNUC__)
     return __builtin_bswap16(data);
+#else
+    return swap16_generic(data);
+#endif
 }
-[[nodiscard]] inline u32 swap32(u32 data) noexcept {
+[[nodiscard]] constexpr u32 swap32(u32 data) noexcept {
+    if (std::is_constant_evaluated()) {
+        return swap32_generic(data);
+    }
+#ifdef _MSC_VER
+    return _byteswap_ulong(data);
+#elif defined(__clang__) || defined(__GNUC__)
     return __builtin_bswap32(data);
+#else
+    return swap32_generic(data);
+#endif
 }
-[[nodiscard]] inline u64 swap64(u64 data) noexcept {
+[[nodiscard]] constexpr u64 swap64(u64 data) noexcept {
+    if (std::is_constant_evaluated()) {
+        return swap64_generic(data);
+    }
+#ifdef _MSC_VER
+    return _byteswap_uint64(data);
+#elif defined(__clang__) || defined(__GNUC__)
     return __builtin_bswap64(data);
-}
 #else
-// Generic implementation.
-[[nodiscard]] inline u16 swap16(u16 data) noexcept {
-    return (data >> 8) | (data << 8);
-}
-[[nodiscard]] inline u32 swap32(u32 data) noexcept {
-    return ((data & 0xFF000000U) >> 24) | ((data & 0x00FF0000U) >> 8) |
-           ((data & 0x0000FF00U) << 8) | ((data & 0x000000FFU) << 24);
-}
-[[nodiscard]] inline u64 swap64(u64 data) noexcept {
-    return ((data & 0xFF00000000000000ULL) >> 56) | ((data & 0x00FF000000000000ULL) >> 40) |
-           ((data & 0x0000FF0000000000ULL) >> 24) | ((data & 0x000000FF00000000ULL) >> 8) |
-           ((data & 0x00000000FF000000ULL) << 8) | ((data & 0x0000000000FF0000ULL) << 24) |
-           ((data & 0x000000000000FF00ULL) << 40) | ((data & 0x00000000000000FFULL) << 56);
-}
+    return swap64_generic(data);
 #endif
+}
 
-[[nodiscard]] inline float swapf(float f) noexcept {
+[[nodiscard]] constexpr float swapf(float f) noexcept {
     static_assert(sizeof(u32) == sizeof(float), "float must be the same size as uint32_t.");
-
-    u32 value;
-    std::memcpy(&value, &f, sizeof(u32));
-
-    value = swap32(value);
-    std::memcpy(&f, &value, sizeof(u32));
-
-    return f;
+    return std::bit_cast<float>(swap32(std::bit_cast<u32>(f)));
 }
 
-[[nodiscard]] inline double swapd(double f) noexcept {
+[[nodiscard]] constexpr double swapd(double f) noexcept {
     static_assert(sizeof(u64) == sizeof(double), "double must be the same size as uint64_t.");
-
-    u64 value;
-    std::memcpy(&value, &f, sizeof(u64));
-
-    value = swap64(value);
-    std::memcpy(&f, &value, sizeof(u64));
-
-    return f;
+    return std::bit_cast<double>(swap64(std::bit_cast<u64>(f)));
 }
 
 } // Namespace Common
@@ -143,274 +148,274 @@ struct swap_struct_t {
 protected:
     T value;
 
-    static T swap(T v) {
+    constexpr static T swap(T v) {
         return F::swap(v);
     }
 
 public:
-    T swap() const {
+    constexpr T swap() const {
         return swap(value);
     }
-    swap_struct_t() = default;
-    swap_struct_t(const T& v) : value(swap(v)) {}
+    constexpr swap_struct_t() = default;
+    constexpr swap_struct_t(const T& v) : value(swap(v)) {}
 
     template <typename S>
-    swapped_t& operator=(const S& source) {
+    constexpr swapped_t& operator=(const S& source) {
         value = swap(static_cast<T>(source));
         return *this;
     }
 
-    operator s8() const {
+    constexpr operator s8() const {
         return static_cast<s8>(swap());
     }
-    operator u8() const {
+    constexpr operator u8() const {
         return static_cast<u8>(swap());
     }
-    operator s16() const {
+    constexpr operator s16() const {
         return static_cast<s16>(swap());
     }
-    operator u16() const {
+    constexpr operator u16() const {
         return static_cast<u16>(swap());
     }
-    operator s32() const {
+    constexpr operator s32() const {
         return static_cast<s32>(swap());
     }
-    operator u32() const {
+    constexpr operator u32() const {
         return static_cast<u32>(swap());
     }
-    operator s64() const {
+    constexpr operator s64() const {
         return static_cast<s64>(swap());
     }
-    operator u64() const {
+    constexpr operator u64() const {
         return static_cast<u64>(swap());
     }
-    operator float() const {
+    constexpr operator float() const {
         return static_cast<float>(swap());
     }
-    operator double() const {
+    constexpr operator double() const {
         return static_cast<double>(swap());
     }
 
     // +v
-    swapped_t operator+() const {
+    constexpr swapped_t operator+() const {
         return +swap();
     }
     // -v
-    swapped_t operator-() const {
+    constexpr swapped_t operator-() const {
         return -swap();
     }
 
     // v / 5
-    swapped_t operator/(const swapped_t& i) const {
+    constexpr swapped_t operator/(const swapped_t& i) const {
         return swap() / i.swap();
     }
     template <typename S>
-    swapped_t operator/(const S& i) const {
+    constexpr swapped_t operator/(const S& i) const {
         return swap() / i;
     }
 
     // v * 5
-    swapped_t operator*(const swapped_t& i) const {
+    constexpr swapped_t operator*(const swapped_t& i) const {
         return swap() * i.swap();
     }
     template <typename S>
-    swapped_t operator*(const S& i) const {
+    constexpr swapped_t operator*(const S& i) const {
         return swap() * i;
     }
 
     // v + 5
-    swapped_t operator+(const swapped_t& i) const {
+    constexpr swapped_t operator+(const swapped_t& i) const {
         return swap() + i.swap();
     }
     template <typename S>
-    swapped_t operator+(const S& i) const {
+    constexpr swapped_t operator+(const S& i) const {
         return swap() + static_cast<T>(i);
     }
     // v - 5
-    swapped_t operator-(const swapped_t& i) const {
+    constexpr swapped_t operator-(const swapped_t& i) const {
         return swap() - i.swap();
     }
     template <typename S>
-    swapped_t operator-(const S& i) const {
+    constexpr swapped_t operator-(const S& i) const {
         return swap() - static_cast<T>(i);
     }
 
     // v += 5
-    swapped_t& operator+=(const swapped_t& i) {
+    constexpr swapped_t& operator+=(const swapped_t& i) {
         value = swap(swap() + i.swap());
         return *this;
     }
     template <typename S>
-    swapped_t& operator+=(const S& i) {
+    constexpr swapped_t& operator+=(const S& i) {
         value = swap(swap() + static_cast<T>(i));
         return *this;
     }
     // v -= 5
-    swapped_t& operator-=(const swapped_t& i) {
+    constexpr swapped_t& operator-=(const swapped_t& i) {
         value = swap(swap() - i.swap());
         return *this;
     }
     template <typename S>
-    swapped_t& operator-=(const S& i) {
+    constexpr swapped_t& operator-=(const S& i) {
         value = swap(swap() - static_cast<T>(i));
         return *this;
     }
 
     // ++v
-    swapped_t& operator++() {
+    constexpr swapped_t& operator++() {
         value = swap(swap() + 1);
         return *this;
     }
     // --v
-    swapped_t& operator--() {
+    constexpr swapped_t& operator--() {
         value = swap(swap() - 1);
         return *this;
     }
 
     // v++
-    swapped_t operator++(int) {
+    constexpr swapped_t operator++(int) {
         swapped_t old = *this;
         value = swap(swap() + 1);
         return old;
     }
     // v--
-    swapped_t operator--(int) {
+    constexpr swapped_t operator--(int) {
         swapped_t old = *this;
         value = swap(swap() - 1);
         return old;
     }
     // Comparaison
     // v == i
-    bool operator==(const swapped_t& i) const {
+    constexpr bool operator==(const swapped_t& i) const {
         return swap() == i.swap();
     }
     template <typename S>
-    bool operator==(const S& i) const {
+    constexpr bool operator==(const S& i) const {
         return swap() == i;
     }
 
     // v != i
-    bool operator!=(const swapped_t& i) const {
+    constexpr bool operator!=(const swapped_t& i) const {
         return swap() != i.swap();
     }
     template <typename S>
-    bool operator!=(const S& i) const {
+    constexpr bool operator!=(const S& i) const {
         return swap() != i;
     }
 
     // v > i
-    bool operator>(const swapped_t& i) const {
+    constexpr bool operator>(const swapped_t& i) const {
         return swap() > i.swap();
     }
     template <typename S>
-    bool operator>(const S& i) const {
+    constexpr bool operator>(const S& i) const {
         return swap() > i;
     }
 
     // v < i
-    bool operator<(const swapped_t& i) const {
+    constexpr bool operator<(const swapped_t& i) const {
         return swap() < i.swap();
     }
     template <typename S>
-    bool operator<(const S& i) const {
+    constexpr bool operator<(const S& i) const {
         return swap() < i;
     }
 
     // v >= i
-    bool operator>=(const swapped_t& i) const {
+    constexpr bool operator>=(const swapped_t& i) const {
         return swap() >= i.swap();
     }
     template <typename S>
-    bool operator>=(const S& i) const {
+    constexpr bool operator>=(const S& i) const {
         return swap() >= i;
     }
 
     // v <= i
-    bool operator<=(const swapped_t& i) const {
+    constexpr bool operator<=(const swapped_t& i) const {
         return swap() <= i.swap();
     }
     template <typename S>
-    bool operator<=(const S& i) const {
+    constexpr bool operator<=(const S& i) const {
         return swap() <= i;
     }
 
     // logical
-    swapped_t operator!() const {
+    constexpr swapped_t operator!() const {
         return !swap();
     }
 
     // bitmath
-    swapped_t operator~() const {
+    constexpr swapped_t operator~() const {
         return ~swap();
     }
 
-    swapped_t operator&(const swapped_t& b) const {
+    constexpr swapped_t operator&(const swapped_t& b) const {
         return swap() & b.swap();
     }
     template <typename S>
-    swapped_t operator&(const S& b) const {
+    constexpr swapped_t operator&(const S& b) const {
         return swap() & b;
     }
-    swapped_t& operator&=(const swapped_t& b) {
+    constexpr swapped_t& operator&=(const swapped_t& b) {
         value = swap(swap() & b.swap());
         return *this;
     }
     template <typename S>
-    swapped_t& operator&=(const S b) {
+    constexpr swapped_t& operator&=(const S b) {
         value = swap(swap() & b);
         return *this;
     }
 
-    swapped_t operator|(const swapped_t& b) const {
+    constexpr swapped_t operator|(const swapped_t& b) const {
         return swap() | b.swap();
     }
     template <typename S>
-    swapped_t operator|(const S& b) const {
+    constexpr swapped_t operator|(const S& b) const {
         return swap() | b;
     }
-    swapped_t& operator|=(const swapped_t& b) {
+    constexpr swapped_t& operator|=(const swapped_t& b) {
         value = swap(swap() | b.swap());
         return *this;
     }
     template <typename S>
-    swapped_t& operator|=(const S& b) {
+    constexpr swapped_t& operator|=(const S& b) {
         value = swap(swap() | b);
         return *this;
     }
 
-    swapped_t operator^(const swapped_t& b) const {
+    constexpr swapped_t operator^(const swapped_t& b) const {
         return swap() ^ b.swap();
     }
     template <typename S>
-    swapped_t operator^(const S& b) const {
+    constexpr swapped_t operator^(const S& b) const {
         return swap() ^ b;
     }
-    swapped_t& operator^=(const swapped_t& b) {
+    constexpr swapped_t& operator^=(const swapped_t& b) {
         value = swap(swap() ^ b.swap());
         return *this;
     }
     template <typename S>
-    swapped_t& operator^=(const S& b) {
+    constexpr swapped_t& operator^=(const S& b) {
         value = swap(swap() ^ b);
         return *this;
     }
 
     template <typename S>
-    swapped_t operator<<(const S& b) const {
+    constexpr swapped_t operator<<(const S& b) const {
         return swap() << b;
     }
     template <typename S>
-    swapped_t& operator<<=(const S& b) const {
+    constexpr swapped_t& operator<<=(const S& b) const {
         value = swap(swap() << b);
         return *this;
     }
 
     template <typename S>
-    swapped_t operator>>(const S& b) const {
+    constexpr swapped_t operator>>(const S& b) const {
         return swap() >> b;
     }
     template <typename S>
-    swapped_t& operator>>=(const S& b) const {
+    constexpr swapped_t& operator>>=(const S& b) const {
         value = swap(swap() >> b);
         return *this;
     }
@@ -467,111 +472,111 @@ public:
 
 // Arithmetics
 template <typename S, typename T, typename F>
-S operator+(const S& i, const swap_struct_t<T, F> v) {
+constexpr S operator+(const S& i, const swap_struct_t<T, F> v) {
     return i + v.swap();
 }
 
 template <typename S, typename T, typename F>
-S operator-(const S& i, const swap_struct_t<T, F> v) {
+constexpr S operator-(const S& i, const swap_struct_t<T, F> v) {
     return i - v.swap();
 }
 
 template <typename S, typename T, typename F>
-S operator/(const S& i, const swap_struct_t<T, F> v) {
+constexpr S operator/(const S& i, const swap_struct_t<T, F> v) {
     return i / v.swap();
 }
 
 template <typename S, typename T, typename F>
-S operator*(const S& i, const swap_struct_t<T, F> v) {
+constexpr S operator*(const S& i, const swap_struct_t<T, F> v) {
     return i * v.swap();
 }
 
 template <typename S, typename T, typename F>
-S operator%(const S& i, const swap_struct_t<T, F> v) {
+constexpr S operator%(const S& i, const swap_struct_t<T, F> v) {
     return i % v.swap();
 }
 
 // Arithmetics + assignments
 template <typename S, typename T, typename F>
-S& operator+=(S& i, const swap_struct_t<T, F> v) {
+constexpr S& operator+=(S& i, const swap_struct_t<T, F> v) {
     i += v.swap();
     return i;
 }
 
 template <typename S, typename T, typename F>
-S& operator-=(S& i, const swap_struct_t<T, F> v) {
+constexpr S& operator-=(S& i, const swap_struct_t<T, F> v) {
     i -= v.swap();
     return i;
 }
 
 // Logical
 template <typename S, typename T, typename F>
-S operator&(const S& i, const swap_struct_t<T, F> v) {
+constexpr S operator&(const S& i, const swap_struct_t<T, F> v) {
     return i & v.swap();
 }
 
 template <typename S, typename T, typename F>
-S operator&(const swap_struct_t<T, F> v, const S& i) {
+constexpr S operator&(const swap_struct_t<T, F> v, const S& i) {
     return static_cast<S>(v.swap() & i);
 }
 
 // Comparaison
 template <typename S, typename T, typename F>
-bool operator<(const S& p, const swap_struct_t<T, F> v) {
+constexpr bool operator<(const S& p, const swap_struct_t<T, F> v) {
     return p < v.swap();
 }
 template <typename S, typename T, typename F>
-bool operator>(const S& p, const swap_struct_t<T, F> v) {
+constexpr bool operator>(const S& p, const swap_struct_t<T, F> v) {
     return p > v.swap();
 }
 template <typename S, typename T, typename F>
-bool operator<=(const S& p, const swap_struct_t<T, F> v) {
+constexpr bool operator<=(const S& p, const swap_struct_t<T, F> v) {
     return p <= v.swap();
 }
 template <typename S, typename T, typename F>
-bool operator>=(const S& p, const swap_struct_t<T, F> v) {
+constexpr bool operator>=(const S& p, const swap_struct_t<T, F> v) {
     return p >= v.swap();
 }
 template <typename S, typename T, typename F>
-bool operator!=(const S& p, const swap_struct_t<T, F> v) {
+constexpr bool operator!=(const S& p, const swap_struct_t<T, F> v) {
     return p != v.swap();
 }
 template <typename S, typename T, typename F>
-bool operator==(const S& p, const swap_struct_t<T, F> v) {
+constexpr bool operator==(const S& p, const swap_struct_t<T, F> v) {
     return p == v.swap();
 }
 
 template <typename T>
 struct swap_64_t {
-    static T swap(T x) {
+    constexpr static T swap(T x) {
         return static_cast<T>(Common::swap64(x));
     }
 };
 
 template <typename T>
 struct swap_32_t {
-    static T swap(T x) {
+    constexpr static T swap(T x) {
         return static_cast<T>(Common::swap32(x));
     }
 };
 
 template <typename T>
 struct swap_16_t {
-    static T swap(T x) {
+    constexpr static T swap(T x) {
         return static_cast<T>(Common::swap16(x));
     }
 };
 
 template <typename T>
 struct swap_float_t {
-    static T swap(T x) {
+    constexpr static T swap(T x) {
         return static_cast<T>(Common::swapf(x));
     }
 };
 
 template <typename T>
 struct swap_double_t {
-    static T swap(T x) {
+    constexpr static T swap(T x) {
         return static_cast<T>(Common::swapd(x));
     }
 };
@@ -582,19 +587,19 @@ struct swap_enum_t {
     using base = std::underlying_type_t<T>;
 
 public:
-    swap_enum_t() = default;
-    swap_enum_t(const T& v) : value(swap(v)) {}
+    constexpr swap_enum_t() = default;
+    constexpr swap_enum_t(const T& v) : value(swap(v)) {}
 
-    swap_enum_t& operator=(const T& v) {
+    constexpr swap_enum_t& operator=(const T& v) {
         value = swap(v);
         return *this;
     }
 
-    operator T() const {
+    constexpr operator T() const {
         return swap(value);
     }
 
-    explicit operator base() const {
+    constexpr explicit operator base() const {
         return static_cast<base>(swap(value));
     }
 
@@ -609,7 +614,7 @@ protected:
         std::is_same_v<base, u64>, swap_64_t<u64>, std::conditional_t<
         std::is_same_v<base, s64>, swap_64_t<s64>, void>>>>>>;
     // clang-format on
-    static T swap(T x) {
+    constexpr static T swap(T x) {
         return static_cast<T>(swap_t::swap(static_cast<base>(x)));
     }
 };